@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+
+// Checks and micro-benchmarks of the patch pipeline's data structures, run
+// by bench_main.cpp. Each prints its results and returns false if a check failed.
+
+bool runCullingBench();
+bool runHashMapBench();
+bool runSlotAllocatorBench();
+
+// Seconds since an arbitrary start, for timing
+inline double benchSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Cheap per-thread pseudo-random numbers, the same every run
+class BenchRandom
+{
+	unsigned m_state;
+
+	public:
+
+	BenchRandom(unsigned seed) : m_state(seed * 7919 + 1) {}
+
+	inline unsigned next()
+	{
+		m_state = m_state * 1103515245 + 12345;
+		return m_state >> 16;
+	}
+
+	inline float nextUnit()   { return next() / 65535.0f; }         // In [0, 1]
+	inline float nextSigned() { return 2.0f * nextUnit() - 1.0f; } // In [-1, 1]
+};
@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+
+// Runs every check and benchmark, or just those named on the command line:
+//   Bench culling hash_map slot_allocator
+// and exits non-zero if any check fails. Build Bench.vcxproj in Release, or
+// elsewhere, from the repository root, with the include paths Genesis uses:
+//   g++ -std=c++11 -O2 -msse4.1 -pthread -o bench_run bench/*.cpp
+//     patch_culling.cpp patchhash.cpp patch_slot_allocator.cpp
+
+struct BenchEntry
+{
+	const char* m_name;
+	bool (*m_run)();
+};
+
+static const BenchEntry BENCHES[] = {
+	{ "culling",        runCullingBench },
+	{ "hash_map",       runHashMapBench },
+	{ "slot_allocator", runSlotAllocatorBench },
+};
+
+int main(int argc, char** argv)
+{
+	bool passed = true;
+
+	for (const BenchEntry& bench : BENCHES)
+	{
+		bool selected = (argc == 1);
+		for (int i = 1; i < argc; ++i)
+			selected |= !strcmp(argv[i], bench.m_name);
+		if (!selected)
+			continue;
+
+		printf("== %s\n", bench.m_name);
+		if (!bench.m_run())
+		{
+			printf("%s: FAILED\n", bench.m_name);
+			passed = false;
+		}
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "bench.h"
+#include "../patch_culling.h"
+#include "../planet_patch.h"
+
+// testChildrenVisible() against the same tests run one patch at a time in
+// plain floats: the path it replaced, with the horizon test it has now.
+// Random cases put the camera near or far from a patch's children, with
+// random altitudes, frustum planes and occluder.
+
+static const int NUM_CASES = 20000;
+static const int NUM_REPEATS = 50;
+
+struct CullingCase
+{
+	PatchHash m_parent;
+	PlanetPatch* m_children; // Four
+	PatchCullingView m_view;
+
+	CullingCase(PatchHash parent) : m_parent(parent), m_children(nullptr) {}
+};
+
+// As in planet.cpp's traversePatches
+static PatchHash getChildHash(const PatchHash& parent, int childNumber)
+{
+	const float halfSize = parent.getSize() / 2.0f;
+	return makePatchHash(
+		parent.getOrientation(), parent.getLevel() + 1,
+		parent.getDim0() + halfSize*(childNumber & 1), parent.getDim1() + halfSize*(childNumber >> 1)
+	);
+}
+
+// As _mm_min_ps and _mm_max_ps, which return b when either is NaN
+static inline float laneMin(float a, float b) { return a < b ? a : b; }
+static inline float laneMax(float a, float b) { return a > b ? a : b; }
+
+// As sqrtClamped in patch_culling.cpp
+static inline float sqrtClamped(float v) { return sqrtf(laneMax(v, 0.0f)); }
+
+// One lane of testHidden() in patch_culling.cpp, in the same order of
+// operations, so that the answers agree exactly
+static bool scalarHidden(const PatchCullingView& view, const PlanetPatch& patch, float& slack)
+{
+	const PatchBoundingVectors& b = patch.m_boundingVectors;
+
+	float cosAngle = glm::dot(b.m_center, b.m_corner00);
+	cosAngle = laneMin(cosAngle, glm::dot(b.m_center, b.m_corner01));
+	cosAngle = laneMin(cosAngle, glm::dot(b.m_center, b.m_corner10));
+	cosAngle = laneMin(cosAngle, glm::dot(b.m_center, b.m_corner11));
+
+	const float k = cosAngle * (patch.m_minAltitude + patch.m_maxAltitude) * 0.5f;
+	const float twoKCos = (k + k) * cosAngle;
+	const float minRadius2 = patch.m_minAltitude * (patch.m_minAltitude - twoKCos) + k*k;
+	const float maxRadius2 = patch.m_maxAltitude * (patch.m_maxAltitude - twoKCos) + k*k;
+	const float radius = sqrtClamped(laneMax(minRadius2, maxRadius2));
+
+	const glm::vec3 toPatch = b.m_center * k - view.m_cameraPos_MS;
+	const float patchDist = sqrtf(glm::dot(toPatch, toPatch));
+	const float t = 0.0f - glm::dot(view.m_cameraPos_MS, toPatch);
+
+	const float cameraDist = view.m_cameraDist;
+	const float occluderRadius = view.m_occluderRadius;
+
+	const float cosPhi = t / (cameraDist * patchDist);
+	const float sinPhi = sqrtClamped(1.0f - cosPhi*cosPhi);
+	const float sinAlpha = radius / patchDist;
+	const float cosAlpha = sqrtClamped(1.0f - sinAlpha*sinAlpha);
+	const float sinSum = sinPhi*cosAlpha + cosPhi*sinAlpha;
+	const float cosSum = cosPhi*cosAlpha - sinPhi*sinAlpha;
+
+	const bool inCone = cosSum > 0.0f && patchDist > radius;
+	const float coneRadius = inCone ? cameraDist * sinSum : cameraDist;
+	const float planeRadius = sqrtClamped(cameraDist*cameraDist - t + radius*cameraDist);
+	const float rounding = 1e-5f * cameraDist;
+	const float leastRadius = laneMin(cameraDist, laneMax(coneRadius, planeRadius)) + rounding;
+
+	const bool outside = cameraDist > occluderRadius;
+	const float crossingSlack = fabsf(cameraDist - occluderRadius);
+	slack = laneMin(crossingSlack, outside ? fabsf(occluderRadius - leastRadius) : crossingSlack) - rounding;
+	return outside && occluderRadius > leastRadius;
+}
+
+// One lane of testVisible() in patch_culling.cpp, folded into result
+static bool scalarVisible(const PatchCullingView& view, const PlanetPatch& patch, ChildVisibility& result)
+{
+	const float huge = std::numeric_limits<float>::max();
+	const PatchBoundingVectors& b = patch.m_boundingVectors;
+
+	float hiddenSlack;
+	const bool hidden = scalarHidden(view, patch, hiddenSlack);
+
+	bool outside = false;
+	float insideSlack = huge;
+	float outsideSlack = 0.0f;
+	for (int i = 0; i < 6; ++i)
+	{
+		const glm::vec4& plane = view.m_frustumPlanes[i];
+		const float planeValue = glm::dot(b.m_center, glm::vec3(plane.x, plane.y, plane.z)) + plane.w;
+		const float margin = planeValue + b.m_radius;
+		const bool planeOutside = planeValue <= 0.0f - b.m_radius;
+
+		outside |= planeOutside;
+		insideSlack = laneMin(insideSlack, margin);
+		outsideSlack = laneMax(outsideSlack, planeOutside ? 0.0f - margin : 0.0f);
+	}
+
+	const float moveSlack = (!hidden && outside) ? huge : hiddenSlack;
+	const float frustumSlack = hidden ? huge : (outside ? outsideSlack : insideSlack);
+
+	result.m_moveSlack = laneMin(result.m_moveSlack, moveSlack);
+	result.m_frustumSlack = laneMin(result.m_frustumSlack, frustumSlack);
+	result.m_maxCenterLength = laneMax(result.m_maxCenterLength, sqrtf(glm::dot(b.m_center, b.m_center)));
+	return !hidden && !outside;
+}
+
+static ChildVisibility scalarChildrenVisible(const PatchCullingView& view, const PlanetPatch* children)
+{
+	ChildVisibility result;
+	result.m_visibleMask = 0;
+	result.m_moveSlack = std::numeric_limits<float>::max();
+	result.m_frustumSlack = std::numeric_limits<float>::max();
+	result.m_maxCenterLength = 0.0f;
+
+	for (int i = 0; i < 4; ++i)
+		if (scalarVisible(view, children[i], result))
+			result.m_visibleMask |= 1 << i;
+	return result;
+}
+
+static CullingCase makeCase(BenchRandom& random)
+{
+	const int level = random.next() % 20;
+	const float size = 2.0f / (1 << level);
+	const unsigned lastIndex = (1u << level) - 1;
+	CullingCase c(makePatchHash(
+		PatchOrientation(random.next() % 6), level,
+		-1.0f + size*(random.next() & lastIndex), -1.0f + size*(random.next() & lastIndex)
+	));
+
+	c.m_children = static_cast<PlanetPatch*>(::operator new(4 * sizeof(PlanetPatch)));
+	for (int i = 0; i < 4; ++i)
+	{
+		new (c.m_children + i) PlanetPatch(getChildHash(c.m_parent, i), i, nullptr);
+		if (random.next() % 3)
+			c.m_children[i].setAltitudes(1.0f - 0.01f * random.nextUnit(), 1.0f + 0.02f * random.nextUnit());
+	}
+
+	// Mostly near the children, as in a walk, otherwise anywhere out to twice the radius
+	const bool nearChildren = (random.next() % 4) != 0;
+	const glm::vec3 jitter(random.nextSigned(), random.nextSigned(), random.nextSigned());
+	const glm::vec3 direction = nearChildren ?
+		glm::normalize(c.m_children[0].m_boundingVectors.m_center + jitter * size * 4.0f) :
+		glm::normalize(jitter + glm::vec3(0.0f, 0.0f, 1e-3f));
+
+	PatchCullingView& view = c.m_view;
+	view.m_cameraPos_MS = direction * (0.985f + fabsf(random.nextSigned()) * (nearChildren ? size * 3.0f : 2.0f));
+	view.m_cameraDist = glm::length(view.m_cameraPos_MS);
+	view.m_occluderRadius = (random.next() % 4) ? 0.99f : 0.0f;
+
+	// Planes through points near the camera, or half the time none that cull
+	const bool frustum = (random.next() & 1) != 0;
+	for (int i = 0; i < 6; ++i)
+	{
+		const glm::vec3 normal = glm::normalize(glm::vec3(random.nextSigned(), random.nextSigned(), random.nextSigned() + 1e-3f));
+		const float offset = frustum ? random.nextSigned() * size : 1e6f;
+		view.m_frustumPlanes[i] = glm::vec4(normal, offset - glm::dot(normal, view.m_cameraPos_MS));
+	}
+
+	return c;
+}
+
+bool runCullingBench()
+{
+	BenchRandom random(1);
+	std::vector<CullingCase> cases;
+	for (int i = 0; i < NUM_CASES; ++i)
+		cases.push_back(makeCase(random));
+
+	int maskMismatches = 0;
+	int slackMismatches = 0;
+	int singleMismatches = 0;
+	int numVisible = 0;
+	for (const CullingCase& c : cases)
+	{
+		const ChildVisibility simd = testChildrenVisible(c.m_view, c.m_children);
+		const ChildVisibility scalar = scalarChildrenVisible(c.m_view, c.m_children);
+
+		if (simd.m_visibleMask != scalar.m_visibleMask)
+			++maskMismatches;
+		if (simd.m_moveSlack != scalar.m_moveSlack || simd.m_frustumSlack != scalar.m_frustumSlack ||
+			simd.m_maxCenterLength != scalar.m_maxCenterLength)
+			++slackMismatches;
+		for (int i = 0; i < 4; ++i)
+			if (testPatchVisible(c.m_view, c.m_children + i) != ((scalar.m_visibleMask >> i) & 1))
+				++singleMismatches;
+
+		for (int i = 0; i < 4; ++i)
+			numVisible += (scalar.m_visibleMask >> i) & 1;
+	}
+
+	printf(
+		"%d cases, %d of %d children visible: %d mask, %d slack and %d single-patch mismatches\n",
+		NUM_CASES, numVisible, 4 * NUM_CASES, maskMismatches, slackMismatches, singleMismatches
+	);
+
+	// Summed so that the optimiser keeps every call
+	unsigned sum = 0;
+
+	double start = benchSeconds();
+	for (int repeat = 0; repeat < NUM_REPEATS; ++repeat)
+		for (const CullingCase& c : cases)
+			sum += scalarChildrenVisible(c.m_view, c.m_children).m_visibleMask;
+	const double scalarVisibility = benchSeconds() - start;
+
+	start = benchSeconds();
+	for (int repeat = 0; repeat < NUM_REPEATS; ++repeat)
+		for (const CullingCase& c : cases)
+			sum += testChildrenVisible(c.m_view, c.m_children).m_visibleMask;
+	const double simdVisibility = benchSeconds() - start;
+
+	const double toNanoseconds = 1e9 / ((double)NUM_REPEATS * NUM_CASES);
+	printf(
+		"per four children: visibility scalar %.1f ns, SSE %.1f ns (%u)\n",
+		scalarVisibility * toNanoseconds, simdVisibility * toNanoseconds, sum
+	);
+
+	for (CullingCase& c : cases)
+		::operator delete(c.m_children); // PlanetPatch's destructor does nothing
+
+	return !maskMismatches && !slackMismatches && !singleMismatches;
+}
@@ -0,0 +1,144 @@
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "../patch_hash_map.h"
+#include "../patchhash.h"
+
+// PatchHashMap against std::unordered_map with the same hash: first a
+// randomised run of the same operations on both, which must agree, then
+// insert, lookup and erase times at a million keys.
+
+static const int NUM_KEYS = 1000000;
+
+struct MixPatchHashFunc
+{
+	inline size_t operator()(uint64_t key) const { return (size_t)mixPatchHash(key); }
+};
+
+typedef std::unordered_map<uint64_t, int, MixPatchHashFunc> ReferenceMap;
+
+// A patch anywhere on the cube, of a level from minLevel to 19
+static uint64_t makeKey(BenchRandom& random, int minLevel)
+{
+	const int level = minLevel + random.next() % (20 - minLevel);
+	const uint32_t lastIndex = (1u << level) - 1;
+	const uint32_t dim0Index = ((random.next() << 16) | random.next()) & lastIndex;
+	const uint32_t dim1Index = ((random.next() << 16) | random.next()) & lastIndex;
+	return makePatchHashFromIndexes(PatchOrientation(random.next() % 6), level, dim0Index, dim1Index);
+}
+
+// Same operations on both maps, from a pool of numKeys keys so that inserts
+// meet existing keys and erases absent ones
+static bool fuzzCheck(BenchRandom& random, int numKeys, int numOps)
+{
+	std::vector<uint64_t> keys;
+	for (int i = 0; i < numKeys; ++i)
+		keys.push_back(makeKey(random, 0));
+
+	PatchHashMap<int> map;
+	ReferenceMap reference;
+	int mismatches = 0;
+
+	for (int op = 0; op < numOps; ++op)
+	{
+		const uint64_t key = keys[random.next() % numKeys];
+		switch (random.next() % 3)
+		{
+			case 0:
+			{
+				const std::pair<PatchHashMap<int>::iterator, bool> inserted = map.emplace(key, op);
+				const std::pair<ReferenceMap::iterator, bool> expected = reference.emplace(key, op);
+				if (inserted.second != expected.second || inserted.first->second != expected.first->second)
+					++mismatches;
+				break;
+			}
+			case 1:
+				if (map.erase(key) != reference.erase(key))
+					++mismatches;
+				break;
+			default:
+			{
+				const PatchHashMap<int>::iterator found = map.find(key);
+				const ReferenceMap::iterator expected = reference.find(key);
+				if ((found == map.end()) != (expected == reference.end()) ||
+					(expected != reference.end() && found->second != expected->second))
+					++mismatches;
+				break;
+			}
+		}
+		if (map.size() != reference.size())
+			++mismatches;
+	}
+
+	// Iteration visits each key once
+	size_t numVisited = 0;
+	for (PatchHashMap<int>::iterator it = map.begin(); it != map.end(); ++it, ++numVisited)
+	{
+		const ReferenceMap::const_iterator expected = reference.find(it->first);
+		if (expected == reference.end() || expected->second != it->second)
+			++mismatches;
+	}
+	if (numVisited != reference.size())
+		++mismatches;
+
+	map.clear();
+	if (!map.empty() || map.begin() != map.end())
+		++mismatches;
+
+	printf("fuzz %d ops over %d keys: %d mismatches\n", numOps, numKeys, mismatches);
+	return mismatches == 0;
+}
+
+// Milliseconds to insert the keys, look each up along with a missing
+// neighbour, then erase them
+template <typename Map>
+static void measure(const std::vector<uint64_t>& keys, const char* name)
+{
+	Map map;
+	size_t numFound = 0;
+
+	const double start = benchSeconds();
+	for (size_t i = 0; i < keys.size(); ++i)
+		map.emplace(keys[i], (int)i);
+	const double inserted = benchSeconds();
+
+	for (size_t i = 0; i < keys.size(); ++i)
+		numFound += map.find(keys[i]) != map.end();
+	for (size_t i = 0; i < keys.size(); ++i)
+		numFound += map.find(keys[i] ^ 1) != map.end(); // Below any level's dim resolution, so never a key
+	const double lookedUp = benchSeconds();
+
+	for (size_t i = 0; i < keys.size(); ++i)
+		map.erase(keys[i]);
+	const double erased = benchSeconds();
+
+	printf(
+		"%-18s insert %6.1f ms, lookup (hit and miss) %6.1f ms, erase %6.1f ms (%u found)\n",
+		name, (inserted - start) * 1e3, (lookedUp - inserted) * 1e3, (erased - lookedUp) * 1e3, (unsigned)numFound
+	);
+}
+
+bool runHashMapBench()
+{
+	BenchRandom random(1);
+
+	bool passed = true;
+	passed &= fuzzCheck(random, 300000, 1000000); // Mostly misses and fresh inserts
+	passed &= fuzzCheck(random, 5000, 1000000);   // Mostly hits, with runs shifting on erase
+
+	// Deep enough that the keys are all but certainly distinct
+	std::vector<uint64_t> keys;
+	for (int i = 0; i < NUM_KEYS; ++i)
+		keys.push_back(makeKey(random, 12));
+
+	// Twice, as the first run also warms the allocator
+	for (int run = 0; run < 2; ++run)
+	{
+		measure<PatchHashMap<int>>(keys, "PatchHashMap");
+		measure<ReferenceMap>(keys, "std::unordered_map");
+	}
+
+	return passed;
+}
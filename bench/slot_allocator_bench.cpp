@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <stack>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "../patch_slot_allocator.h"
+
+static const unsigned NUM_SLOTS = 4096;
+
+// Threads allocate and free at random, each marking the slots it holds, so
+// that a slot handed to two threads at once is seen. A watcher checks that
+// numFree() never exceeds the slots, and once all is freed every slot must
+// be free and allocate() must hand each out exactly once.
+static bool stressCheck(unsigned numThreads, unsigned opsPerThread)
+{
+	PatchSlotAllocator allocator(NUM_SLOTS);
+	std::atomic<int>* const holders = new std::atomic<int>[NUM_SLOTS];
+	for (unsigned slot = 0; slot < NUM_SLOTS; ++slot)
+		holders[slot].store(0);
+
+	std::atomic<unsigned> doubleAllocations(0);
+	std::atomic<unsigned> overcounts(0);
+	std::atomic<unsigned> numRunning(numThreads);
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < numThreads; ++t)
+	{
+		threads.push_back(std::thread([&, t]() {
+			BenchRandom random(t);
+			std::vector<int> held;
+
+			for (unsigned op = 0; op < opsPerThread; ++op)
+			{
+				// Hold a few hundred at most, so the stack both fills and empties
+				if (held.empty() || (held.size() < 512 && (random.next() & 1)))
+				{
+					const int slot = allocator.allocate();
+					if (slot < 0)
+						continue;
+					if (holders[slot].exchange(1))
+						++doubleAllocations;
+					held.push_back(slot);
+				}
+				else
+				{
+					const int slot = held.back();
+					held.pop_back();
+					holders[slot].store(0);
+					allocator.free(slot);
+				}
+			}
+
+			for (int slot : held)
+			{
+				holders[slot].store(0);
+				allocator.free(slot);
+			}
+			--numRunning;
+		}));
+	}
+
+	std::thread watcher([&]() {
+		while (numRunning.load())
+			if (allocator.numFree() > NUM_SLOTS)
+				++overcounts;
+	});
+
+	for (std::thread& thread : threads)
+		thread.join();
+	watcher.join();
+
+	const unsigned numFreeAfter = allocator.numFree();
+
+	std::vector<int> drained;
+	for (int slot = allocator.allocate(); slot >= 0; slot = allocator.allocate())
+		drained.push_back(slot);
+	const unsigned numFreeDrained = allocator.numFree();
+
+	std::sort(drained.begin(), drained.end());
+	const bool distinct = std::unique(drained.begin(), drained.end()) == drained.end();
+
+	for (int slot : drained)
+		allocator.free(slot);
+
+	delete[] holders;
+
+	printf(
+		"stress %u threads x %u ops: %u double allocations, %u overcounts, "
+		"%u free after, %u drained (%s), %u free drained, %u free refilled\n",
+		numThreads, opsPerThread, doubleAllocations.load(), overcounts.load(),
+		numFreeAfter, (unsigned)drained.size(), distinct ? "distinct" : "REPEATED",
+		numFreeDrained, allocator.numFree()
+	);
+
+	return !doubleAllocations && !overcounts && numFreeAfter == NUM_SLOTS &&
+		drained.size() == NUM_SLOTS && distinct && numFreeDrained == 0 &&
+		allocator.numFree() == NUM_SLOTS;
+}
+
+// PlanetDataBuffer's free slots as they were: a std::stack behind a spin
+// lock like utils.h's SpinLock (not included, as it needs the GL headers)
+class LockedSlotStack
+{
+	std::atomic_bool m_lockVariable;
+	std::stack<int> m_free;
+
+	public:
+
+	LockedSlotStack(unsigned numSlots)
+	{
+		m_lockVariable = false;
+		for (unsigned slot = numSlots; slot > 0; --slot)
+			m_free.push(slot - 1);
+	}
+
+	int allocate()
+	{
+		while (m_lockVariable.exchange(true)) {}
+		const int slot = m_free.empty() ? -1 : m_free.top();
+		if (slot >= 0)
+			m_free.pop();
+		m_lockVariable = false;
+		return slot;
+	}
+
+	void free(int slot)
+	{
+		while (m_lockVariable.exchange(true)) {}
+		m_free.push(slot);
+		m_lockVariable = false;
+	}
+};
+
+// Millions of allocate/free pairs a second, across numThreads threads
+template <typename Allocator>
+static double measureThroughput(Allocator& allocator, unsigned numThreads, unsigned pairsPerThread)
+{
+	const double start = benchSeconds();
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < numThreads; ++t)
+	{
+		threads.push_back(std::thread([&]() {
+			for (unsigned i = 0; i < pairsPerThread; ++i)
+			{
+				const int slot = allocator.allocate();
+				if (slot >= 0)
+					allocator.free(slot);
+			}
+		}));
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	return (double)numThreads * pairsPerThread / (benchSeconds() - start) / 1e6;
+}
+
+bool runSlotAllocatorBench()
+{
+	const unsigned maxThreads = std::max(2u, std::thread::hardware_concurrency());
+
+	bool passed = true;
+	passed &= stressCheck(2, 1000000);
+	passed &= stressCheck(std::max(8u, maxThreads), 1000000); // Oversubscribed, to be preempted mid-exchange
+
+	const unsigned pairsPerThread = 1000000;
+	for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		PatchSlotAllocator lockFree(NUM_SLOTS);
+		LockedSlotStack locked(NUM_SLOTS);
+		const double lockFreeRate = measureThroughput(lockFree, numThreads, pairsPerThread);
+		const double lockedRate = measureThroughput(locked, numThreads, pairsPerThread);
+
+		printf(
+			"throughput %2u threads: lock-free %7.1f, spin-locked stack %7.1f M allocate/free pairs/s\n",
+			numThreads, lockFreeRate, lockedRate
+		);
+	}
+
+	return passed;
+}
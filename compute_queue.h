@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <deque>
 #include <map>
 
@@ -43,9 +44,11 @@ class ComputeQueue
 		return queue;
 	}
 
+	// Once; a client already waiting to run keeps its place
 	inline void addClient(ComputeClient* client)
 	{
-		m_clients.push_back(client);
+		if (std::find(m_clients.begin(), m_clients.end(), client) == m_clients.end())
+			m_clients.push_back(client);
 	}
 
 	void runAll();
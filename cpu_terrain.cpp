@@ -0,0 +1,277 @@
+#include <intrin.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "cpu_terrain.h"
+#include "planet_data_buffer.h"
+
+namespace SimdSSE4 { extern const CPUTerrainKernels KERNELS; }
+namespace SimdAVX2 { extern const CPUTerrainKernels KERNELS; }
+
+static bool cpuSupportsAVX2()
+{
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// AVX must be present and the OS must save YMM state on context switches
+	__cpuid(info, 1);
+	const int osxsaveAndAVX = (1 << 27) | (1 << 28);
+	if ((info[2] & osxsaveAndAVX) != osxsaveAndAVX || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+const CPUTerrainKernels* const CPU_TERRAIN_KERNELS =
+	cpuSupportsAVX2() ? &SimdAVX2::KERNELS : &SimdSSE4::KERNELS;
+
+void TerrainSamples::resize(unsigned count)
+{
+	m_count = count;
+	m_paddedCount = (count + CPU_TERRAIN_MAX_SIMD_WIDTH - 1) & ~(CPU_TERRAIN_MAX_SIMD_WIDTH - 1);
+
+	// Padding samples sit at a harmless position so kernels never see garbage
+	m_x.assign(m_paddedCount, 0.0f);
+	m_y.assign(m_paddedCount, 0.0f);
+	m_z.assign(m_paddedCount, 1.0f);
+	m_r.resize(m_paddedCount);
+	m_g.resize(m_paddedCount);
+	m_b.resize(m_paddedCount);
+	m_altitude.resize(m_paddedCount);
+	m_nx.resize(m_paddedCount);
+	m_ny.resize(m_paddedCount);
+	m_nz.resize(m_paddedCount);
+}
+
+void RidgedMFOctaveState::resize(unsigned paddedCount)
+{
+	m_sum.resize(paddedCount);
+	m_prev.resize(paddedCount);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_sumGradient[axis].resize(paddedCount);
+		m_prevGradient[axis].resize(paddedCount);
+	}
+}
+
+static void buildGridSamples(
+	PatchOrientation po, float dim0Start, float dim1Start, float stepSize, 
+	unsigned numPoints, TerrainSamples& samples
+)
+{
+	samples.resize(numPoints * numPoints);
+
+	unsigned index = 0;
+	for (unsigned y = 0; y < numPoints; ++y)
+	{
+		for (unsigned x = 0; x < numPoints; ++x, ++index)
+		{
+			const glm::vec3 cubePos = dimsToUnnormalisedVec3(po, dim0Start + stepSize*x, dim1Start + stepSize*y);
+
+			// Not glm::normalize: keep to correctly-rounded operations
+			const float invLength = 1.0f / sqrtf(cubePos.x*cubePos.x + cubePos.y*cubePos.y + cubePos.z*cubePos.z);
+			samples.m_x[index] = cubePos.x * invLength;
+			samples.m_y[index] = cubePos.y * invLength;
+			samples.m_z[index] = cubePos.z * invLength;
+		}
+	}
+}
+
+void buildPatchSamples(const PatchHash& hash, bool apron, TerrainSamples& samples)
+{
+	const float stepSize = hash.getSize() / PLANET_PATCH_CONSTANTS->m_visiblePolygons;
+	const float start = apron ? stepSize : 0.0f;
+
+	buildGridSamples(
+		hash.getOrientation(), hash.getDim0() - start, hash.getDim1() - start, stepSize, 
+		PLANET_PATCH_CONSTANTS->m_verticesPerSide + (apron ? 2 : 0), samples
+	);
+}
+
+void buildSparsePatchSamples(const PatchHash& hash, unsigned pointsPerSide, TerrainSamples& samples)
+{
+	buildGridSamples(
+		hash.getOrientation(), hash.getDim0(), hash.getDim1(), hash.getSize() / (pointsPerSide - 1), 
+		pointsPerSide, samples
+	);
+}
+
+static void upsampleSamples(const std::vector<float>& parent, ChildPosition childPosition, std::vector<float>& child)
+{
+	const unsigned numPoints = PLANET_PATCH_CONSTANTS->m_verticesPerSide;
+	const unsigned halfPatch = PLANET_PATCH_CONSTANTS->m_visiblePolygons / 2;
+
+	const bool dim0High = childPosition == ChildPosition::DIM0HI_DIM1LO || childPosition == ChildPosition::DIM0HI_DIM1HI;
+	const bool dim1High = childPosition == ChildPosition::DIM0LO_DIM1HI || childPosition == ChildPosition::DIM0HI_DIM1HI;
+	const unsigned offset0 = dim0High ? halfPatch : 0;
+	const unsigned offset1 = dim1High ? halfPatch : 0;
+
+	child.assign(parent.size(), 0.0f);
+
+	// Child sample x sits at parent sample offset + x/2: on a parent sample
+	// for even x, halfway between two for odd x.
+	unsigned index = 0;
+	for (unsigned y = 0; y < numPoints; ++y)
+	{
+		const unsigned py = offset1 + y / 2;
+		const unsigned pyNext = py + (y & 1);
+
+		for (unsigned x = 0; x < numPoints; ++x, ++index)
+		{
+			const unsigned px = offset0 + x / 2;
+			const unsigned pxNext = px + (x & 1);
+
+			const unsigned i00 = py*numPoints + px, i10 = py*numPoints + pxNext;
+			const unsigned i01 = pyNext*numPoints + px, i11 = pyNext*numPoints + pxNext;
+
+			child[index] = 0.25f * (parent[i00] + parent[i10] + parent[i01] + parent[i11]);
+		}
+	}
+}
+
+void upsampleOctaveState(const RidgedMFOctaveState& parent, ChildPosition childPosition, RidgedMFOctaveState& child)
+{
+	child.m_numOctaves = parent.m_numOctaves;
+
+	upsampleSamples(parent.m_sum, childPosition, child.m_sum);
+	upsampleSamples(parent.m_prev, childPosition, child.m_prev);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		upsampleSamples(parent.m_sumGradient[axis], childPosition, child.m_sumGradient[axis]);
+		upsampleSamples(parent.m_prevGradient[axis], childPosition, child.m_prevGradient[axis]);
+	}
+}
+
+static inline float compressNormal(const glm::vec3& normal) // Compress to GL_BGRA format
+{
+	// Each normal component is in range [-1, 1]; want [0, 1023]
+	const glm::vec3 scaled = (normal + glm::vec3(1.0f)) * 1023.0f * 0.5f;
+	const unsigned packed = ((unsigned)scaled.x << 20) | ((unsigned)scaled.y << 10) | (unsigned)scaled.z;
+
+	float result;
+	memcpy(&result, &packed, sizeof(result));
+	return result;
+}
+
+static inline glm::vec3 samplePosition(const TerrainSamples& samples, unsigned index)
+{
+	return glm::vec3(samples.m_x[index], samples.m_y[index], samples.m_z[index]) * samples.m_altitude[index];
+}
+
+// As encodeOctahedral() in lib_patch_vertex.glsl
+static inline uint16_t compressNormalOctahedral(const glm::vec3& normal)
+{
+	const float invLength = 1.0f / (fabs(normal.x) + fabs(normal.y) + fabs(normal.z));
+	float u = normal.x * invLength;
+	float v = normal.y * invLength;
+
+	// Fold the lower hemisphere over the diagonals
+	if (normal.z < 0.0f)
+	{
+		const float foldedU = (1.0f - fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		const float foldedV = (1.0f - fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	const unsigned x = (unsigned)((u * 0.5f + 0.5f) * 255.0f + 0.5f);
+	const unsigned y = (unsigned)((v * 0.5f + 0.5f) * 255.0f + 0.5f);
+	return (uint16_t)(x | (y << 8));
+}
+
+// As getColourBand() in lib_patch_vertex.glsl
+static inline unsigned getColourBand(float altitude)
+{
+	unsigned band = 0;
+	while (band < 10 && altitude >= TERRAIN_COLOUR_HEIGHTS[band][3])
+		++band;
+	return band;
+}
+
+// Over the numOutPoints^2 output samples, starting at firstIndex with rows rowStride apart
+static void computeStats(const TerrainSamples& samples, unsigned firstIndex, unsigned rowStride, PatchStats& stats)
+{
+	const unsigned numOutPoints = PLANET_PATCH_CONSTANTS->m_verticesPerSide;
+
+	stats.m_minAltitude = std::numeric_limits<float>::max();
+	stats.m_maxAltitude = std::numeric_limits<float>::lowest();
+	stats.m_numSubmerged = 0;
+
+	for (unsigned y = 0; y < numOutPoints; ++y)
+	{
+		for (unsigned x = 0; x < numOutPoints; ++x)
+		{
+			const float altitude = samples.m_altitude[firstIndex + y*rowStride + x];
+			stats.m_minAltitude = std::min(stats.m_minAltitude, altitude);
+			stats.m_maxAltitude = std::max(stats.m_maxAltitude, altitude);
+			if (altitude < 1.0f)
+				++stats.m_numSubmerged;
+		}
+	}
+}
+
+// Writes one vertex in the layout PLANET_PATCH_CONSTANTS says; compact
+// heights are quantised over the range in stats.
+static inline void writeVertex(
+	const TerrainSamples& samples, unsigned sampleIndex, const glm::vec3& normal,
+	const PatchStats& stats, float altitudeScale, void* vertices, unsigned vertexIndex
+)
+{
+	if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+	{
+		const float altitude = samples.m_altitude[sampleIndex];
+		const float range = stats.m_maxAltitude - stats.m_minAltitude;
+		const float height = range > 0.0f ? (altitude - stats.m_minAltitude) / range * 65535.0f + 0.5f : 0.0f;
+
+		CompactPatchVertexData& vertex = static_cast<CompactPatchVertexData*>(vertices)[vertexIndex];
+		vertex.height = (uint16_t)std::min(height, 65535.0f);
+		vertex.normal = compressNormalOctahedral(normal);
+		vertex.material = getColourBand((altitude - 1.0f) / altitudeScale);
+	}
+	else
+	{
+		PatchVertexData& vertex = static_cast<PatchVertexData*>(vertices)[vertexIndex];
+		vertex.positionAndNormal = glm::vec4(samplePosition(samples, sampleIndex), compressNormal(normal));
+		vertex.colour = glm::vec4(samples.m_r[sampleIndex], samples.m_g[sampleIndex], samples.m_b[sampleIndex], 1.0f);
+	}
+}
+
+void writePatchVertices(const TerrainSamples& samples, float altitudeScale, void* vertices, PatchStats& stats)
+{
+	const unsigned numPoints = PLANET_PATCH_CONSTANTS->m_verticesPerSide + 2;
+	const unsigned numOutPoints = PLANET_PATCH_CONSTANTS->m_verticesPerSide;
+
+	computeStats(samples, numPoints + 1, numPoints, stats);
+
+	for (unsigned y = 1; y <= numOutPoints; ++y)
+	{
+		for (unsigned x = 1; x <= numOutPoints; ++x)
+		{
+			const unsigned index = y*numPoints + x;
+
+			const glm::vec3 xDn = samplePosition(samples, index - 1);
+			const glm::vec3 xUp = samplePosition(samples, index + 1);
+			const glm::vec3 yDn = samplePosition(samples, index - numPoints);
+			const glm::vec3 yUp = samplePosition(samples, index + numPoints);
+			const glm::vec3 normal = glm::normalize(glm::cross(xUp - xDn, yUp - yDn));
+
+			writeVertex(samples, index, normal, stats, altitudeScale, vertices, (y - 1)*numOutPoints + x - 1);
+		}
+	}
+}
+
+void writePatchVerticesWithNormals(const TerrainSamples& samples, float altitudeScale, void* vertices, PatchStats& stats)
+{
+	computeStats(samples, 0, PLANET_PATCH_CONSTANTS->m_verticesPerSide, stats);
+
+	for (unsigned index = 0; index < PLANET_PATCH_CONSTANTS->m_totalVertices; ++index)
+	{
+		const glm::vec3 normal(samples.m_nx[index], samples.m_ny[index], samples.m_nz[index]);
+		writeVertex(samples, index, normal, stats, altitudeScale, vertices, index);
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+
+#include "patchhash.h"
+
+// Widest vector any kernel uses; sample arrays are padded to a multiple of it.
+const unsigned CPU_TERRAIN_MAX_SIMD_WIDTH = 8;
+
+// Colour ramp of getColour() in lib_patch_vertex.glsl: colour, then the
+// altitude it is reached at
+const float TERRAIN_COLOUR_HEIGHTS[10][4] = {
+	{ 0.0f, 0.0f, 0.0f,                                                   -2.0f },
+	{ 0.023529411764705882f, 0.22745098039215686f, 0.4980392156862745f,   -0.03125f },
+	{ 0.054901960784313725f, 0.4392156862745098f, 0.7529411764705882f,    -0.0001220703125f },
+	{ 234.0f/255.0f, 206.0f/255.0f, 106.0f/255.0f,                        0.0f },
+	{ 0.27450980392156865f, 0.47058823529411764f, 0.23529411764705882f,   0.01f },
+	{ 0.43137254901960786f, 0.5490196078431373f, 0.29411764705882354f,    0.125f },
+	{ 0.6274509803921569f, 0.5490196078431373f, 0.43529411764705883f,     0.25f },
+	{ 0.7215686274509804f, 0.6392156862745098f, 0.5529411764705883f,      0.375f },
+	{ 1.0f, 1.0f, 1.0f,                                                   0.75f },
+	{ 0.5019607843137255f, 1.0f, 1.0f,                                    2.0f }
+};
+
+// Structure-of-arrays block of terrain samples, as consumed by the CPU kernels.
+struct TerrainSamples
+{
+	unsigned m_count;        // Number of real samples
+	unsigned m_paddedCount;  // m_count rounded up to CPU_TERRAIN_MAX_SIMD_WIDTH
+
+	// Inputs: positions on the unit sphere
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+
+	// Outputs: colour, and radial scale of the surface (1.0 is sea level)
+	std::vector<float> m_r;
+	std::vector<float> m_g;
+	std::vector<float> m_b;
+	std::vector<float> m_altitude;
+
+	// Outputs of kernels with analytic derivatives: unit surface normal
+	std::vector<float> m_nx;
+	std::vector<float> m_ny;
+	std::vector<float> m_nz;
+
+	TerrainSamples() : m_count(0), m_paddedCount(0) {}
+
+	void resize(unsigned count);
+};
+
+// Per-patch values needed by PlanetPatch::setAltitudes and m_numSubmerged
+struct PatchStats
+{
+	float m_minAltitude;
+	float m_maxAltitude;
+	unsigned m_numSubmerged;
+};
+
+// Uniforms of lib_ridgedmf.glsl
+struct RidgedMFParams
+{
+	float m_lacunarity;
+	float m_gain;
+	float m_offset;
+	int m_octaves;
+	float m_scale;
+	float m_bias;
+};
+
+// Per-sample state of the ridgedmf() octave loop after m_numOctaves octaves,
+// so that a child patch can resume from its parent's low octaves.
+struct RidgedMFOctaveState
+{
+	int m_numOctaves;
+	std::vector<float> m_sum;
+	std::vector<float> m_prev;
+	std::vector<float> m_sumGradient[3];  // Per axis, of m_sum
+	std::vector<float> m_prevGradient[3]; // Per axis, of m_prev
+
+	RidgedMFOctaveState() : m_numOctaves(0) {}
+
+	void resize(unsigned paddedCount);
+
+	// Of the eight arrays
+	inline size_t getSizeBytes() const { return 8 * m_sum.size() * sizeof(float); }
+};
+
+// Kernel table for one instruction set (see simd.h).
+struct CPUTerrainKernels
+{
+	const char* m_name;
+	unsigned m_width;
+
+	// Octaves shorter than minWavelength (sphere space, 0 for none) are skipped.
+	void (*m_libnoise)(int seed, float minWavelength, TerrainSamples& samples);
+
+	// Also writes normals. resumeFrom (optional) holds the state to continue
+	// from; snapshot (optional, sized by the caller) receives the state after
+	// its m_numOctaves.
+	void (*m_ridgedMF)(
+		int seed, const RidgedMFParams& params, float minWavelength,
+		const RidgedMFOctaveState* resumeFrom, RidgedMFOctaveState* snapshot,
+		TerrainSamples& samples
+	);
+};
+
+// Best kernels for the running CPU; chosen once at startup.
+extern const CPUTerrainKernels* const CPU_TERRAIN_KERNELS;
+
+// Fills samples with the n^2 vertex grid of a patch, or the (n+2)^2 grid
+// including a one-vertex apron, for normals by differences. Matches
+// getVertexPositionSphereSpace() in terrain_cs.glsl.
+void buildPatchSamples(const PatchHash& hash, bool apron, TerrainSamples& samples);
+
+// Fills samples with a pointsPerSide^2 grid spanning the patch, edges included.
+void buildSparsePatchSamples(const PatchHash& hash, unsigned pointsPerSide, TerrainSamples& samples);
+
+// Bilinearly resamples a parent patch's octave state (laid out like
+// buildPatchSamples without an apron) onto the sample grid of one of its children.
+void upsampleOctaveState(const RidgedMFOctaveState& parent, ChildPosition childPosition, RidgedMFOctaveState& child);
+
+// Converts evaluated patch samples into the layout terrain_cs.glsl writes:
+// interior vertices only, normals by central differences over the apron.
+// vertices are PatchVertexData or CompactPatchVertexData, as
+// PLANET_PATCH_CONSTANTS says; compact heights span the patch's altitude
+// range, and altitudeScale is TerrainGenerator::getAltitudeScale().
+void writePatchVertices(const TerrainSamples& samples, float altitudeScale, void* vertices, PatchStats& stats);
+
+// As writePatchVertices, for samples without an apron that carry normals
+void writePatchVerticesWithNormals(const TerrainSamples& samples, float altitudeScale, void* vertices, PatchStats& stats);
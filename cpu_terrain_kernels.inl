@@ -0,0 +1,794 @@
+// CPU ports of the terrain generation shaders.
+//
+// This file is compiled once per instruction set: it is included by
+// cpu_terrain_kernels_sse4.cpp and cpu_terrain_kernels_avx2.cpp, and
+// simd.h places everything in SimdSSE4 or SimdAVX2 accordingly.
+// Each function mirrors its GLSL namesake, evaluated over SIMD_WIDTH samples.
+
+namespace SIMD_NAMESPACE
+{
+
+namespace
+{
+
+struct VVec3
+{
+	VFloat x, y, z;
+
+	VVec3() {}
+	VVec3(VFloat x_, VFloat y_, VFloat z_) : x(x_), y(y_), z(z_) {}
+};
+
+inline VVec3 operator+(const VVec3& a, const VVec3& b) { return VVec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline VVec3 operator-(const VVec3& a, const VVec3& b) { return VVec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline VVec3 operator*(const VVec3& a, VFloat s) { return VVec3(a.x * s, a.y * s, a.z * s); }
+inline VFloat dot(const VVec3& a, const VVec3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+
+// GLSL mod(): x - y*floor(x/y)
+inline VFloat glslMod(VFloat x, VFloat y) { return x - y * vfloor(x / y); }
+
+// GLSL smoothstep()
+inline VFloat smoothstep(float edge0, float edge1, VFloat x)
+{
+	const VFloat t = vclamp((x - VFloat(edge0)) / VFloat(edge1 - edge0), VFloat(0.0f), VFloat(1.0f));
+	return t * t * (VFloat(3.0f) - VFloat(2.0f) * t);
+}
+
+// octaveFade() of lib_libnoise.glsl and lib_ridgedmf.glsl: 1 for octaves well
+// above the cutoff wavelength, 0 for those below it. Uniform over a patch, so
+// not the same at a vertex shared with a coarser patch; see
+// TerrainGenerator::m_octaveCutoff.
+inline float octaveFade(float wavelength, float minWavelength)
+{
+	if (minWavelength <= 0.0f)
+		return 1.0f;
+
+	float t = (wavelength - minWavelength) / minWavelength;
+	t = (t < 0.0f) ? 0.0f : (t > 1.0f) ? 1.0f : t;
+	return t * t * (3.0f - 2.0f * t);
+}
+
+// result = table[index] for small constant tables
+inline VFloat lookup(const float* table, int count, VInt index)
+{
+	VFloat result(table[0]);
+	for (int i = 1; i < count; ++i)
+		result = select(index == VInt(i), VFloat(table[i]), result);
+	return result;
+}
+
+// pow() has no vector form here; the exponents are constants and it is
+// called a handful of times per sample, so go lane by lane.
+inline VFloat powLanes(VFloat base, float exponent)
+{
+	float lanes[SIMD_WIDTH];
+	base.store(lanes);
+	for (unsigned i = 0; i < SIMD_WIDTH; ++i)
+		lanes[i] = powf(lanes[i], exponent);
+	return VFloat::load(lanes);
+}
+
+// getColour() from lib_patch_vertex.glsl
+VVec3 getColour(VFloat altitude)
+{
+	// Walk the table downwards so the lowest matching band wins, like the GLSL loop
+	VVec3 result(VFloat(0.0f), VFloat(0.0f), VFloat(1.0f));
+
+	for (int i = 9; i >= 1; --i)
+	{
+		const float* const lo = TERRAIN_COLOUR_HEIGHTS[i - 1];
+		const float* const hi = TERRAIN_COLOUR_HEIGHTS[i];
+		const VMask inBand = altitude < VFloat(hi[3]);
+		const VFloat t = (altitude - VFloat(lo[3])) / VFloat(hi[3] - lo[3]);
+
+		result.x = select(inBand, vmix(VFloat(lo[0]), VFloat(hi[0]), t), result.x);
+		result.y = select(inBand, vmix(VFloat(lo[1]), VFloat(hi[1]), t), result.y);
+		result.z = select(inBand, vmix(VFloat(lo[2]), VFloat(hi[2]), t), result.z);
+	}
+
+	const VMask belowAll = altitude < VFloat(TERRAIN_COLOUR_HEIGHTS[0][3]);
+	result.x = select(belowAll, VFloat(TERRAIN_COLOUR_HEIGHTS[0][0]), result.x);
+	result.y = select(belowAll, VFloat(TERRAIN_COLOUR_HEIGHTS[0][1]), result.y);
+	result.z = select(belowAll, VFloat(TERRAIN_COLOUR_HEIGHTS[0][2]), result.z);
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// lib_libnoise.glsl
+//////////////////////////////////////////////////////////////////////////////
+
+namespace Libnoise
+{
+
+const float SQRT_3 = 1.7320508075688772935f;
+const float DEFAULT_PERLIN_LACUNARITY = 2.0f;
+const float DEFAULT_PERLIN_PERSISTENCE = 0.5f;
+
+const float MEAN_ABS_GRADIENT_NOISE = 0.262f;
+const float MEAN_RIDGED_MULTI_SIGNAL = 0.577f;
+
+inline VFloat cubicInterp(VFloat n0, VFloat n1, VFloat n2, VFloat n3, VFloat a)
+{
+	const VFloat p = (n3 - n2) - (n0 - n1);
+	const VFloat q = (n0 - n1) - p;
+	const VFloat r = n2 - n0;
+	const VFloat s = n1;
+	return p * a * a * a + q * a * a + r * a + s;
+}
+
+// select() in the shader; renamed so it does not hide the SIMD select()
+inline VFloat blendSelect(VFloat source1, VFloat source2, VFloat control, float falloff, float lowerBound, float upperBound)
+{
+	const float halfWay = 0.5f * (lowerBound + upperBound);
+	const VFloat dist = vabs(VFloat(halfWay) - control);
+	return vmix(source2, source1, smoothstep(upperBound - falloff - halfWay, upperBound + falloff - halfWay, dist));
+}
+
+inline VFloat valueNoise3D(VInt x, VInt y, VInt z, int seed)
+{
+	// The shader takes dot() of the integer vectors, which happens in float
+	const VFloat dotted =
+		toFloat(x) * VFloat(1619.0f) + toFloat(y) * VFloat(31337.0f) +
+		toFloat(z) * VFloat(6971.0f) + VFloat((float)seed * 1013.0f);
+
+	VInt n = truncateToInt(dotted) & VInt(0x7fffffff);
+	n = shiftRightArithmetic(n, 13) ^ n;
+	n = (n * (n * n * VInt(60493) + VInt(19990303)) + VInt(1376312589)) & VInt(0x7fffffff);
+	return VFloat(1.0f) - toFloat(n) / VFloat(1073741824.0f);
+}
+
+inline VFloat permute(VFloat x0)
+{
+	const VFloat x1 = glslMod(x0 * VFloat(34.0f), VFloat(289.0f));
+	return vfloor(glslMod((x1 + VFloat(1.0f)) * x0, VFloat(289.0f)));
+}
+
+// Simplex noise contribution of one corner (offset from the cell origin i)
+inline VFloat simplexCorner(const VVec3& i, const VVec3& offset, const VVec3& x)
+{
+	const float n_ = 1.0f / 7.0f;
+	const float nsx = n_ * 2.0f;
+	const float nsy = n_ * 0.5f - 1.0f;
+	const float nsz = n_;
+
+	const VFloat p = permute(permute(permute(i.z + offset.z) + i.y + offset.y) + i.x + offset.x);
+
+	const VFloat j = p - VFloat(49.0f) * vfloor(p * VFloat(nsz) * VFloat(nsz));
+	const VFloat gx_ = vfloor(j * VFloat(nsz));
+	const VFloat gy_ = vfloor(j - VFloat(7.0f) * gx_);
+
+	const VFloat gx = gx_ * VFloat(nsx) + VFloat(nsy);
+	const VFloat gy = gy_ * VFloat(nsx) + VFloat(nsy);
+	const VFloat h = VFloat(1.0f) - vabs(gx) - vabs(gy);
+
+	// s = lessThan(b, 0)*2 - 1; sh = lessThan(h, 0)
+	const VFloat zero(0.0f);
+	const VFloat sh = maskToFloat(h < zero);
+	const VFloat sx = maskToFloat(gx < zero) * VFloat(2.0f) - VFloat(1.0f);
+	const VFloat sy = maskToFloat(gy < zero) * VFloat(2.0f) - VFloat(1.0f);
+	const VVec3 grad(gx + sx * sh, gy + sy * sh, h);
+
+	// The shader's NORMALISE_GRADIENTS block is spelled differently to its
+	// #define, so gradients are used unnormalised; do the same.
+	VFloat m = vmax(VFloat(0.6f) - dot(x, x), zero);
+	m = m * m;
+	return m * m * dot(grad, x);
+}
+
+VFloat gradientCoherentNoise3D(VVec3 v, int seed)
+{
+	const VFloat fseed((float)seed);
+	v = v + VVec3(fseed, fseed, fseed);
+
+	const float Cx = 1.0f / 6.0f;
+	const float Cy = 1.0f / 3.0f;
+
+	// First corner
+	const VFloat vDotC = v.x * VFloat(Cy) + v.y * VFloat(Cy) + v.z * VFloat(Cy);
+	VVec3 i(vfloor(v.x + vDotC), vfloor(v.y + vDotC), vfloor(v.z + vDotC));
+	const VFloat iDotC = i.x * VFloat(Cx) + i.y * VFloat(Cx) + i.z * VFloat(Cx);
+	const VVec3 x0(v.x - i.x + iDotC, v.y - i.y + iDotC, v.z - i.z + iDotC);
+
+	// Other corners (collapsed sorting network)
+	const VFloat gx = maskToFloat(x0.x > x0.y), gy = maskToFloat(x0.y > x0.z), gz = maskToFloat(x0.z > x0.x);
+	const VFloat lx = maskToFloat(x0.x <= x0.y), ly = maskToFloat(x0.y <= x0.z), lz = maskToFloat(x0.z <= x0.x);
+	const VVec3 i1(gx * lz, gy * lx, gz * ly);
+	const VVec3 i2(vmax(gx, lz), vmax(gy, lx), vmax(gz, ly));
+
+	const VFloat C1(1.0f * Cx), C2(2.0f * Cx), C3(3.0f * Cx);
+	const VVec3 x1(x0.x - i1.x + C1, x0.y - i1.y + C1, x0.z - i1.z + C1);
+	const VVec3 x2(x0.x - i2.x + C2, x0.y - i2.y + C2, x0.z - i2.z + C2);
+	const VVec3 x3(x0.x - VFloat(1.0f) + C3, x0.y - VFloat(1.0f) + C3, x0.z - VFloat(1.0f) + C3);
+
+	// Permutations
+	const VFloat modulus(289.0f);
+	i = VVec3(glslMod(i.x, modulus), glslMod(i.y, modulus), glslMod(i.z, modulus));
+
+	const VFloat zero(0.0f), one(1.0f);
+	const VFloat n0 = simplexCorner(i, VVec3(zero, zero, zero), x0);
+	const VFloat n1 = simplexCorner(i, i1, x1);
+	const VFloat n2 = simplexCorner(i, i2, x2);
+	const VFloat n3 = simplexCorner(i, VVec3(one, one, one), x3);
+
+	return VFloat(48.0f) * (n0 + n1 + n2 + n3);
+}
+
+VFloat perlin(int m_seed, float freq, float persistence, float lacunarity, int octaves, VVec3 pos, float minWavelength)
+{
+	VFloat value(0.0f);
+	float curPersistence = 1.0f;
+	pos = pos * VFloat(freq);
+
+	for (int curOctave = 0; curOctave < octaves; ++curOctave)
+	{
+		const float fade = octaveFade(1.0f / freq, minWavelength);
+		if (fade == 0.0f)
+			break;
+
+		const VFloat signal = gradientCoherentNoise3D(pos, m_seed + curOctave) * VFloat(fade);
+		value += signal * VFloat(curPersistence);
+		pos = pos * VFloat(lacunarity);
+		freq *= lacunarity;
+		curPersistence *= persistence;
+	}
+
+	return value;
+}
+
+VFloat ridgedMulti(int m_seed, float freq, float lacunarity, int octaves, VVec3 pos, float minWavelength)
+{
+	pos = pos * VFloat(freq);
+	VFloat value(0.0f);
+	VFloat weight(1.0f);
+	const float offset = 1.0f;
+	const float gain = 2.0f;
+	float spectralFreq = 1.0f;
+
+	for (int curOctave = 0; curOctave < octaves; ++curOctave)
+	{
+		const float fade = octaveFade(1.0f / freq, minWavelength);
+		VFloat signal(MEAN_RIDGED_MULTI_SIGNAL);
+		if (fade > 0.0f)
+		{
+			signal = gradientCoherentNoise3D(pos, (m_seed + curOctave) & 0x7fffffff);
+			signal = VFloat(offset) - vabs(signal);
+			signal = signal * signal;
+			if (fade < 1.0f)
+				signal = VFloat(MEAN_RIDGED_MULTI_SIGNAL) + (signal - VFloat(MEAN_RIDGED_MULTI_SIGNAL)) * VFloat(fade);
+		}
+		signal = signal * weight;
+		weight = vclamp(signal * VFloat(gain), VFloat(0.0f), VFloat(1.0f));
+		value += signal * VFloat(1.0f) / VFloat(spectralFreq);
+		spectralFreq *= lacunarity;
+		pos = pos * VFloat(lacunarity);
+		freq *= lacunarity;
+	}
+
+	return value * VFloat(1.25f) - VFloat(1.0f);
+}
+
+VFloat billow(int m_seed, float freq, float persistence, float lacunarity, int octaves, VVec3 pos, float minWavelength)
+{
+	VFloat value(0.0f);
+	float curPersistence = 1.0f;
+	pos = pos * VFloat(freq);
+
+	for (int curOctave = 0; curOctave < octaves; ++curOctave)
+	{
+		const float fade = octaveFade(1.0f / freq, minWavelength);
+		VFloat signal(MEAN_ABS_GRADIENT_NOISE);
+		if (fade > 0.0f)
+		{
+			signal = vabs(gradientCoherentNoise3D(pos, m_seed + curOctave));
+			if (fade < 1.0f)
+				signal = VFloat(MEAN_ABS_GRADIENT_NOISE) + (signal - VFloat(MEAN_ABS_GRADIENT_NOISE)) * VFloat(fade);
+		}
+		signal = VFloat(2.0f) * signal - VFloat(1.0f);
+		value += signal * VFloat(curPersistence);
+		pos = pos * VFloat(lacunarity);
+		freq *= lacunarity;
+		curPersistence *= persistence;
+	}
+
+	return value + VFloat(0.5f);
+}
+
+// The shader's *Best variants are identical to the standard ones
+inline VFloat ridgedMultiBest(int m_seed, float freq, float lacunarity, int octaves, const VVec3& pos, float minWavelength)
+{
+	return ridgedMulti(m_seed, freq, lacunarity, octaves, pos, minWavelength);
+}
+
+inline VFloat billowBest(int m_seed, float freq, float persistence, float lacunarity, int octaves, const VVec3& pos, float minWavelength)
+{
+	return billow(m_seed, freq, persistence, lacunarity, octaves, pos, minWavelength);
+}
+
+VVec3 turbulence(const VVec3& pos, int seed, float freq, float power, int roughness, float minWavelength)
+{
+	const VVec3 pos0 = pos + VVec3(VFloat(12414.0f / 65536.0f), VFloat(65124.0f / 65536.0f), VFloat(31337.0f / 65536.0f));
+	const VVec3 pos1 = pos + VVec3(VFloat(26519.0f / 65536.0f), VFloat(18128.0f / 65536.0f), VFloat(60493.0f / 65536.0f));
+	const VVec3 pos2 = pos + VVec3(VFloat(53820.0f / 65536.0f), VFloat(11213.0f / 65536.0f), VFloat(44845.0f / 65536.0f));
+
+	return pos + VVec3(
+		perlin(seed    , freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos0, minWavelength),
+		perlin(seed + 1, freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos1, minWavelength),
+		perlin(seed + 2, freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos2, minWavelength)
+	) * VFloat(power);
+}
+
+// The input points are sorted, so the index the shader's loop breaks at is
+// the number of points not greater than the source.
+inline VInt countPointsNotAbove(VFloat source, const float* points, int numPoints)
+{
+	VInt count(0);
+	for (int i = 0; i < numPoints; ++i)
+		count = count + select(source >= VFloat(points[i]), VInt(1), VInt(0));
+	return count;
+}
+
+// Point counts are template parameters so that the loops over them unroll
+template <int numPoints>
+VFloat curve(VFloat source, const float (&inPoints)[numPoints], const float (&outPoints)[numPoints])
+{
+	const VInt lo(0), hi(numPoints - 1);
+	const VInt indexPos = vclamp(countPointsNotAbove(source, inPoints, numPoints), lo, hi);
+
+	const VInt index0 = vclamp(indexPos - VInt(2), lo, hi);
+	const VInt index1 = vclamp(indexPos - VInt(1), lo, hi);
+	const VInt index2 = vclamp(indexPos          , lo, hi);
+	const VInt index3 = vclamp(indexPos + VInt(1), lo, hi);
+
+	const VFloat input0 = lookup(inPoints, numPoints, index1);
+	const VFloat input1 = lookup(inPoints, numPoints, index2);
+	const VFloat alpha = (source - input0) / (input1 - input0);
+
+	const VFloat interpolated = cubicInterp(
+		lookup(outPoints, numPoints, index0), lookup(outPoints, numPoints, index1),
+		lookup(outPoints, numPoints, index2), lookup(outPoints, numPoints, index3),
+		alpha
+	);
+	return select(index1 == index2, lookup(outPoints, numPoints, index1), interpolated);
+}
+
+template <int numPoints>
+VFloat terrace(VFloat value, const float (&points)[numPoints])
+{
+	const VInt lo(0), hi(numPoints - 1);
+	const VInt indexPos = countPointsNotAbove(value, points, numPoints);
+
+	const VInt index0 = vclamp(indexPos - VInt(1), lo, hi);
+	const VInt index1 = vclamp(indexPos          , lo, hi);
+
+	const VFloat value0 = lookup(points, numPoints, index0);
+	const VFloat value1 = lookup(points, numPoints, index1);
+	const VFloat alpha = (value - value0) / (value1 - value0);
+
+	return select(index0 == index1, value1, vmix(value0, value1, alpha * alpha));
+}
+
+VFloat voronoiWithDistance(int seed, float freq, float disp, VVec3 pos)
+{
+	pos = pos * VFloat(freq);
+
+	// ivec3(pos) - ivec3(step(0, -pos))
+	const VFloat zero(0.0f);
+	const VInt one(1);
+	const VInt posIntX = truncateToInt(pos.x) - select(pos.x <= zero, one, VInt(0));
+	const VInt posIntY = truncateToInt(pos.y) - select(pos.y <= zero, one, VInt(0));
+	const VInt posIntZ = truncateToInt(pos.z) - select(pos.z <= zero, one, VInt(0));
+
+	VFloat minDist(2147483647.0f);
+	VVec3 candPos(zero, zero, zero);
+
+	for (int x = -2; x <= 2; ++x)
+	{
+		for (int y = -2; y <= 2; ++y)
+		{
+			for (int z = -2; z <= 2; ++z)
+			{
+				const VInt currX = posIntX + VInt(x);
+				const VInt currY = posIntY + VInt(y);
+				const VInt currZ = posIntZ + VInt(z);
+				const VVec3 tempPos(
+					toFloat(currX) + valueNoise3D(currX, currY, currZ, seed),
+					toFloat(currY) + valueNoise3D(currX, currY, currZ, seed + 1),
+					toFloat(currZ) + valueNoise3D(currX, currY, currZ, seed + 2)
+				);
+				const VVec3 distVec = tempPos - pos;
+				const VFloat dist = dot(distVec, distVec);
+
+				const VMask closer = dist < minDist;
+				minDist = select(closer, dist, minDist);
+				candPos.x = select(closer, tempPos.x, candPos.x);
+				candPos.y = select(closer, tempPos.y, candPos.y);
+				candPos.z = select(closer, tempPos.z, candPos.z);
+			}
+		}
+	}
+
+	const VVec3 distVec = candPos - pos;
+	const VFloat value = vsqrt(dot(distVec, distVec)) * VFloat(SQRT_3) - VFloat(1.0f);
+	if (disp == 0.0f)
+		return value;
+
+	return value + VFloat(disp) * valueNoise3D(
+		truncateToInt(vfloor(candPos.x)), truncateToInt(vfloor(candPos.y)), truncateToInt(vfloor(candPos.z)), seed
+	);
+}
+
+inline VFloat expoFunc(VFloat mant, float expo)
+{
+	return powLanes(vabs(VFloat(0.5f) * mant + VFloat(0.5f)), expo) * VFloat(2.0f) - VFloat(1.0f);
+}
+
+// Evaluates the modules of a noise graph (see noise_graph.h) over SIMD_WIDTH
+// samples. Everything is inline, so each graph compiles to straight-line
+// code with its constants and curve sizes folded in.
+class Builder
+{
+	const int m_seed;
+	const float m_minWavelength;
+
+	public:
+
+	typedef VFloat Value;
+	typedef VVec3 Position;
+
+	Builder(int seed, float minWavelength) : m_seed(seed), m_minWavelength(minWavelength) {}
+
+	VFloat perlin(const VVec3& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves) const
+	{
+		return Libnoise::perlin(m_seed + seedOffset, freq, persistence, lacunarity, octaves, pos, m_minWavelength);
+	}
+
+	VFloat ridgedMulti(const VVec3& pos, int seedOffset, float freq, float lacunarity, int octaves) const
+	{
+		return Libnoise::ridgedMulti(m_seed + seedOffset, freq, lacunarity, octaves, pos, m_minWavelength);
+	}
+
+	VFloat ridgedMultiBest(const VVec3& pos, int seedOffset, float freq, float lacunarity, int octaves) const
+	{
+		return Libnoise::ridgedMultiBest(m_seed + seedOffset, freq, lacunarity, octaves, pos, m_minWavelength);
+	}
+
+	VFloat billow(const VVec3& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves) const
+	{
+		return Libnoise::billow(m_seed + seedOffset, freq, persistence, lacunarity, octaves, pos, m_minWavelength);
+	}
+
+	VFloat billowBest(const VVec3& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves) const
+	{
+		return Libnoise::billowBest(m_seed + seedOffset, freq, persistence, lacunarity, octaves, pos, m_minWavelength);
+	}
+
+	VFloat voronoi(const VVec3& pos, int seedOffset, float freq, float displacement) const
+	{
+		return voronoiWithDistance(m_seed + seedOffset, freq, displacement, pos);
+	}
+
+	VVec3 turbulence(const VVec3& pos, int seedOffset, float freq, float power, int roughness) const
+	{
+		return Libnoise::turbulence(pos, m_seed + seedOffset, freq, power, roughness, m_minWavelength);
+	}
+
+	VFloat constant(float value) const { return VFloat(value); }
+	VFloat scaleBias(VFloat source, float scale, float bias) const { return source * VFloat(scale) + VFloat(bias); }
+	VFloat add(VFloat a, VFloat b) const { return a + b; }
+	VFloat multiply(VFloat a, VFloat b) const { return a * b; }
+	VFloat min(VFloat a, VFloat b) const { return vmin(a, b); }
+	VFloat max(VFloat a, VFloat b) const { return vmax(a, b); }
+	VFloat clamp(VFloat source, float lowerBound, float upperBound) const { return vclamp(source, VFloat(lowerBound), VFloat(upperBound)); }
+	VFloat exponent(VFloat source, float exponent) const { return expoFunc(source, exponent); }
+
+	VFloat blend(VFloat source0, VFloat source1, VFloat control) const
+	{
+		return vmix(source0, source1, VFloat(0.5f) * control + VFloat(0.5f));
+	}
+
+	VFloat select(VFloat source0, VFloat source1, VFloat control, float falloff, float lowerBound, float upperBound) const
+	{
+		return blendSelect(source0, source1, control, falloff, lowerBound, upperBound);
+	}
+
+	template <int N>
+	VFloat curve(VFloat source, const float (&in)[N], const float (&out)[N]) const
+	{
+		return Libnoise::curve(source, in, out);
+	}
+
+	template <int N>
+	VFloat terrace(VFloat source, const float (&points)[N]) const
+	{
+		return Libnoise::terrace(source, points);
+	}
+};
+} // namespace Libnoise
+
+void libnoiseColourAndAltitude(int seed, float minWavelength, TerrainSamples& samples)
+{
+	Libnoise::Builder builder(seed, minWavelength);
+
+	for (unsigned i = 0; i < samples.m_paddedCount; i += SIMD_WIDTH)
+	{
+		const VVec3 pos(VFloat::load(&samples.m_x[i]), VFloat::load(&samples.m_y[i]), VFloat::load(&samples.m_z[i]));
+		const VFloat altitude = LibnoiseGraph::altitude(builder, pos);
+		const VVec3 colour = getColour(altitude);
+
+		colour.x.store(&samples.m_r[i]);
+		colour.y.store(&samples.m_g[i]);
+		colour.z.store(&samples.m_b[i]);
+		(VFloat(1.0f) + VFloat(0.0005f) * altitude).store(&samples.m_altitude[i]);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// lib_ridgedmf.glsl and snoise(vec3) from lib_gustavsson_perlin.glsl
+//////////////////////////////////////////////////////////////////////////////
+
+namespace RidgedMF
+{
+
+// The shader reads the permutation texture built by initPermTexture(); texel
+// (x, y) holds perm[(x + perm[y]) & 255] in alpha and grad3[alpha & 15]*64+64
+// in rgb. GL_NEAREST with GL_REPEAT makes every lookup an integer one. (Past
+// ~2^16 cells the float coordinate Pi*ONE + ONEHALF can no longer address
+// single texels, so very high octaves differ from the GPU in low bits.)
+inline VInt permTexel(VInt x, VInt y)
+{
+	return gather(perm, (x + gather(perm, y & VInt(255))) & VInt(255));
+}
+
+// Alpha read back as a texture coordinate: a/255 lands on texel a, except
+// 255/255 == 1.0, which wraps round to texel 0.
+inline VInt alphaToTexel(VInt alpha)
+{
+	return select(alpha == VInt(255), VInt(0), alpha);
+}
+
+// grad3 components of -1, 0 and 1, as stored in the texture and unpacked by rgb*4-1
+const float GRADIENT_COMPONENTS[3] = {
+	0.0f / 255.0f * 4.0f - 1.0f,
+	64.0f / 255.0f * 4.0f - 1.0f,
+	128.0f / 255.0f * 4.0f - 1.0f
+};
+
+inline VFloat gradientComponent(VInt gradient, int component)
+{
+	return lookup(GRADIENT_COMPONENTS, 3, gather(&grad3[0][0], gradient * VInt(3) + VInt(component)) + VInt(1));
+}
+
+// Contribution of one simplex corner; (ox, oy, oz) is its integer offset
+// from the cell origin. Its gradient is added to gradient.
+inline VFloat snoiseCorner(VInt ix, VInt iy, VInt iz, VInt ox, VInt oy, VInt oz, const VVec3& pf, VVec3& gradient)
+{
+	const VInt permXY = permTexel(ix + ox, iy + oy);
+	const VInt gradientIndex = permTexel(alphaToTexel(permXY), iz + oz) & VInt(15);
+	const VVec3 grad(gradientComponent(gradientIndex, 0), gradientComponent(gradientIndex, 1), gradientComponent(gradientIndex, 2));
+
+	const VFloat t = VFloat(0.6f) - dot(pf, pf);
+	const VMask outside = t < VFloat(0.0f);
+	const VFloat t2 = t * t;
+	const VFloat t4 = t2 * t2;
+	const VFloat g = dot(grad, pf);
+
+	// d/dpf of t^4 * dot(grad, pf)
+	const VFloat pfScale = select(outside, VFloat(0.0f), VFloat(-8.0f) * t * t2 * g);
+	const VFloat gradScale = select(outside, VFloat(0.0f), t4);
+	gradient = gradient + grad * gradScale + pf * pfScale;
+
+	return select(outside, VFloat(0.0f), t4 * g);
+}
+
+// snoise(vec3, out vec3) of lib_gustavsson_perlin.glsl
+VFloat snoise(const VVec3& p, VVec3& gradient)
+{
+	const float F3 = 0.333333333333f;
+	const float G3 = 0.166666666667f;
+
+	const VFloat s = (p.x + p.y + p.z) * VFloat(F3);
+	const VVec3 pi(vfloor(p.x + s), vfloor(p.y + s), vfloor(p.z + s));
+	const VFloat t = (pi.x + pi.y + pi.z) * VFloat(G3);
+	const VVec3 pf0 = p - VVec3(pi.x - t, pi.y - t, pi.z - t);
+
+	const VInt ix = truncateToInt(pi.x);
+	const VInt iy = truncateToInt(pi.y);
+	const VInt iz = truncateToInt(pi.z);
+
+	// The shader indexes simplexTexture with these three comparisons; in every
+	// reachable case the table rows reduce to "largest axis" for o1 and
+	// "not the smallest axis" for o2.
+	const VMask xy = pf0.x > pf0.y;
+	const VMask xz = pf0.x > pf0.z;
+	const VMask yz = pf0.y > pf0.z;
+	const VMask notXY = pf0.x <= pf0.y;
+	const VMask notXZ = pf0.x <= pf0.z;
+	const VMask notYZ = pf0.y <= pf0.z;
+
+	const VMask o1x = xy & xz, o1y = notXY & yz, o1z = notXZ & notYZ;
+	const VMask o2x = xy | xz, o2y = notXY | yz, o2z = notXZ | notYZ;
+
+	const VVec3 pf1 = pf0 - VVec3(maskToFloat(o1x), maskToFloat(o1y), maskToFloat(o1z)) + VVec3(VFloat(G3), VFloat(G3), VFloat(G3));
+	const VVec3 pf2 = pf0 - VVec3(maskToFloat(o2x), maskToFloat(o2y), maskToFloat(o2z)) + VVec3(VFloat(2.0f*G3), VFloat(2.0f*G3), VFloat(2.0f*G3));
+	const VFloat last = VFloat(1.0f - 3.0f*G3);
+	const VVec3 pf3 = pf0 - VVec3(last, last, last);
+
+	const VInt zero(0), one(1);
+	gradient = VVec3(VFloat(0.0f), VFloat(0.0f), VFloat(0.0f));
+	const VFloat n0 = snoiseCorner(ix, iy, iz, zero, zero, zero, pf0, gradient);
+	const VFloat n1 = snoiseCorner(ix, iy, iz, select(o1x, one, zero), select(o1y, one, zero), select(o1z, one, zero), pf1, gradient);
+	const VFloat n2 = snoiseCorner(ix, iy, iz, select(o2x, one, zero), select(o2y, one, zero), select(o2z, one, zero), pf2, gradient);
+	const VFloat n3 = snoiseCorner(ix, iy, iz, one, one, one, pf3, gradient);
+
+	gradient = gradient * VFloat(32.0f);
+	return VFloat(32.0f) * (n0 + n1 + n2 + n3);
+}
+
+const float MEAN_ABS_SNOISE = 0.354f;
+
+// ridge() in the shader returns early and never uses offset
+inline VFloat ridge(VFloat h)
+{
+	return VFloat(1.0f) - vabs(h);
+}
+
+// Octave loop state of ridgedmf(), with gradients with respect to p
+struct OctaveState
+{
+	VFloat sum, prev;
+	VVec3 sumGradient, prevGradient;
+
+	OctaveState() :
+		sum(0.0f), prev(1.0f),
+		sumGradient(VFloat(0.0f), VFloat(0.0f), VFloat(0.0f)),
+		prevGradient(VFloat(0.0f), VFloat(0.0f), VFloat(0.0f))
+	{
+	}
+
+	void load(const RidgedMFOctaveState& state, unsigned i)
+	{
+		sum = VFloat::load(&state.m_sum[i]);
+		prev = VFloat::load(&state.m_prev[i]);
+		sumGradient = VVec3(
+			VFloat::load(&state.m_sumGradient[0][i]), VFloat::load(&state.m_sumGradient[1][i]), VFloat::load(&state.m_sumGradient[2][i])
+		);
+		prevGradient = VVec3(
+			VFloat::load(&state.m_prevGradient[0][i]), VFloat::load(&state.m_prevGradient[1][i]), VFloat::load(&state.m_prevGradient[2][i])
+		);
+	}
+
+	void store(RidgedMFOctaveState& state, unsigned i) const
+	{
+		sum.store(&state.m_sum[i]);
+		prev.store(&state.m_prev[i]);
+		sumGradient.x.store(&state.m_sumGradient[0][i]);
+		sumGradient.y.store(&state.m_sumGradient[1][i]);
+		sumGradient.z.store(&state.m_sumGradient[2][i]);
+		prevGradient.x.store(&state.m_prevGradient[0][i]);
+		prevGradient.y.store(&state.m_prevGradient[1][i]);
+		prevGradient.z.store(&state.m_prevGradient[2][i]);
+	}
+};
+
+// Sums octaves [firstOctave, octaves) onto state, which holds the state
+// after the first firstOctave octaves. If snapshotOctave is in range, the
+// state after that many octaves is copied to snapshot.
+// minWavelength is in the units of p.
+void ridgedmf(
+	const VVec3& p, float lacunarity, float gain, int octaves, int seed, float minWavelength,
+	int firstOctave, OctaveState& state, int snapshotOctave, OctaveState& snapshot
+)
+{
+	float freq = 1.0f;
+	float amp = 0.5f;
+	for (int i = 0; i < firstOctave; ++i)
+	{
+		freq *= lacunarity;
+		amp *= gain;
+	}
+
+	const VFloat seedOffset((float)seed);
+	const VVec3 zero(VFloat(0.0f), VFloat(0.0f), VFloat(0.0f));
+
+	for (int i = firstOctave; i < octaves; ++i)
+	{
+		if (i == snapshotOctave)
+			snapshot = state;
+
+		const float fade = octaveFade(1.0f / freq, minWavelength);
+		VFloat noise(1.0f - MEAN_ABS_SNOISE);
+		VVec3 noiseGradient = zero;
+		if (fade > 0.0f)
+		{
+			VVec3 snoiseGradient;
+			const VFloat signal = snoise(VVec3(
+				p.x * VFloat(freq) + seedOffset, p.y * VFloat(freq) + seedOffset, p.z * VFloat(freq) + seedOffset
+			), snoiseGradient);
+			noise = ridge(signal);
+
+			// ridge() is 1 - abs(signal)
+			const VFloat scale = select(signal < VFloat(0.0f), VFloat(freq * fade), VFloat(-freq * fade));
+			noiseGradient = snoiseGradient * scale;
+
+			if (fade < 1.0f)
+				noise = VFloat(1.0f - MEAN_ABS_SNOISE) + (noise - VFloat(1.0f - MEAN_ABS_SNOISE)) * VFloat(fade);
+		}
+		state.sum += noise * VFloat(amp) * state.prev;
+		state.sumGradient = state.sumGradient + (noiseGradient * state.prev + state.prevGradient * noise) * VFloat(amp);
+		state.prev = noise;
+		state.prevGradient = noiseGradient;
+		freq *= lacunarity;
+		amp *= gain;
+	}
+
+	if (snapshotOctave == octaves)
+		snapshot = state;
+}
+
+} // namespace RidgedMF
+
+void ridgedMFColourAndAltitude(
+	int seed, const RidgedMFParams& params, float minWavelength,
+	const RidgedMFOctaveState* resumeFrom, RidgedMFOctaveState* snapshot,
+	TerrainSamples& samples
+)
+{
+	const VFloat seedOffset((float)seed);
+	const int firstOctave = resumeFrom ? resumeFrom->m_numOctaves : 0;
+	const int snapshotOctave = snapshot ? snapshot->m_numOctaves : -1;
+
+	for (unsigned i = 0; i < samples.m_paddedCount; i += SIMD_WIDTH)
+	{
+		const VVec3 direction(VFloat::load(&samples.m_x[i]), VFloat::load(&samples.m_y[i]), VFloat::load(&samples.m_z[i]));
+		const VVec3 pos(
+			VFloat(10.0f) * (direction.x + seedOffset),
+			VFloat(10.0f) * direction.y,
+			VFloat(10.0f) * direction.z
+		);
+
+		RidgedMF::OctaveState state, snapshotState;
+		if (resumeFrom)
+			state.load(*resumeFrom, i);
+
+		RidgedMF::ridgedmf(
+			pos, params.m_lacunarity, params.m_gain, params.m_octaves, seed, 10.0f * minWavelength,
+			firstOctave, state, snapshotOctave, snapshotState
+		);
+
+		if (snapshot)
+			snapshotState.store(*snapshot, i);
+
+		const VFloat altitude = VFloat(params.m_scale) * (state.sum + VFloat(params.m_bias));
+		const VVec3 colour = getColour(altitude);
+
+		colour.x.store(&samples.m_r[i]);
+		colour.y.store(&samples.m_g[i]);
+		colour.z.store(&samples.m_b[i]);
+		(VFloat(1.0f) + altitude).store(&samples.m_altitude[i]);
+
+		// As getColourAndAltitude() in lib_ridgedmf.glsl
+		VVec3 gradient = state.sumGradient * VFloat(10.0f * params.m_scale);
+		gradient = gradient - direction * dot(gradient, direction);
+		const VVec3 normal = direction - gradient * (VFloat(1.0f) / (VFloat(1.0f) + altitude));
+		const VVec3 unitNormal = normal * (VFloat(1.0f) / vsqrt(dot(normal, normal)));
+
+		unitNormal.x.store(&samples.m_nx[i]);
+		unitNormal.y.store(&samples.m_ny[i]);
+		unitNormal.z.store(&samples.m_nz[i]);
+	}
+}
+
+} // anonymous namespace
+
+extern const CPUTerrainKernels KERNELS = {
+#if defined(__AVX2__)
+	"AVX2",
+#else
+	"SSE4.1",
+#endif
+	SIMD_WIDTH,
+	libnoiseColourAndAltitude,
+	ridgedMFColourAndAltitude
+};
+
+} // namespace SIMD_NAMESPACE
@@ -0,0 +1,16 @@
+// AVX2 build of the CPU terrain kernels; see cpu_terrain_kernels.inl.
+// This file alone is compiled with /arch:AVX2 (set per file in Genesis.vcxproj)
+// and is only called into when the CPU reports AVX2 support.
+
+#include <math.h>
+
+#include "cpu_terrain.h"
+#include "libnoise_graph.h"
+#include "noise.h"
+#include "simd.h"
+
+#if !defined(__AVX2__)
+#error "cpu_terrain_kernels_avx2.cpp must be compiled with /arch:AVX2"
+#endif
+
+#include "cpu_terrain_kernels.inl"
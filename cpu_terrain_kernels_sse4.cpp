@@ -0,0 +1,10 @@
+// SSE4.1 build of the CPU terrain kernels; see cpu_terrain_kernels.inl.
+
+#include <math.h>
+
+#include "cpu_terrain.h"
+#include "libnoise_graph.h"
+#include "noise.h"
+#include "simd.h"
+
+#include "cpu_terrain_kernels.inl"
@@ -0,0 +1,85 @@
+#include <algorithm>
+
+#include "frame_task_pool.h"
+
+FrameTaskPool::FrameTaskPool(unsigned numWorkers) :
+	m_task(nullptr), m_numTasks(0),
+	m_batchNumber(0), m_numWorkersInBatch(0), m_stopping(false)
+{
+	m_nextTask = 0;
+
+	for (unsigned i = 0; i < numWorkers; ++i)
+		m_threads.emplace_back(&FrameTaskPool::runWorker, this);
+}
+
+FrameTaskPool::~FrameTaskPool()
+{
+	stop();
+}
+
+void FrameTaskPool::runTasks()
+{
+	for (unsigned index = m_nextTask++; index < m_numTasks; index = m_nextTask++)
+		(*m_task)(index);
+}
+
+void FrameTaskPool::runWorker()
+{
+	unsigned lastBatchNumber = 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_startCondition.wait(lock, [&]() { return m_stopping || m_batchNumber != lastBatchNumber; });
+		if (m_stopping)
+			return;
+		lastBatchNumber = m_batchNumber;
+
+		lock.unlock();
+		runTasks();
+		lock.lock();
+
+		if (--m_numWorkersInBatch == 0)
+			m_doneCondition.notify_one();
+	}
+}
+
+void FrameTaskPool::run(unsigned numTasks, const std::function<void(unsigned)>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_numTasks = numTasks;
+		m_nextTask = 0;
+		m_numWorkersInBatch = (unsigned)m_threads.size();
+		++m_batchNumber;
+	}
+	m_startCondition.notify_all();
+
+	runTasks();
+
+	// Every worker must see the batch through before the next can start
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_numWorkersInBatch == 0; });
+	m_task = nullptr;
+}
+
+void FrameTaskPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_startCondition.notify_all();
+
+	for (auto& thread : m_threads)
+		if (thread.joinable())
+			thread.join();
+}
+
+FrameTaskPool* FRAME_TASK_POOL;
+
+void initFrameTaskPool()
+{
+	FRAME_TASK_POOL = new FrameTaskPool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+}
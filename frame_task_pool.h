@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that help the render thread through a batch of independent tasks
+// within a frame, such as the subtrees of a patch quadtree traversal. Unlike
+// PatchWorkerPool, run() blocks until the whole batch is done, and the
+// calling thread takes tasks too.
+class FrameTaskPool
+{
+	std::vector<std::thread> m_threads;
+
+	// Current batch
+	const std::function<void(unsigned)>* m_task;
+	unsigned m_numTasks;
+	std::atomic<unsigned> m_nextTask;
+
+	std::mutex m_mutex;
+	std::condition_variable m_startCondition;
+	std::condition_variable m_doneCondition;
+	unsigned m_batchNumber;       // Incremented as each batch starts
+	unsigned m_numWorkersInBatch; // Yet to finish the current batch
+	bool m_stopping;
+
+	void runTasks();
+	void runWorker();
+
+	public:
+
+	FrameTaskPool(unsigned numWorkers);
+	~FrameTaskPool();
+
+	// Render thread only. Calls task(i) for each i in [0, numTasks), in no
+	// particular order or thread.
+	void run(unsigned numTasks, const std::function<void(unsigned)>& task);
+
+	void stop();
+};
+extern FrameTaskPool* FRAME_TASK_POOL;
+
+// Starts one worker per hardware thread besides the render thread
+void initFrameTaskPool();
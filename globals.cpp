@@ -57,6 +57,30 @@ void loadGlobalsFromXMLNode(XMLNode& node)
 	GLOBALS.m_desiredFPS = finder.required("DesiredFPS", buildIntFromXMLNode);
 	GLOBALS.m_maxPlanetPatchLevel = finder.required("MaxPlanetPatchLevel", buildIntFromXMLNode);
 	GLOBALS.m_planetLevel1Distance = finder.required("PlanetLevel1Distance", buildFloatFromXMLNode);
+	GLOBALS.m_screenSpaceErrorLod = finder.optional("ScreenSpaceErrorLod", buildBoolFromXMLNode);
+	GLOBALS.m_maxPixelError = finder.optional("MaxPixelError", buildFloatFromXMLNode);
+	if (GLOBALS.m_maxPixelError <= 0.0f)
+		GLOBALS.m_maxPixelError = 2.0f;
+	GLOBALS.m_patchBudgetPerFrame = finder.optional("PatchBudgetPerFrame", buildIntFromXMLNode);
+	GLOBALS.m_patchReclaimSeconds = finder.optional("PatchReclaimSeconds", buildFloatFromXMLNode);
+	if (GLOBALS.m_patchReclaimSeconds <= 0.0f)
+		GLOBALS.m_patchReclaimSeconds = 10.0f;
+	GLOBALS.m_patchBufferMB = finder.optional("PatchBufferMB", buildIntFromXMLNode);
+	if (GLOBALS.m_patchBufferMB <= 0)
+		GLOBALS.m_patchBufferMB = 1024;
+	GLOBALS.m_patchPageMB = finder.optional("PatchPageMB", buildIntFromXMLNode);
+	if (GLOBALS.m_patchPageMB <= 0)
+		GLOBALS.m_patchPageMB = 16;
+	if (GLOBALS.m_patchPageMB > GLOBALS.m_patchBufferMB)
+		GLOBALS.m_patchPageMB = GLOBALS.m_patchBufferMB;
+	GLOBALS.m_bufferHighWatermark = finder.optional("BufferHighWatermark", buildFloatFromXMLNode);
+	if (GLOBALS.m_bufferHighWatermark <= 0.0f || GLOBALS.m_bufferHighWatermark > 1.0f)
+		GLOBALS.m_bufferHighWatermark = 0.9f;
+	GLOBALS.m_bufferLowWatermark = finder.optional("BufferLowWatermark", buildFloatFromXMLNode);
+	if (GLOBALS.m_bufferLowWatermark <= 0.0f || GLOBALS.m_bufferLowWatermark > GLOBALS.m_bufferHighWatermark)
+		GLOBALS.m_bufferLowWatermark = GLOBALS.m_bufferHighWatermark * 8.0f / 9.0f; // 0.8 under the default high one
+	GLOBALS.m_parallelTraversalLevel = finder.optional("ParallelTraversalLevel", buildIntFromXMLNode);
+	GLOBALS.m_compactPatchVertices = finder.optional("CompactPatchVertices", buildBoolFromXMLNode);
 }
 
 void Globals::initialise()
@@ -83,6 +107,15 @@ void Globals::initialise()
 	TwAddVarRO(m_overlay_bar, "Window Height", TW_TYPE_INT32, &m_windowHeight, " group=Globals ");
 	TwAddVarRW(m_overlay_bar, "Max Patch Level", TW_TYPE_INT32, &m_maxPlanetPatchLevel, "min=0 max=27 group=Planet ");
 	TwAddVarRW(m_overlay_bar, "Level 1 Distance", TW_TYPE_FLOAT, &m_planetLevel1Distance, "min=0.1 step=0.1 group=Planet ");
+	TwAddVarRW(m_overlay_bar, "Screen Space LOD", TW_TYPE_BOOLCPP, &m_screenSpaceErrorLod, " group=Planet ");
+	TwAddVarRW(m_overlay_bar, "Max Pixel Error", TW_TYPE_FLOAT, &m_maxPixelError, "min=0.1 step=0.1 group=Planet ");
+	TwAddVarRW(m_overlay_bar, "Patch Budget", TW_TYPE_INT32, &m_patchBudgetPerFrame, "min=0 step=1 group=Planet ");
+	TwAddVarRW(m_overlay_bar, "Reclaim Seconds", TW_TYPE_FLOAT, &m_patchReclaimSeconds, "min=1 step=1 group=Planet ");
+	TwAddVarRO(m_overlay_bar, "Patch Buffer MB", TW_TYPE_INT32, &m_patchBufferMB, " group=Planet ");
+	TwAddVarRO(m_overlay_bar, "Patch Page MB", TW_TYPE_INT32, &m_patchPageMB, " group=Planet ");
+	TwAddVarRW(m_overlay_bar, "High Watermark", TW_TYPE_FLOAT, &m_bufferHighWatermark, "min=0.05 max=1 step=0.01 group=Planet ");
+	TwAddVarRW(m_overlay_bar, "Low Watermark", TW_TYPE_FLOAT, &m_bufferLowWatermark, "min=0 max=1 step=0.01 group=Planet ");
+	TwAddVarRW(m_overlay_bar, "Traversal Split Level", TW_TYPE_INT32, &m_parallelTraversalLevel, "min=0 max=6 group=Planet ");
 }
 
 Globals GLOBALS;
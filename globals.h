@@ -26,6 +26,16 @@ class Globals
 	glm::vec3 m_clearColour;
 	int m_maxPlanetPatchLevel;
 	float m_planetLevel1Distance;
+	bool m_screenSpaceErrorLod; // Split patches by their projected geometric error rather than by m_planetLevel1Distance
+	float m_maxPixelError; // With m_screenSpaceErrorLod, the projected error a patch may be drawn with
+	int m_patchBudgetPerFrame; // Most patches each planet starts generating per frame; 0 for no limit but time
+	float m_patchReclaimSeconds; // Patch nodes no walk has reached for this long are freed
+	int m_patchBufferMB; // Most PlanetDataBuffer may grow to, shared by every planet; fixed at startup
+	int m_patchPageMB; // PlanetDataBuffer grows and shrinks by pages of about this size; fixed at startup
+	float m_bufferHighWatermark; // Fraction of PlanetDataBuffer's slots past which its patches are evicted by cost...
+	float m_bufferLowWatermark; // ...down to this fraction
+	int m_parallelTraversalLevel; // Patch traversal splits into one task per patch of this level
+	bool m_compactPatchVertices; // CompactPatchVertexData rather than PatchVertexData
 
 	TwBar* m_overlay_bar;
 
@@ -233,6 +233,65 @@ float snoise(vec3 P)
 	return 32.0 * (n0 + n1 + n2 + n3);
 }
 
+/*
+ * 3D simplex noise as above, also returning its analytic gradient.
+ */
+
+// Contribution of one corner, with Pf its offset from the corner
+float snoiseCorner(vec3 Pf, vec3 grad, inout vec3 gradient)
+{
+	float t = 0.6 - dot(Pf, Pf);
+	if (t < 0.0)
+		return 0.0;
+
+	float t2 = t * t;
+	float g = dot(grad, Pf);
+	gradient += t2 * t2 * grad - 8.0 * t * t2 * g * Pf; // d/dPf of t^4 * dot(grad, Pf)
+	return t2 * t2 * g;
+}
+
+float snoise(vec3 P, out vec3 gradient) 
+{
+	float s = (P.x + P.y + P.z) * F3;
+	vec3 Pi = floor(P + s);
+	float t = (Pi.x + Pi.y + Pi.z) * G3;
+	vec3 P0 = Pi - t;
+	Pi = Pi * ONE + ONEHALF;
+
+	vec3 Pf0 = P - P0;
+
+	float c1 = (Pf0.x > Pf0.y) ? 0.5078125 : 0.0078125;
+	float c2 = (Pf0.x > Pf0.z) ? 0.25 : 0.0;
+	float c3 = (Pf0.y > Pf0.z) ? 0.125 : 0.0;
+	float sindex = c1 + c2 + c3;
+	vec3 offsets = texture(uniform_simplexTexture, sindex).rgb;
+	vec3 o1 = step(0.375, offsets);
+	vec3 o2 = step(0.125, offsets);
+
+	float perm0 = texture2D(uniform_permTexture, Pi.xy).a;
+	vec3  grad0 = texture2D(uniform_permTexture, vec2(perm0, Pi.z)).rgb * 4.0 - 1.0;
+
+	vec3 Pf1 = Pf0 - o1 + G3;
+	float perm1 = texture2D(uniform_permTexture, Pi.xy + o1.xy*ONE).a;
+	vec3  grad1 = texture2D(uniform_permTexture, vec2(perm1, Pi.z + o1.z*ONE)).rgb * 4.0 - 1.0;
+
+	vec3 Pf2 = Pf0 - o2 + 2.0 * G3;
+	float perm2 = texture2D(uniform_permTexture, Pi.xy + o2.xy*ONE).a;
+	vec3  grad2 = texture2D(uniform_permTexture, vec2(perm2, Pi.z + o2.z*ONE)).rgb * 4.0 - 1.0;
+
+	vec3 Pf3 = Pf0 - vec3(1.0-3.0*G3);
+	float perm3 = texture2D(uniform_permTexture, Pi.xy + vec2(ONE, ONE)).a;
+	vec3  grad3 = texture2D(uniform_permTexture, vec2(perm3, Pi.z + ONE)).rgb * 4.0 - 1.0;
+
+	gradient = vec3(0.0);
+	float n = 
+		snoiseCorner(Pf0, grad0, gradient) + snoiseCorner(Pf1, grad1, gradient) + 
+		snoiseCorner(Pf2, grad2, gradient) + snoiseCorner(Pf3, grad3, gradient);
+
+	gradient *= 32.0;
+	return 32.0 * n;
+}
+
 /*
 * 4D simplex noise. A lot faster than classic 4D noise, and better looking.
 */
@@ -1,29 +1,15 @@
 
 uniform vec4 g_randomVectors[256];
 
-#define CONTINENT_FREQUENCY 1.0
-#define CONTINENT_LACUNARITY 2.208984375
-#define MOUNTAIN_LACUNARITY 2.142578125
-#define HILLS_LACUNARITY 2.162109375
-#define PLAINS_LACUNARITY 2.314453125
-#define BADLANDS_LACUNARITY 2.212890625
-#define MOUNTAINS_TWIST 1.0
-#define HILLS_TWIST 1.0
-#define BADLANDS_TWIST 1.0
-#define SEA_LEVEL 0.0
-#define SHELF_LEVEL -0.375
-#define MOUNTAINS_AMOUNT 0.5
-#define BADLANDS_AMOUNT 0.03125
-#define TERRAIN_OFFSET 1.0
-#define MOUNTAIN_GLACIATION 1.375
-#define RIVER_DEPTH 0.0234375
-const float HILLS_AMOUNT = (1.0 + MOUNTAINS_AMOUNT) / 2.0;
-const float CONTINENT_HEIGHT_SCALE = (1.0 - SEA_LEVEL) / 4.0;
-
 #define SQRT_3 1.7320508075688772935
 #define DEFAULT_PERLIN_LACUNARITY 2.0
 #define DEFAULT_PERLIN_PERSISTENCE 0.5
 
+// Means of the per-octave signals, measured over many samples; octaves too
+// fine for the patch are faded towards these rather than to zero.
+#define MEAN_ABS_GRADIENT_NOISE 0.262
+#define MEAN_RIDGED_MULTI_SIGNAL 0.577
+
 int X_NOISE_GEN = 1619;
 int Y_NOISE_GEN = 31337;
 int Z_NOISE_GEN = 6971;
@@ -31,37 +17,6 @@ int SEED_NOISE_GEN = 1013;
 int SHIFT_NOISE_GEN = 8;
 ivec4 GEN_VEC = ivec4(X_NOISE_GEN, Y_NOISE_GEN, Z_NOISE_GEN, SEED_NOISE_GEN);
 
-// All the following have been padded to the longest array's length
-const float CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_IN[10]  = float[](-1.0, 0.0, 1.0 - MOUNTAINS_AMOUNT, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
-const float CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_OUT[10] = float[](-0.0625, 0.0, 0.0625, 0.25, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
-const int NUM_CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS = 4;
-
-const float RIVER_POSITIONS_CURVE0_POINTS_IN[10]  = float[](-2.0, -1.0, -0.125, 0.0, 1.0, 2.0, 0.0, 0.0, 0.0, 0.0);
-const float RIVER_POSITIONS_CURVE0_POINTS_OUT[10] = float[](2.0, 1.0, 0.875, -1.0, -1.5, -2.0, 0.0, 0.0, 0.0, 0.0);
-const int NUM_RIVER_POSITIONS_CURVE0_POINTS = 6;
-
-const float RIVER_POSITIONS_CURVE1_POINTS_IN[10]  = float[](-2.0, -1.0, -0.125, 0.0, 1.0, 2.0, 0.0, 0.0, 0.0, 0.0);
-const float RIVER_POSITIONS_CURVE1_POINTS_OUT[10] = float[](2.0, 1.5, 1.4375, 0.5, 0.25, 0.0, 0.0, 0.0, 0.0, 0.0);
-const int NUM_RIVER_POSITIONS_CURVE1_POINTS = 6;
-
-const float BADLANDS_CLIFF_CURVE_POINTS_IN[10]  = float[](-2.0, -1.0, 0.0, 0.5, 0.625, 0.75, 2.0, 0.0, 0.0, 0.0);
-const float BADLANDS_CLIFF_CURVE_POINTS_OUT[10] = float[](-2.0, -1.25, -0.75, -0.25, 0.875, 1.0, 1.25, 0.0, 0.0, 0.0); 
-const int NUM_BADLANDS_CLIFF_CURVE_POINTS = 7;
-
-const float BASE_CONTINENT_CURVE_POINTS_IN[10]  = float[](-2.0000 + SEA_LEVEL, -1.0000 + SEA_LEVEL, SEA_LEVEL,          0.0625 + SEA_LEVEL, 0.1250 + SEA_LEVEL, 0.2500 + SEA_LEVEL, 0.5000 + SEA_LEVEL, 0.7500 + SEA_LEVEL, 1.0000 + SEA_LEVEL, 2.0000 + SEA_LEVEL);
-const float BASE_CONTINENT_CURVE_POINTS_OUT[10] = float[](-1.625 + SEA_LEVEL,   -1.375 + SEA_LEVEL, -0.375 + SEA_LEVEL, 0.125 + SEA_LEVEL,  0.250 + SEA_LEVEL,  1.000 + SEA_LEVEL,  0.250 + SEA_LEVEL,  0.250 + SEA_LEVEL,  0.500 + SEA_LEVEL,  0.500 + SEA_LEVEL);
-const int NUM_BASE_CONTINENT_CURVE_POINTS = 10;
-
-// All the following have been padded to the longest array's length
-const float CONTINENTAL_SHELF_TERRACE_POINTS[6] = float[](-1.0, -0.75, SHELF_LEVEL, 1.0, 0.0, 0.0);
-const int NUM_CONTINENTAL_SHELF_TERRACE_POINTS = 4;
-
-const float TERRAIN_TYPE_TERRACE_POINTS[6] = float[](-1.0, SHELF_LEVEL + SEA_LEVEL / 2.0, 1.0, 0.0, 0.0, 0.0);
-const int NUM_TERRAIN_TYPE_TERRACE_POINTS = 3;
-
-const float BADLANDS_CLIFF_TERRACE_POINTS[6] = float[](-1.0, -0.875, -0.75, -0.5, 0.0, 1.0);
-const int NUM_BADLANDS_CLIFF_TERRACE_POINTS = 6;
-
 float sCurve3(float x)
 {
 	return smoothstep(0.0, 1.0, x);
@@ -420,7 +375,15 @@ float gradientCoherentNoise3DBest(vec3 v, int seed)
 }
 
 
-float perlin(int m_seed, float freq, float persistence, float lacunarity, int octaves, vec3 pos)
+// 1.0 for octaves well above the cutoff wavelength, 0.0 for those below it.
+// minWavelength is the patch's, so a vertex shared with a coarser patch gets
+// a different fade there, and stitched edges can crack.
+float octaveFade(float wavelength, float minWavelength)
+{
+	return (minWavelength > 0.0) ? smoothstep(minWavelength, 2.0 * minWavelength, wavelength) : 1.0;
+}
+
+float perlin(int m_seed, float freq, float persistence, float lacunarity, int octaves, vec3 pos, float minWavelength)
 {
 	float value = 0.0;
 	float signal = 0.0;
@@ -429,17 +392,22 @@ float perlin(int m_seed, float freq, float persistence, float lacunarity, int oc
 
 	for (int curOctave = 0; curOctave < octaves; ++curOctave) 
 	{
+		float fade = octaveFade(1.0 / freq, minWavelength);
+		if (fade == 0.0)
+			break; // Every later octave is finer still, and averages to zero
+
 		int seed = (m_seed + curOctave);// & int(0xffffffff);
-		signal = gradientCoherentNoise3D(pos, seed);
+		signal = gradientCoherentNoise3D(pos, seed) * fade;
 		value += signal * curPersistence;
 		pos *= lacunarity;
+		freq *= lacunarity;
 		curPersistence *= persistence;
 	}
 
 	return value;
 }
 
-float ridgedMulti(int m_seed, float freq, float lacunarity, int octaves, vec3 pos)
+float ridgedMulti(int m_seed, float freq, float lacunarity, int octaves, vec3 pos, float minWavelength)
 {
 	pos *= freq;
 	float value = 0.0;
@@ -450,22 +418,30 @@ float ridgedMulti(int m_seed, float freq, float lacunarity, int octaves, vec3 po
 
 	for (int curOctave = 0; curOctave < octaves; ++curOctave) 
 	{
-		int seed = (m_seed + curOctave) & 0x7fffffff;
-		float signal = gradientCoherentNoise3D(pos, seed);
-		signal = abs(signal);
-		signal = offset - signal;
-		signal *= signal;
+		float fade = octaveFade(1.0 / freq, minWavelength);
+		float signal = MEAN_RIDGED_MULTI_SIGNAL;
+		if (fade > 0.0)
+		{
+			int seed = (m_seed + curOctave) & 0x7fffffff;
+			signal = gradientCoherentNoise3D(pos, seed);
+			signal = abs(signal);
+			signal = offset - signal;
+			signal *= signal;
+			if (fade < 1.0)
+				signal = mix(MEAN_RIDGED_MULTI_SIGNAL, signal, fade);
+		}
 		signal *= weight;
 		weight = clamp(signal * gain, 0.0, 1.0);
 		value += (signal * 1.0 / spectralFreq);
 		spectralFreq *= lacunarity;
 		pos *= lacunarity;
+		freq *= lacunarity;
 	}
 
 	return (value * 1.25) - 1.0;
 }
 
-float ridgedMultiBest(int m_seed, float freq, float lacunarity, int octaves, vec3 pos)
+float ridgedMultiBest(int m_seed, float freq, float lacunarity, int octaves, vec3 pos, float minWavelength)
 {
 	pos *= freq;
 	float value = 0.0;
@@ -476,63 +452,42 @@ float ridgedMultiBest(int m_seed, float freq, float lacunarity, int octaves, vec
 
 	for (int curOctave = 0; curOctave < octaves; ++curOctave) 
 	{
-		int seed = (m_seed + curOctave) & 0x7fffffff;
-		float signal = gradientCoherentNoise3DBest(pos, seed);
-		signal = abs(signal);
-		signal = offset - signal;
-		signal *= signal;
+		float fade = octaveFade(1.0 / freq, minWavelength);
+		float signal = MEAN_RIDGED_MULTI_SIGNAL;
+		if (fade > 0.0)
+		{
+			int seed = (m_seed + curOctave) & 0x7fffffff;
+			signal = gradientCoherentNoise3DBest(pos, seed);
+			signal = abs(signal);
+			signal = offset - signal;
+			signal *= signal;
+			if (fade < 1.0)
+				signal = mix(MEAN_RIDGED_MULTI_SIGNAL, signal, fade);
+		}
 		signal *= weight;
 		weight = clamp(signal * gain, 0.0, 1.0);
 		value += (signal * 1.0 / spectralFreq);
 		spectralFreq *= lacunarity;
 		pos *= lacunarity;
+		freq *= lacunarity;
 	}
 
 	return (value * 1.25) - 1.0;
 }
 
-vec3 turbulence(vec3 pos, int seed, float freq, float power, int roughness)
+vec3 turbulence(vec3 pos, int seed, float freq, float power, int roughness, float minWavelength)
 {
 	vec3 pos0 = pos + vec3(12414.0 / 65536.0, 65124.0 / 65536.0, 31337.0 / 65536.0);
 	vec3 pos1 = pos + vec3(26519.0 / 65536.0, 18128.0 / 65536.0, 60493.0 / 65536.0);
 	vec3 pos2 = pos + vec3(53820.0 / 65536.0, 11213.0 / 65536.0, 44845.0 / 65536.0);
 
 	return pos + power * vec3(
-		perlin(seed    , freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos0), // std
-		perlin(seed + 1, freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos1), // std
-		perlin(seed + 2, freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos2) // std
+		perlin(seed    , freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos0, minWavelength), // std
+		perlin(seed + 1, freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos1, minWavelength), // std
+		perlin(seed + 2, freq, DEFAULT_PERLIN_PERSISTENCE, DEFAULT_PERLIN_LACUNARITY, roughness, pos2, minWavelength) // std
 	);
 }
 
-float curve(float source, float[10] inPoints, float[10] outPoints, int numPoints)
-{
-	const int numPointsMinusOne = numPoints - 1;
-
-	int indexPos;
-
-	for (indexPos = 0; indexPos <= numPointsMinusOne; ++indexPos)
-	{
-		if (source < inPoints[indexPos])
-			break;
-	}
-
-	indexPos = clamp(indexPos, 0, numPointsMinusOne);
-	
-	int index0 = clamp(indexPos - 2, 0, numPointsMinusOne);
-	int index1 = clamp(indexPos - 1, 0, numPointsMinusOne);
-	int index2 = clamp(indexPos    , 0, numPointsMinusOne);
-	int index3 = clamp(indexPos + 1, 0, numPointsMinusOne);
-	
-	if (index1 == index2)
-		return outPoints[index1];
-	
-	float input0 = inPoints[index1];
-	float input1 = inPoints[index2];
-	float alpha = (source - input0) / (input1 - input0);
-	
-	return cubicInterp(outPoints[index0], outPoints[index1], outPoints[index2], outPoints[index3], alpha);
-}
-
 float voronoiWithDistance(int seed, float freq, float disp, vec3 pos)
 {
 	//return 0.0;
@@ -571,7 +526,7 @@ float voronoiWithDistance(int seed, float freq, float disp, vec3 pos)
 	return value + disp * valueNoise3D(ivec3(floor(candPos)), seed);
 }
 
-float billow(int m_seed, float freq, float persistence, float lacunarity, int octaves, vec3 pos)
+float billow(int m_seed, float freq, float persistence, float lacunarity, int octaves, vec3 pos, float minWavelength)
 {
 	float value = 0.0;
 	float curPersistence = 1.0;
@@ -580,18 +535,26 @@ float billow(int m_seed, float freq, float persistence, float lacunarity, int oc
 
 	for (int curOctave = 0; curOctave < octaves; ++curOctave) 
 	{
-		int seed = (m_seed + curOctave);// & int(0xffffffff);
-		float signal = gradientCoherentNoise3D(pos, seed);
-		signal = 2.0 * abs(signal) - 1.0;
+		float fade = octaveFade(1.0 / freq, minWavelength);
+		float signal = MEAN_ABS_GRADIENT_NOISE;
+		if (fade > 0.0)
+		{
+			int seed = (m_seed + curOctave);// & int(0xffffffff);
+			signal = abs(gradientCoherentNoise3D(pos, seed));
+			if (fade < 1.0)
+				signal = mix(MEAN_ABS_GRADIENT_NOISE, signal, fade);
+		}
+		signal = 2.0 * signal - 1.0;
 		value += signal * curPersistence;
 		pos *= lacunarity;
+		freq *= lacunarity;
 		curPersistence *= persistence;
 	}
 	
 	return value + 0.5;
 }
 
-float billowBest(int m_seed, float freq, float persistence, float lacunarity, int octaves, vec3 pos)
+float billowBest(int m_seed, float freq, float persistence, float lacunarity, int octaves, vec3 pos, float minWavelength)
 {
 	float value = 0.0;
 	float curPersistence = 1.0;
@@ -600,286 +563,35 @@ float billowBest(int m_seed, float freq, float persistence, float lacunarity, in
 
 	for (int curOctave = 0; curOctave < octaves; ++curOctave) 
 	{
-		int seed = (m_seed + curOctave);// & int(0xffffffff);
-		float signal = gradientCoherentNoise3DBest(pos, seed);
-		signal = 2.0 * abs(signal) - 1.0;
+		float fade = octaveFade(1.0 / freq, minWavelength);
+		float signal = MEAN_ABS_GRADIENT_NOISE;
+		if (fade > 0.0)
+		{
+			int seed = (m_seed + curOctave);// & int(0xffffffff);
+			signal = abs(gradientCoherentNoise3DBest(pos, seed));
+			if (fade < 1.0)
+				signal = mix(MEAN_ABS_GRADIENT_NOISE, signal, fade);
+		}
+		signal = 2.0 * signal - 1.0;
 		value += signal * curPersistence;
 		pos *= lacunarity;
+		freq *= lacunarity;
 		curPersistence *= persistence;
 	}
 	
 	return value + 0.5;
 }
 
-float terrace(float value, float[6] points, int numPoints)
-{
-	int maxInd = numPoints - 1;
-	
-	int indexPos;
-	for (indexPos = 0; indexPos <= maxInd; ++indexPos) 
-	{
-		if (value < points[indexPos]) 
-			break;
-	}
-	
-	int index0 = clamp(indexPos - 1, 0, maxInd);
-	int index1 = clamp(indexPos    , 0, maxInd);
-
-	if (index0 == index1)
-		return points[index1];
-
-	float value0 = points[index0];
-	float value1 = points[index1];
-	float alpha = (value - value0) / (value1 - value0);
-	return mix(value0, value1, alpha * alpha);
-}
-
 float expoFunc(float mant, float expo)
 {
 	return pow(abs(0.5*mant + 0.5), expo) * 2.0 - 1.0;
 }
 
-float getBaseContinentDef(vec3 pos, int m_seed)
-{	
-	float baseContinentDef_pe0 = perlin(m_seed, CONTINENT_FREQUENCY, 0.5, CONTINENT_LACUNARITY, 14, pos);
-	float baseContinentDef_cu = curve(baseContinentDef_pe0, BASE_CONTINENT_CURVE_POINTS_IN, BASE_CONTINENT_CURVE_POINTS_OUT, NUM_BASE_CONTINENT_CURVE_POINTS);
-	float baseContinentDef_pe1 = perlin(m_seed + 1, CONTINENT_FREQUENCY * 4.34375, 0.5, CONTINENT_LACUNARITY, 11, pos);
-	float baseContinentDef_sb = baseContinentDef_pe1 * 0.375 + 0.625;
-	float baseContinentDef_mi = min(baseContinentDef_sb, baseContinentDef_cu);
-	float baseContinentDef = clamp(baseContinentDef_mi, -1.0, 1.0);
-	return baseContinentDef;
-}
-
-float getContinentDef(vec3 pos, int m_seed)
-{
-	float baseContinentDef = getBaseContinentDef(pos, m_seed);
-	vec3 pos_continentDef_tu0 = turbulence(pos, m_seed + 10, CONTINENT_FREQUENCY * 15.25, CONTINENT_FREQUENCY / 113.75, 13);
-	vec3 pos_continentDef_tu1 = turbulence(pos_continentDef_tu0, m_seed + 11, CONTINENT_FREQUENCY * 47.25, CONTINENT_FREQUENCY / 433.75, 12);
-	vec3 pos_continentDef_tu2 = turbulence(pos_continentDef_tu1, m_seed + 12, CONTINENT_FREQUENCY * 95.25, CONTINENT_FREQUENCY / 1019.75, 11);
-	float continentDef_tu2 = getBaseContinentDef(pos_continentDef_tu2, m_seed);
-	float continentDef = select(baseContinentDef, continentDef_tu2, baseContinentDef, 0.0625, SEA_LEVEL - 0.0375, SEA_LEVEL + 1000.0375);
-	return continentDef;
-}
-
-float getMountainBaseDef_b1(vec3 pos, int m_seed)
-{
-	float mountainBaseDef_rm0 = ridgedMulti(m_seed + 30, 1723.0, MOUNTAIN_LACUNARITY, 4, pos); // std
-	float mountainBaseDef_sb0 = mountainBaseDef_rm0 * 0.5 + 0.375;
-	float mountainBaseDef_rm1 = ridgedMultiBest(m_seed + 31, 367.0, MOUNTAIN_LACUNARITY, 1, pos); // best
-	float mountainBaseDef_sb1 = mountainBaseDef_rm1 * -2.0 - 0.5;
-	float mountainBaseDef_co = -1.0;
-	float mountainBaseDef_bl = mix(mountainBaseDef_co, mountainBaseDef_sb0, 0.5*mountainBaseDef_sb1 + 0.5);
-	return mountainBaseDef_bl;
-}
+// Generated from libnoise_graph.h by ShaderStages::Compute::initialise
+float getAltitude(vec3 pos, int m_seed, float minWavelength);
 
-float getMountainousHigh_ma(vec3 pos, int m_seed)
+vec4 getColourAndAltitude(vec3 pos, int m_seed, float minWavelength)
 {
-	float mountainousHigh_rm0 = ridgedMultiBest(m_seed + 40, 2371.0, MOUNTAIN_LACUNARITY, 3, pos); // best
-	float mountainousHigh_rm1 = ridgedMultiBest(m_seed + 41, 2341.0, MOUNTAIN_LACUNARITY, 3, pos); // best
-	float mountainousHigh_ma = max(mountainousHigh_rm0, mountainousHigh_rm1);
-	return mountainousHigh_ma;
-}
-
-float getHillyTerrain_ex(vec3 pos, int m_seed)
-{	
-	float hillyTerrain_bi = billow(m_seed + 60, 1663.0, 0.5, HILLS_LACUNARITY, 6, pos); // best
-	float hillyTerrain_sb0 = hillyTerrain_bi * 0.5 + 0.5;
-	float hillyTerrain_rm = ridgedMultiBest(m_seed + 61, 367.5, HILLS_LACUNARITY, 1, pos); // best
-	float hillyTerrain_sb1 = hillyTerrain_rm * -2.0 - 0.5;
-	float hillyTerrain_co = 1.0;
-	float hillyTerrain_bl = mix(hillyTerrain_co, hillyTerrain_sb1, (hillyTerrain_sb0 + 1.0) / 2.0);
-	float hillyTerrain_sb2 = hillyTerrain_bl * 0.75 - 0.25;
-	float hillyTerrain_ex = expoFunc(hillyTerrain_sb2, 1.375);
-	return hillyTerrain_ex;
-}
-
-float getScaledPlainsTerrain(vec3 pos, int m_seed)
-{
-	float plainsTerrain_bi0 = billowBest(m_seed + 70, 1097.5, 0.5, PLAINS_LACUNARITY, 8, pos); // best
-	float plainsTerrain_sb0 = plainsTerrain_bi0 * 0.5 + 0.5;
-	float plainsTerrain_bi1 = billowBest(m_seed + 71, 1319.5, 0.5, PLAINS_LACUNARITY, 8, pos); // best
-	float plainsTerrain_sb1 = plainsTerrain_bi1 * 0.5 + 0.5;
-	float plainsTerrain_mu = plainsTerrain_sb0 * plainsTerrain_sb1;
-	return (plainsTerrain_mu * 2.0 - 1.0) * 0.00390625 + 0.0078125;
-}
-
-float getBadlandsCliffs_te(vec3 pos, int m_seed)
-{
-	float badlandsCliffs_pe = perlin(m_seed + 90, CONTINENT_FREQUENCY * 839.0, 0.5, BADLANDS_LACUNARITY, 6, pos);
-	float badlandsCliffs_cu = curve(badlandsCliffs_pe, BADLANDS_CLIFF_CURVE_POINTS_IN, BADLANDS_CLIFF_CURVE_POINTS_OUT, NUM_BADLANDS_CLIFF_CURVE_POINTS);
-	float badlandsCliffs_cl = clamp(badlandsCliffs_cu, -999.125, 0.875);
-	float badlandsCliffs_te = terrace(badlandsCliffs_cl, BADLANDS_CLIFF_TERRACE_POINTS, NUM_BADLANDS_CLIFF_TERRACE_POINTS);
-	return badlandsCliffs_te;
-}
-
-float getScaledBadlandsTerrain(vec3 pos, int m_seed)
-{	
-	float badlandsSand_rm = ridgedMultiBest(m_seed + 80, 6163.5, BADLANDS_LACUNARITY, 1, pos); // best
-	float badlandsSand_sb0 = badlandsSand_rm * 0.875;
-	float badlandsSand_vo = voronoiWithDistance(m_seed + 81, 16183.25, 0.0, pos); 
-	//float badlandsSand_vo = 0.0; // HACK
-	float badlandsSand_sb1 = badlandsSand_vo * 0.25 + 0.25;
-	float badlandsSand = badlandsSand_sb0 + badlandsSand_sb1;
-	
-	vec3 pos_badlandsCliffs_tu0 = turbulence(pos, m_seed + 91, 16111.0, 1.0 / 141539.0 * BADLANDS_TWIST, 3);
-	vec3 pos_badlandsCliffs_tu1 =  turbulence(pos_badlandsCliffs_tu0, m_seed + 92, 36107.0, 1.0 / 211543.0 * BADLANDS_TWIST, 3);
-	float badlandsCliffs = getBadlandsCliffs_te(pos_badlandsCliffs_tu1, m_seed);
-
-	float badlandsTerrain_sb = badlandsSand * 0.25 - 0.75;
-	return max(badlandsCliffs, badlandsTerrain_sb) * 0.0625 + 0.0625;
-}
-
-float getScaledRiverPositions(vec3 pos, int m_seed)
-{
-	vec3 pos_riverPositions_tu = turbulence(pos, m_seed + 102, 9.25, 1.0 / 57.75, 6);
-
-	float riverPositions_rm0 = ridgedMultiBest(m_seed + 100, 18.75, CONTINENT_LACUNARITY, 1, pos_riverPositions_tu); // best
-	float riverPositions_cu0 = curve(riverPositions_rm0, RIVER_POSITIONS_CURVE0_POINTS_IN, RIVER_POSITIONS_CURVE0_POINTS_OUT, NUM_RIVER_POSITIONS_CURVE0_POINTS);
-	float riverPositions_rm1 = ridgedMultiBest(m_seed + 101, 43.25, CONTINENT_LACUNARITY, 1, pos_riverPositions_tu); // best
-	float riverPositions_cu1 = curve(riverPositions_rm1, RIVER_POSITIONS_CURVE1_POINTS_IN, RIVER_POSITIONS_CURVE1_POINTS_OUT, NUM_RIVER_POSITIONS_CURVE1_POINTS);
-	float riverPositions_mi = min(riverPositions_cu0, riverPositions_cu1);
-
-	return riverPositions_mi * (RIVER_DEPTH / 2.0) - RIVER_DEPTH / 2.0;
-}
-
-float getScaledMountainousTerrain(vec3 pos, int m_seed)
-{
-	vec3 pos_mountainBaseDef_tu0 = turbulence(pos, m_seed + 32, 1337.0, 1.0 / 6730.0 * MOUNTAINS_TWIST, 4);
-	vec3 pos_mountainBaseDef_tu1 = turbulence(pos_mountainBaseDef_tu0, m_seed + 33, 21221.0, 1.0 / 120157.0 * MOUNTAINS_TWIST, 6);
-	float mountainBaseDef = getMountainBaseDef_b1(pos_mountainBaseDef_tu1, m_seed);
-
-	vec3 pos_mountainousHigh_tu = turbulence(pos, m_seed + 42, 31511.0, 1.0 / 180371.0 * MOUNTAINS_TWIST, 4);
-	float mountainousHigh = getMountainousHigh_ma(pos_mountainousHigh_tu, m_seed);
-
-	float mountainousLow_rm0 = ridgedMultiBest(m_seed + 50, 1381.0, MOUNTAIN_LACUNARITY, 8, pos); // best
-	float mountainousLow_rm1 = ridgedMultiBest(m_seed + 51, 1427.0, MOUNTAIN_LACUNARITY, 8, pos); // best
-	float mountainousLow = mountainousLow_rm0 * mountainousLow_rm1;
-	
-	float mountainousTerrain_sb0 = mountainousLow * 0.03125 - 0.96875;
-	float mountainousTerrain_sb1 = mountainousHigh * 0.25 + 0.25;
-	float mountainousTerrain_ad = mountainousTerrain_sb1 + mountainBaseDef;
-	float mountainousTerrain_se = select(mountainousTerrain_sb0, mountainousTerrain_ad, mountainBaseDef, 0.5, -0.5, 999.5);
-	float mountainousTerrain_sb2 = mountainousTerrain_se * 0.8;
-	float mountainousTerrain = expoFunc(mountainousTerrain_sb2, MOUNTAIN_GLACIATION);
-
-	float scaledMountainousTerrain_sb0 = mountainousTerrain * 0.125 + 0.125;
-	float scaledMountainousTerrain_pe = perlin(m_seed + 110, 14.5, 0.5, MOUNTAIN_LACUNARITY, 6, pos);
-	float scaledMountainousTerrain_ex = expoFunc(scaledMountainousTerrain_pe, 1.25);
-	float scaledMountainousTerrain_sb1 = scaledMountainousTerrain_ex * 0.25 + 1.0;
-	return scaledMountainousTerrain_sb0 * scaledMountainousTerrain_sb1;
-}
-
-float getScaledHillyTerrain(vec3 pos, int m_seed)
-{
-	vec3 pos_hillyTerrain_tu0 = turbulence(pos, m_seed + 62, 1531.0, 1.0 / 16921.0 * HILLS_TWIST, 4);
-	vec3 pos_hillyTerrain_tu1 = turbulence(pos_hillyTerrain_tu0, m_seed + 63, 21617.0, 1.0 / 117529.0 * HILLS_TWIST, 6);
-	float hillyTerrain = getHillyTerrain_ex(pos_hillyTerrain_tu1, m_seed);
-
-	float scaledHillyTerrain_sb0 = hillyTerrain * 0.0625 + 0.0625;
-	float scaledHillyTerrain_pe = perlin(m_seed + 120, 13.5, 0.5, HILLS_LACUNARITY, 6, pos);
-	float scaledHillyTerrain_ex = expoFunc(scaledHillyTerrain_pe, 1.25);
-	float scaledHillyTerrain_sb1 = scaledHillyTerrain_ex * 0.5 + 1.5;
-	return scaledHillyTerrain_sb0 * scaledHillyTerrain_sb1;
-}
-
-float getTerrainTypeDef(vec3 pos, int m_seed)
-{
-	vec3 pos_terrainTypeDef_tu = turbulence(pos, m_seed + 20, CONTINENT_FREQUENCY * 18.125, CONTINENT_FREQUENCY / 20.59375 * TERRAIN_OFFSET, 3);
-	float terrainTypeDef_tu = getContinentDef(pos_terrainTypeDef_tu, m_seed);
-	return terrace(terrainTypeDef_tu, TERRAIN_TYPE_TERRACE_POINTS, NUM_TERRAIN_TYPE_TERRACE_POINTS);
-}
-
-float getBaseContinentElev(vec3 pos, int m_seed, float continentDef)
-{
-	float continentalShelf_te = terrace(continentDef, CONTINENTAL_SHELF_TERRACE_POINTS, NUM_CONTINENTAL_SHELF_TERRACE_POINTS);
-	float continentalShelf_rm = ridgedMultiBest(m_seed + 130, CONTINENT_FREQUENCY * 4.375, CONTINENT_LACUNARITY, 16, pos); // best
-	float continentalShelf_sb = continentalShelf_rm * -0.125 - 0.125;
-	float continentalShelf_cl = clamp(continentalShelf_te, -0.75, SEA_LEVEL);
-	float continentalShelf_ad = continentalShelf_sb + continentalShelf_cl;
-	float continentalShelf = continentalShelf_ad;
-
-	float baseContinentElev_sb = continentDef * CONTINENT_HEIGHT_SCALE;
-
-	float baseContinentElev_se = select(
-		baseContinentElev_sb, 
-		continentalShelf, 
-		continentDef, 
-		0.03125, SHELF_LEVEL - 1000.0, SHELF_LEVEL
-	);
-
-	return baseContinentElev_se;
-}
-
-float getContinentsWithMountains(vec3 pos, int m_seed, float baseContinentElev, float continentDef)
-{
-	float scaledPlainsTerrain = getScaledPlainsTerrain(pos, m_seed);
-	float scaledHillyTerrain = getScaledHillyTerrain(pos, m_seed);
-	float continentsWithPlains = baseContinentElev + scaledPlainsTerrain;
-	float terrainTypeDef = getTerrainTypeDef(pos, m_seed);
-	float scaledMountainousTerrain = getScaledMountainousTerrain(pos, m_seed);
-
-	float continentsWithHills_ad = baseContinentElev + scaledHillyTerrain;
-	float continentsWithHills = select(continentsWithPlains, continentsWithHills_ad, terrainTypeDef, 0.25, 1.0 - HILLS_AMOUNT, 1001.0 - HILLS_AMOUNT);
-
-	float continentsWithMountains_ad0 = baseContinentElev + scaledMountainousTerrain;
-	float continentsWithMountains_cu = curve(continentDef, CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_IN, CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_OUT, NUM_CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS);
-	float continentsWithMountains_ad1 = continentsWithMountains_ad0 + continentsWithMountains_cu;
-	return select(continentsWithHills, continentsWithMountains_ad1, terrainTypeDef, 0.25, 1.0 - MOUNTAINS_AMOUNT, 1001.0 - MOUNTAINS_AMOUNT);
-}
-
-float getContinentsWithBadlands(vec3 pos, int m_seed)
-{
-	float continentDef = getContinentDef(pos, m_seed);
-	float baseContinentElev = getBaseContinentElev(pos, m_seed, continentDef);
-	float scaledBadlandsTerrain = getScaledBadlandsTerrain(pos, m_seed);
-	float continentsWithMountains = getContinentsWithMountains(pos, m_seed, baseContinentElev, continentDef);
-	
-	float continentsWithBadlands_se = select(
-		continentsWithMountains, 
-		baseContinentElev + scaledBadlandsTerrain, 
-		perlin(m_seed + 140, 16.5, 0.5, CONTINENT_LACUNARITY, 2, pos), 
-		0.25, 1.0 - BADLANDS_AMOUNT, 1001.0 - BADLANDS_AMOUNT
-	);
-	return max(continentsWithMountains, continentsWithBadlands_se);
-}
-
-const vec4 CH[10] = {
-	vec4(0.0, 0.0, 0.0,                                                 -2.0),
-	vec4(0.023529411764705882, 0.22745098039215686, 0.4980392156862745, -0.03125),
-	vec4(0.054901960784313725, 0.4392156862745098, 0.7529411764705882,  -0.0001220703125),
-	vec4(234.0/255.0, 206.0/255.0, 106.0/255.0,  0.0),
-	vec4(0.27450980392156865, 0.47058823529411764, 0.23529411764705882,  0.01),
-	vec4(0.43137254901960786, 0.5490196078431373, 0.29411764705882354,   0.125),
-	vec4(0.6274509803921569, 0.5490196078431373, 0.43529411764705883,    0.25),
-	vec4(0.7215686274509804, 0.6392156862745098, 0.5529411764705883,     0.375),
-	vec4(1.0, 1.0, 1.0,                                                  0.75),
-	vec4(0.5019607843137255, 1.0, 1.0,                                   2.0)
-};
-
-vec3 getColour(float altitude)
-{
-	if (altitude < CH[0].w)
-		return CH[0].xyz;
-		
-	for (int i = 1; i < 10; ++i)
-		if (altitude < CH[i].w)
-			return mix(CH[i-1].xyz, CH[i].xyz, (altitude-CH[i-1].w)/(CH[i].w-CH[i-1].w));
-			
-	return vec3(0.0, 0.0, 1.0);
-}
-
-vec4 getColourAndAltitude(vec3 pos, int m_seed)
-{
-	float continentsWithBadlands = getContinentsWithBadlands(pos, m_seed);
-	float scaledRiverPositions = getScaledRiverPositions(pos, m_seed);
-
-	float altitude = select(
-		continentsWithBadlands, 
-		continentsWithBadlands + scaledRiverPositions, 
-		continentsWithBadlands, 
-		CONTINENT_HEIGHT_SCALE - SEA_LEVEL, SEA_LEVEL, CONTINENT_HEIGHT_SCALE + SEA_LEVEL
-	);
-
+	float altitude = getAltitude(pos, m_seed, minWavelength);
 	return vec4(getColour(altitude), 1.0 + 0.0005*altitude);
 }
-
@@ -0,0 +1,145 @@
+// Terrain colour ramp, and the compact patch vertex format (CompactPatchVertexData
+// in planet_data_buffer.h). Shared by the terrain generators and the terrain and
+// water draw shaders; COMPACT_VERTICES and VERTICES_PER_SIDE are defined first.
+
+// Colour, then the altitude it is reached at; TERRAIN_COLOUR_HEIGHTS in cpu_terrain.h
+const vec4 CH[10] = {
+	vec4(0.0, 0.0, 0.0,                                                 -2.0),
+	vec4(0.023529411764705882, 0.22745098039215686, 0.4980392156862745, -0.03125),
+	vec4(0.054901960784313725, 0.4392156862745098, 0.7529411764705882,  -0.0001220703125),
+	vec4(234.0/255.0, 206.0/255.0, 106.0/255.0,  0.0),
+	vec4(0.27450980392156865, 0.47058823529411764, 0.23529411764705882,  0.01),
+	vec4(0.43137254901960786, 0.5490196078431373, 0.29411764705882354,   0.125),
+	vec4(0.6274509803921569, 0.5490196078431373, 0.43529411764705883,    0.25),
+	vec4(0.7215686274509804, 0.6392156862745098, 0.5529411764705883,     0.375),
+	vec4(1.0, 1.0, 1.0,                                                  0.75),
+	vec4(0.5019607843137255, 1.0, 1.0,                                   2.0)
+};
+
+// 0 below the ramp, i between entries i-1 and i, 10 above it
+uint getColourBand(float altitude)
+{
+	uint band = 0;
+	while (band < 10 && altitude >= CH[band].w)
+		++band;
+	return band;
+}
+
+vec3 getBandColour(uint band, float altitude)
+{
+	if (band == 0)
+		return CH[0].xyz;
+	if (band >= 10)
+		return vec3(0.0, 0.0, 1.0);
+
+	const vec4 lo = CH[band-1];
+	const vec4 hi = CH[band];
+	return mix(lo.xyz, hi.xyz, clamp((altitude-lo.w)/(hi.w-lo.w), 0.0, 1.0));
+}
+
+vec3 getColour(float altitude)
+{
+	return getBandColour(getColourBand(altitude), altitude);
+}
+
+#if COMPACT_VERTICES
+
+#define TOTAL_VERTICES (VERTICES_PER_SIDE*VERTICES_PER_SIDE)
+
+// Bare rock, shown on steep land
+const vec3 ROCK_COLOUR = vec3(0.45, 0.4, 0.35);
+
+// As PatchInfo in planet_data_buffer.h, one per slot of the page whose buffers are bound
+struct PatchInfo
+{
+	vec4 details; // Orientation (top 3 bits), step size, dim0 and dim1 of the first vertex
+	vec4 range;   // Radius at height 0, radius per height step, radius per unit of colour ramp altitude
+};
+
+layout (std430, binding=2) buffer PatchInfos
+{
+	PatchInfo patchInfos[];
+};
+
+// ORIENTATION_MATRICES in terrain_generators.cpp, which are uploaded
+// transposed, so these multiply row vectors
+const mat3 PATCH_ORIENTATIONS[6] = {
+	mat3(-1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 1.0, 0.0),
+	mat3(1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, -1.0, 0.0),
+	mat3(0.0, 1.0, 0.0, -1.0, 0.0, 0.0, 0.0, 0.0, 1.0),
+	mat3(0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, -1.0),
+	mat3(0.0, -1.0, 0.0, 0.0, 0.0, 1.0, -1.0, 0.0, 0.0),
+	mat3(0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0)
+};
+
+vec2 signNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit normal to 8 bits per coordinate of its octahedral mapping
+uint encodeOctahedral(vec3 normal)
+{
+	vec2 p = normal.xy / (abs(normal.x) + abs(normal.y) + abs(normal.z));
+	if (normal.z < 0.0)
+		p = (1.0 - abs(p.yx)) * signNotZero(p); // Fold the lower hemisphere over the diagonals
+
+	const uvec2 bits = uvec2((p*0.5 + 0.5)*255.0 + 0.5);
+	return bits.x | (bits.y << 8);
+}
+
+vec3 decodeOctahedral(uint bits)
+{
+	const vec2 p = vec2(bits & 0xff, (bits >> 8) & 0xff) * (2.0/255.0) - 1.0;
+	vec3 normal = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+	if (normal.z < 0.0)
+		normal.xy = (1.0 - abs(normal.yx)) * signNotZero(normal.xy);
+	return normalize(normal);
+}
+
+// radius is the vertex's radial scale, as the generators return it
+uvec2 encodeCompactVertex(uint patchOffset, float radius, vec3 normal)
+{
+	const vec4 range = patchInfos[patchOffset].range;
+	const float height = range.y > 0.0 ? (radius - range.x) / range.y : 0.0;
+
+	return uvec2(
+		uint(clamp(height + 0.5, 0.0, 65535.0)) | (encodeOctahedral(normal) << 16),
+		getColourBand((radius - 1.0) / range.z)
+	);
+}
+
+// Unit sphere direction of a compact vertex, from its place in its patch's
+// grid. vertexId is gl_VertexID, which includes the draw's base vertex and
+// so also gives the slot in the page whose buffers are bound.
+vec3 getCompactVertexDirection(int vertexId)
+{
+	const uint index = uint(vertexId) % TOTAL_VERTICES;
+	const vec4 details = patchInfos[uint(vertexId) / TOTAL_VERTICES].details;
+
+	// As getVertexPositionSphereSpace() in terrain_cs.glsl
+	const vec3 cubePos = vec3(
+		1.0,
+		details[2] + details[1]*(index % VERTICES_PER_SIDE),
+		details[3] + details[1]*(index / VERTICES_PER_SIDE)
+	) * PATCH_ORIENTATIONS[floatBitsToUint(details[0]) >> 29];
+	return normalize(cubePos);
+}
+
+void decodeCompactVertex(uvec2 data, int vertexId, out vec3 position, out vec3 normal, out vec3 colour)
+{
+	const vec4 range = patchInfos[uint(vertexId) / TOTAL_VERTICES].range;
+	const vec3 direction = getCompactVertexDirection(vertexId);
+	const float radius = range.x + range.y*(data.x & 0xffff);
+
+	position = direction * radius;
+	normal = decodeOctahedral(data.x >> 16);
+
+	// Colour by altitude, turning to rock as land steepens
+	const float altitude = (radius - 1.0) / range.z;
+	colour = getBandColour(data.y, altitude);
+	if (altitude > 0.0)
+		colour = mix(colour, ROCK_COLOUR, smoothstep(0.2, 0.5, 1.0 - dot(normal, direction)));
+}
+
+#endif
@@ -0,0 +1,325 @@
+#pragma once
+
+// The Libnoise terrain generator as a noise module graph (see noise_graph.h):
+// the complex planet example of libnoise, evaluated on the unit sphere.
+// cpu_terrain_kernels.inl evaluates it directly; the compute shader gets it
+// as getAltitude(), emitted by ShaderStages::Compute::initialise.
+
+namespace LibnoiseGraph
+{
+
+const float CONTINENT_FREQUENCY = 1.0f;
+const float CONTINENT_LACUNARITY = 2.208984375f;
+const float MOUNTAIN_LACUNARITY = 2.142578125f;
+const float HILLS_LACUNARITY = 2.162109375f;
+const float PLAINS_LACUNARITY = 2.314453125f;
+const float BADLANDS_LACUNARITY = 2.212890625f;
+const float MOUNTAINS_TWIST = 1.0f;
+const float HILLS_TWIST = 1.0f;
+const float BADLANDS_TWIST = 1.0f;
+const float SEA_LEVEL = 0.0f;
+const float SHELF_LEVEL = -0.375f;
+const float MOUNTAINS_AMOUNT = 0.5f;
+const float BADLANDS_AMOUNT = 0.03125f;
+const float TERRAIN_OFFSET = 1.0f;
+const float MOUNTAIN_GLACIATION = 1.375f;
+const float RIVER_DEPTH = 0.0234375f;
+const float HILLS_AMOUNT = (1.0f + MOUNTAINS_AMOUNT) / 2.0f;
+const float CONTINENT_HEIGHT_SCALE = (1.0f - SEA_LEVEL) / 4.0f;
+
+const float CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_IN[]  = { -1.0f, 0.0f, 1.0f - MOUNTAINS_AMOUNT, 1.0f };
+const float CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_OUT[] = { -0.0625f, 0.0f, 0.0625f, 0.25f };
+
+const float RIVER_POSITIONS_CURVE0_POINTS_IN[]  = { -2.0f, -1.0f, -0.125f, 0.0f, 1.0f, 2.0f };
+const float RIVER_POSITIONS_CURVE0_POINTS_OUT[] = { 2.0f, 1.0f, 0.875f, -1.0f, -1.5f, -2.0f };
+
+const float RIVER_POSITIONS_CURVE1_POINTS_IN[]  = { -2.0f, -1.0f, -0.125f, 0.0f, 1.0f, 2.0f };
+const float RIVER_POSITIONS_CURVE1_POINTS_OUT[] = { 2.0f, 1.5f, 1.4375f, 0.5f, 0.25f, 0.0f };
+
+const float BADLANDS_CLIFF_CURVE_POINTS_IN[]  = { -2.0f, -1.0f, 0.0f, 0.5f, 0.625f, 0.75f, 2.0f };
+const float BADLANDS_CLIFF_CURVE_POINTS_OUT[] = { -2.0f, -1.25f, -0.75f, -0.25f, 0.875f, 1.0f, 1.25f };
+
+const float BASE_CONTINENT_CURVE_POINTS_IN[] = {
+	-2.0000f + SEA_LEVEL, -1.0000f + SEA_LEVEL, SEA_LEVEL, 0.0625f + SEA_LEVEL, 0.1250f + SEA_LEVEL,
+	0.2500f + SEA_LEVEL, 0.5000f + SEA_LEVEL, 0.7500f + SEA_LEVEL, 1.0000f + SEA_LEVEL, 2.0000f + SEA_LEVEL
+};
+const float BASE_CONTINENT_CURVE_POINTS_OUT[] = {
+	-1.625f + SEA_LEVEL, -1.375f + SEA_LEVEL, -0.375f + SEA_LEVEL, 0.125f + SEA_LEVEL, 0.250f + SEA_LEVEL,
+	1.000f + SEA_LEVEL, 0.250f + SEA_LEVEL, 0.250f + SEA_LEVEL, 0.500f + SEA_LEVEL, 0.500f + SEA_LEVEL
+};
+
+const float CONTINENTAL_SHELF_TERRACE_POINTS[] = { -1.0f, -0.75f, SHELF_LEVEL, 1.0f };
+const float TERRAIN_TYPE_TERRACE_POINTS[] = { -1.0f, SHELF_LEVEL + SEA_LEVEL / 2.0f, 1.0f };
+const float BADLANDS_CLIFF_TERRACE_POINTS[] = { -1.0f, -0.875f, -0.75f, -0.5f, 0.0f, 1.0f };
+
+template <typename B>
+typename B::Value baseContinentDef(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value baseContinentDef_pe0 = b.perlin(pos, 0, CONTINENT_FREQUENCY, 0.5f, CONTINENT_LACUNARITY, 14);
+	const Value baseContinentDef_cu = b.curve(baseContinentDef_pe0, BASE_CONTINENT_CURVE_POINTS_IN, BASE_CONTINENT_CURVE_POINTS_OUT);
+	const Value baseContinentDef_pe1 = b.perlin(pos, 1, CONTINENT_FREQUENCY * 4.34375f, 0.5f, CONTINENT_LACUNARITY, 11);
+	const Value baseContinentDef_sb = b.scaleBias(baseContinentDef_pe1, 0.375f, 0.625f);
+	const Value baseContinentDef_mi = b.min(baseContinentDef_sb, baseContinentDef_cu);
+	return b.clamp(baseContinentDef_mi, -1.0f, 1.0f);
+}
+
+template <typename B>
+typename B::Value continentDef(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+	typedef typename B::Position Position;
+
+	const Value baseContinentDef_ = baseContinentDef(b, pos);
+	const Position pos_continentDef_tu0 = b.turbulence(pos, 10, CONTINENT_FREQUENCY * 15.25f, CONTINENT_FREQUENCY / 113.75f, 13);
+	const Position pos_continentDef_tu1 = b.turbulence(pos_continentDef_tu0, 11, CONTINENT_FREQUENCY * 47.25f, CONTINENT_FREQUENCY / 433.75f, 12);
+	const Position pos_continentDef_tu2 = b.turbulence(pos_continentDef_tu1, 12, CONTINENT_FREQUENCY * 95.25f, CONTINENT_FREQUENCY / 1019.75f, 11);
+	const Value continentDef_tu2 = baseContinentDef(b, pos_continentDef_tu2);
+	return b.select(baseContinentDef_, continentDef_tu2, baseContinentDef_, 0.0625f, SEA_LEVEL - 0.0375f, SEA_LEVEL + 1000.0375f);
+}
+
+template <typename B>
+typename B::Value mountainBaseDef_b1(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value mountainBaseDef_rm0 = b.ridgedMulti(pos, 30, 1723.0f, MOUNTAIN_LACUNARITY, 4);
+	const Value mountainBaseDef_sb0 = b.scaleBias(mountainBaseDef_rm0, 0.5f, 0.375f);
+	const Value mountainBaseDef_rm1 = b.ridgedMultiBest(pos, 31, 367.0f, MOUNTAIN_LACUNARITY, 1);
+	const Value mountainBaseDef_sb1 = b.scaleBias(mountainBaseDef_rm1, -2.0f, -0.5f);
+	const Value mountainBaseDef_co = b.constant(-1.0f);
+	return b.blend(mountainBaseDef_co, mountainBaseDef_sb0, mountainBaseDef_sb1);
+}
+
+template <typename B>
+typename B::Value mountainousHigh_ma(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value mountainousHigh_rm0 = b.ridgedMultiBest(pos, 40, 2371.0f, MOUNTAIN_LACUNARITY, 3);
+	const Value mountainousHigh_rm1 = b.ridgedMultiBest(pos, 41, 2341.0f, MOUNTAIN_LACUNARITY, 3);
+	return b.max(mountainousHigh_rm0, mountainousHigh_rm1);
+}
+
+template <typename B>
+typename B::Value hillyTerrain_ex(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value hillyTerrain_bi = b.billow(pos, 60, 1663.0f, 0.5f, HILLS_LACUNARITY, 6);
+	const Value hillyTerrain_sb0 = b.scaleBias(hillyTerrain_bi, 0.5f, 0.5f);
+	const Value hillyTerrain_rm = b.ridgedMultiBest(pos, 61, 367.5f, HILLS_LACUNARITY, 1);
+	const Value hillyTerrain_sb1 = b.scaleBias(hillyTerrain_rm, -2.0f, -0.5f);
+	const Value hillyTerrain_co = b.constant(1.0f);
+	const Value hillyTerrain_bl = b.blend(hillyTerrain_co, hillyTerrain_sb1, hillyTerrain_sb0);
+	const Value hillyTerrain_sb2 = b.scaleBias(hillyTerrain_bl, 0.75f, -0.25f);
+	return b.exponent(hillyTerrain_sb2, 1.375f);
+}
+
+template <typename B>
+typename B::Value scaledPlainsTerrain(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value plainsTerrain_bi0 = b.billowBest(pos, 70, 1097.5f, 0.5f, PLAINS_LACUNARITY, 8);
+	const Value plainsTerrain_sb0 = b.scaleBias(plainsTerrain_bi0, 0.5f, 0.5f);
+	const Value plainsTerrain_bi1 = b.billowBest(pos, 71, 1319.5f, 0.5f, PLAINS_LACUNARITY, 8);
+	const Value plainsTerrain_sb1 = b.scaleBias(plainsTerrain_bi1, 0.5f, 0.5f);
+	const Value plainsTerrain_mu = b.multiply(plainsTerrain_sb0, plainsTerrain_sb1);
+	const Value plainsTerrain = b.scaleBias(plainsTerrain_mu, 2.0f, -1.0f);
+	return b.scaleBias(plainsTerrain, 0.00390625f, 0.0078125f);
+}
+
+template <typename B>
+typename B::Value badlandsCliffs_te(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value badlandsCliffs_pe = b.perlin(pos, 90, CONTINENT_FREQUENCY * 839.0f, 0.5f, BADLANDS_LACUNARITY, 6);
+	const Value badlandsCliffs_cu = b.curve(badlandsCliffs_pe, BADLANDS_CLIFF_CURVE_POINTS_IN, BADLANDS_CLIFF_CURVE_POINTS_OUT);
+	const Value badlandsCliffs_cl = b.clamp(badlandsCliffs_cu, -999.125f, 0.875f);
+	return b.terrace(badlandsCliffs_cl, BADLANDS_CLIFF_TERRACE_POINTS);
+}
+
+template <typename B>
+typename B::Value scaledBadlandsTerrain(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+	typedef typename B::Position Position;
+
+	const Value badlandsSand_rm = b.ridgedMultiBest(pos, 80, 6163.5f, BADLANDS_LACUNARITY, 1);
+	const Value badlandsSand_sb0 = b.scaleBias(badlandsSand_rm, 0.875f, 0.0f);
+	const Value badlandsSand_vo = b.voronoi(pos, 81, 16183.25f, 0.0f);
+	const Value badlandsSand_sb1 = b.scaleBias(badlandsSand_vo, 0.25f, 0.25f);
+	const Value badlandsSand = b.add(badlandsSand_sb0, badlandsSand_sb1);
+
+	const Position pos_badlandsCliffs_tu0 = b.turbulence(pos, 91, 16111.0f, 1.0f / 141539.0f * BADLANDS_TWIST, 3);
+	const Position pos_badlandsCliffs_tu1 = b.turbulence(pos_badlandsCliffs_tu0, 92, 36107.0f, 1.0f / 211543.0f * BADLANDS_TWIST, 3);
+	const Value badlandsCliffs = badlandsCliffs_te(b, pos_badlandsCliffs_tu1);
+
+	const Value badlandsTerrain_sb = b.scaleBias(badlandsSand, 0.25f, -0.75f);
+	const Value badlandsTerrain = b.max(badlandsCliffs, badlandsTerrain_sb);
+	return b.scaleBias(badlandsTerrain, 0.0625f, 0.0625f);
+}
+
+template <typename B>
+typename B::Value scaledRiverPositions(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+	typedef typename B::Position Position;
+
+	const Position pos_riverPositions_tu = b.turbulence(pos, 102, 9.25f, 1.0f / 57.75f, 6);
+
+	const Value riverPositions_rm0 = b.ridgedMultiBest(pos_riverPositions_tu, 100, 18.75f, CONTINENT_LACUNARITY, 1);
+	const Value riverPositions_cu0 = b.curve(riverPositions_rm0, RIVER_POSITIONS_CURVE0_POINTS_IN, RIVER_POSITIONS_CURVE0_POINTS_OUT);
+	const Value riverPositions_rm1 = b.ridgedMultiBest(pos_riverPositions_tu, 101, 43.25f, CONTINENT_LACUNARITY, 1);
+	const Value riverPositions_cu1 = b.curve(riverPositions_rm1, RIVER_POSITIONS_CURVE1_POINTS_IN, RIVER_POSITIONS_CURVE1_POINTS_OUT);
+	const Value riverPositions_mi = b.min(riverPositions_cu0, riverPositions_cu1);
+
+	return b.scaleBias(riverPositions_mi, RIVER_DEPTH / 2.0f, -RIVER_DEPTH / 2.0f);
+}
+
+template <typename B>
+typename B::Value scaledMountainousTerrain(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+	typedef typename B::Position Position;
+
+	const Position pos_mountainBaseDef_tu0 = b.turbulence(pos, 32, 1337.0f, 1.0f / 6730.0f * MOUNTAINS_TWIST, 4);
+	const Position pos_mountainBaseDef_tu1 = b.turbulence(pos_mountainBaseDef_tu0, 33, 21221.0f, 1.0f / 120157.0f * MOUNTAINS_TWIST, 6);
+	const Value mountainBaseDef = mountainBaseDef_b1(b, pos_mountainBaseDef_tu1);
+
+	const Position pos_mountainousHigh_tu = b.turbulence(pos, 42, 31511.0f, 1.0f / 180371.0f * MOUNTAINS_TWIST, 4);
+	const Value mountainousHigh = mountainousHigh_ma(b, pos_mountainousHigh_tu);
+
+	const Value mountainousLow_rm0 = b.ridgedMultiBest(pos, 50, 1381.0f, MOUNTAIN_LACUNARITY, 8);
+	const Value mountainousLow_rm1 = b.ridgedMultiBest(pos, 51, 1427.0f, MOUNTAIN_LACUNARITY, 8);
+	const Value mountainousLow = b.multiply(mountainousLow_rm0, mountainousLow_rm1);
+
+	const Value mountainousTerrain_sb0 = b.scaleBias(mountainousLow, 0.03125f, -0.96875f);
+	const Value mountainousTerrain_sb1 = b.scaleBias(mountainousHigh, 0.25f, 0.25f);
+	const Value mountainousTerrain_ad = b.add(mountainousTerrain_sb1, mountainBaseDef);
+	const Value mountainousTerrain_se = b.select(mountainousTerrain_sb0, mountainousTerrain_ad, mountainBaseDef, 0.5f, -0.5f, 999.5f);
+	const Value mountainousTerrain_sb2 = b.scaleBias(mountainousTerrain_se, 0.8f, 0.0f);
+	const Value mountainousTerrain = b.exponent(mountainousTerrain_sb2, MOUNTAIN_GLACIATION);
+
+	const Value scaledMountainousTerrain_sb0 = b.scaleBias(mountainousTerrain, 0.125f, 0.125f);
+	const Value scaledMountainousTerrain_pe = b.perlin(pos, 110, 14.5f, 0.5f, MOUNTAIN_LACUNARITY, 6);
+	const Value scaledMountainousTerrain_ex = b.exponent(scaledMountainousTerrain_pe, 1.25f);
+	const Value scaledMountainousTerrain_sb1 = b.scaleBias(scaledMountainousTerrain_ex, 0.25f, 1.0f);
+	return b.multiply(scaledMountainousTerrain_sb0, scaledMountainousTerrain_sb1);
+}
+
+template <typename B>
+typename B::Value scaledHillyTerrain(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+	typedef typename B::Position Position;
+
+	const Position pos_hillyTerrain_tu0 = b.turbulence(pos, 62, 1531.0f, 1.0f / 16921.0f * HILLS_TWIST, 4);
+	const Position pos_hillyTerrain_tu1 = b.turbulence(pos_hillyTerrain_tu0, 63, 21617.0f, 1.0f / 117529.0f * HILLS_TWIST, 6);
+	const Value hillyTerrain = hillyTerrain_ex(b, pos_hillyTerrain_tu1);
+
+	const Value scaledHillyTerrain_sb0 = b.scaleBias(hillyTerrain, 0.0625f, 0.0625f);
+	const Value scaledHillyTerrain_pe = b.perlin(pos, 120, 13.5f, 0.5f, HILLS_LACUNARITY, 6);
+	const Value scaledHillyTerrain_ex = b.exponent(scaledHillyTerrain_pe, 1.25f);
+	const Value scaledHillyTerrain_sb1 = b.scaleBias(scaledHillyTerrain_ex, 0.5f, 1.5f);
+	return b.multiply(scaledHillyTerrain_sb0, scaledHillyTerrain_sb1);
+}
+
+template <typename B>
+typename B::Value terrainTypeDef(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+	typedef typename B::Position Position;
+
+	const Position pos_terrainTypeDef_tu = b.turbulence(pos, 20, CONTINENT_FREQUENCY * 18.125f, CONTINENT_FREQUENCY / 20.59375f * TERRAIN_OFFSET, 3);
+	const Value terrainTypeDef_tu = continentDef(b, pos_terrainTypeDef_tu);
+	return b.terrace(terrainTypeDef_tu, TERRAIN_TYPE_TERRACE_POINTS);
+}
+
+template <typename B>
+typename B::Value baseContinentElev(B& b, const typename B::Position& pos, const typename B::Value& continentDef_)
+{
+	typedef typename B::Value Value;
+
+	const Value continentalShelf_te = b.terrace(continentDef_, CONTINENTAL_SHELF_TERRACE_POINTS);
+	const Value continentalShelf_rm = b.ridgedMultiBest(pos, 130, CONTINENT_FREQUENCY * 4.375f, CONTINENT_LACUNARITY, 16);
+	const Value continentalShelf_sb = b.scaleBias(continentalShelf_rm, -0.125f, -0.125f);
+	const Value continentalShelf_cl = b.clamp(continentalShelf_te, -0.75f, SEA_LEVEL);
+	const Value continentalShelf = b.add(continentalShelf_sb, continentalShelf_cl);
+
+	const Value baseContinentElev_sb = b.scaleBias(continentDef_, CONTINENT_HEIGHT_SCALE, 0.0f);
+
+	return b.select(
+		baseContinentElev_sb,
+		continentalShelf,
+		continentDef_,
+		0.03125f, SHELF_LEVEL - 1000.0f, SHELF_LEVEL
+	);
+}
+
+template <typename B>
+typename B::Value continentsWithMountains(
+	B& b, const typename B::Position& pos,
+	const typename B::Value& baseContinentElev_, const typename B::Value& continentDef_
+)
+{
+	typedef typename B::Value Value;
+
+	const Value scaledPlainsTerrain_ = scaledPlainsTerrain(b, pos);
+	const Value scaledHillyTerrain_ = scaledHillyTerrain(b, pos);
+	const Value continentsWithPlains = b.add(baseContinentElev_, scaledPlainsTerrain_);
+	const Value terrainTypeDef_ = terrainTypeDef(b, pos);
+	const Value scaledMountainousTerrain_ = scaledMountainousTerrain(b, pos);
+
+	const Value continentsWithHills_ad = b.add(baseContinentElev_, scaledHillyTerrain_);
+	const Value continentsWithHills = b.select(continentsWithPlains, continentsWithHills_ad, terrainTypeDef_, 0.25f, 1.0f - HILLS_AMOUNT, 1001.0f - HILLS_AMOUNT);
+
+	const Value continentsWithMountains_ad0 = b.add(baseContinentElev_, scaledMountainousTerrain_);
+	const Value continentsWithMountains_cu = b.curve(continentDef_, CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_IN, CONTINENTS_WITH_MOUNTAINS_CURVE_POINTS_OUT);
+	const Value continentsWithMountains_ad1 = b.add(continentsWithMountains_ad0, continentsWithMountains_cu);
+	return b.select(continentsWithHills, continentsWithMountains_ad1, terrainTypeDef_, 0.25f, 1.0f - MOUNTAINS_AMOUNT, 1001.0f - MOUNTAINS_AMOUNT);
+}
+
+template <typename B>
+typename B::Value continentsWithBadlands(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value continentDef_ = continentDef(b, pos);
+	const Value baseContinentElev_ = baseContinentElev(b, pos, continentDef_);
+	const Value scaledBadlandsTerrain_ = scaledBadlandsTerrain(b, pos);
+	const Value continentsWithMountains_ = continentsWithMountains(b, pos, baseContinentElev_, continentDef_);
+
+	const Value continentsWithBadlands_ad = b.add(baseContinentElev_, scaledBadlandsTerrain_);
+	const Value continentsWithBadlands_pe = b.perlin(pos, 140, 16.5f, 0.5f, CONTINENT_LACUNARITY, 2);
+	const Value continentsWithBadlands_se = b.select(
+		continentsWithMountains_,
+		continentsWithBadlands_ad,
+		continentsWithBadlands_pe,
+		0.25f, 1.0f - BADLANDS_AMOUNT, 1001.0f - BADLANDS_AMOUNT
+	);
+	return b.max(continentsWithMountains_, continentsWithBadlands_se);
+}
+
+// Unscaled altitude, 0 at sea level; the caller derives colour and radius from it
+template <typename B>
+typename B::Value altitude(B& b, const typename B::Position& pos)
+{
+	typedef typename B::Value Value;
+
+	const Value continentsWithBadlands_ = continentsWithBadlands(b, pos);
+	const Value scaledRiverPositions_ = scaledRiverPositions(b, pos);
+	const Value continentsWithRivers = b.add(continentsWithBadlands_, scaledRiverPositions_);
+
+	return b.select(
+		continentsWithBadlands_,
+		continentsWithRivers,
+		continentsWithBadlands_,
+		CONTINENT_HEIGHT_SCALE - SEA_LEVEL, SEA_LEVEL, CONTINENT_HEIGHT_SCALE + SEA_LEVEL
+	);
+}
+
+} // namespace LibnoiseGraph
@@ -12,6 +12,8 @@
 #include "camera.h"
 #include "compute_queue.h"
 #include "planet_data_buffer.h"
+#include "patch_worker_pool.h"
+#include "frame_task_pool.h"
 #include "world_clock.h"
 #include "fullscreen_quad.h"
 #include "gbuffer.h"
@@ -80,6 +82,8 @@ int _main(int argc, char** argv)
 
 		GLOBALS.initialise();
 		initPlanetDataBufferAndConstants();
+		initPatchWorkerPool();
+		initFrameTaskPool();
 		ShaderStages::initialise();
 		initialiseSkyBox();
 	
@@ -225,6 +229,8 @@ int _main(int argc, char** argv)
 	);
 
 	GLOBALS.m_shuttingDown = true;
+	PATCH_WORKER_POOL->stop();
+	FRAME_TASK_POOL->stop();
  
 	// Close GUI and OpenGL window, and terminate GLFW
 	killOverlay();
@@ -5,3 +5,8 @@
 GLuint initPermTexture();
 GLuint initSimplexTexture();
 GLuint initGradTexture();
+
+// Source tables of the textures above; the CPU terrain kernels read them directly
+extern int perm[256];
+extern int grad3[16][3];
+extern unsigned char simplex4[64][4];
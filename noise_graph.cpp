@@ -0,0 +1,242 @@
+#include <iomanip>
+
+#include "noise_graph.h"
+
+static void writeArray(std::ostream& out, const char* name, const float* values, int count)
+{
+	out << "\tconst float " << name << "[" << count << "] = float[](";
+	for (int i = 0; i < count; ++i)
+		out << (i ? ", " : "") << GLSLNoiseBuilder::literal(values[i]);
+	out << ");\n";
+}
+
+GLSLNoiseBuilder::GLSLNoiseBuilder() :
+	m_nextName(0)
+{
+}
+
+std::string GLSLNoiseBuilder::assign(const char* type, const std::string& expression)
+{
+	std::ostringstream name;
+	name << "m" << m_nextName++;
+
+	m_body << "\t" << type << " " << name.str() << " = " << expression << ";\n";
+	return name.str();
+}
+
+std::string GLSLNoiseBuilder::seed(int seedOffset) const
+{
+	std::ostringstream oss;
+	oss << "m_seed + " << seedOffset;
+	return oss.str();
+}
+
+std::string GLSLNoiseBuilder::literal(float value)
+{
+	std::ostringstream oss;
+	oss << std::setprecision(9) << value;
+
+	// Without a point or exponent GLSL would read an int
+	std::string result = oss.str();
+	if (result.find_first_of(".e") == std::string::npos)
+		result += ".0";
+	return result;
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::perlin(const Position& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves)
+{
+	std::ostringstream oss;
+	oss << "perlin(" << seed(seedOffset) << ", " << literal(freq) << ", " << literal(persistence) << ", "
+		<< literal(lacunarity) << ", " << octaves << ", " << pos << ", minWavelength)";
+	return assign("float", oss.str());
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::ridgedMulti(const Position& pos, int seedOffset, float freq, float lacunarity, int octaves)
+{
+	std::ostringstream oss;
+	oss << "ridgedMulti(" << seed(seedOffset) << ", " << literal(freq) << ", " << literal(lacunarity) << ", "
+		<< octaves << ", " << pos << ", minWavelength)";
+	return assign("float", oss.str());
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::ridgedMultiBest(const Position& pos, int seedOffset, float freq, float lacunarity, int octaves)
+{
+	std::ostringstream oss;
+	oss << "ridgedMultiBest(" << seed(seedOffset) << ", " << literal(freq) << ", " << literal(lacunarity) << ", "
+		<< octaves << ", " << pos << ", minWavelength)";
+	return assign("float", oss.str());
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::billow(const Position& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves)
+{
+	std::ostringstream oss;
+	oss << "billow(" << seed(seedOffset) << ", " << literal(freq) << ", " << literal(persistence) << ", "
+		<< literal(lacunarity) << ", " << octaves << ", " << pos << ", minWavelength)";
+	return assign("float", oss.str());
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::billowBest(const Position& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves)
+{
+	std::ostringstream oss;
+	oss << "billowBest(" << seed(seedOffset) << ", " << literal(freq) << ", " << literal(persistence) << ", "
+		<< literal(lacunarity) << ", " << octaves << ", " << pos << ", minWavelength)";
+	return assign("float", oss.str());
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::voronoi(const Position& pos, int seedOffset, float freq, float displacement)
+{
+	std::ostringstream oss;
+	oss << "voronoiWithDistance(" << seed(seedOffset) << ", " << literal(freq) << ", " << literal(displacement) << ", " << pos << ")";
+	return assign("float", oss.str());
+}
+
+GLSLNoiseBuilder::Position GLSLNoiseBuilder::turbulence(const Position& pos, int seedOffset, float freq, float power, int roughness)
+{
+	std::ostringstream oss;
+	oss << "turbulence(" << pos << ", " << seed(seedOffset) << ", " << literal(freq) << ", " << literal(power) << ", "
+		<< roughness << ", minWavelength)";
+	return assign("vec3", oss.str());
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::constant(float value)
+{
+	return assign("float", literal(value));
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::scaleBias(const Value& source, float scale, float bias)
+{
+	return assign("float", source + " * " + literal(scale) + " + " + literal(bias));
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::add(const Value& a, const Value& b)
+{
+	return assign("float", a + " + " + b);
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::multiply(const Value& a, const Value& b)
+{
+	return assign("float", a + " * " + b);
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::min(const Value& a, const Value& b)
+{
+	return assign("float", "min(" + a + ", " + b + ")");
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::max(const Value& a, const Value& b)
+{
+	return assign("float", "max(" + a + ", " + b + ")");
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::clamp(const Value& source, float lowerBound, float upperBound)
+{
+	return assign("float", "clamp(" + source + ", " + literal(lowerBound) + ", " + literal(upperBound) + ")");
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::exponent(const Value& source, float exponent)
+{
+	return assign("float", "expoFunc(" + source + ", " + literal(exponent) + ")");
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::blend(const Value& source0, const Value& source1, const Value& control)
+{
+	return assign("float", "mix(" + source0 + ", " + source1 + ", 0.5*" + control + " + 0.5)");
+}
+
+GLSLNoiseBuilder::Value GLSLNoiseBuilder::select(const Value& source0, const Value& source1, const Value& control, float falloff, float lowerBound, float upperBound)
+{
+	return assign(
+		"float",
+		"select(" + source0 + ", " + source1 + ", " + control + ", " +
+			literal(falloff) + ", " + literal(lowerBound) + ", " + literal(upperBound) + ")"
+	);
+}
+
+std::string GLSLNoiseBuilder::curve(const std::string& source, const float* in, const float* out, int numPoints)
+{
+	std::string& function = m_pointFunctions[in];
+	if (function.empty())
+	{
+		std::ostringstream name;
+		name << "curve" << m_pointFunctions.size();
+		function = name.str();
+
+		// curve() of libnoise with the points baked in
+		const int last = numPoints - 1;
+		m_functions << "float " << function << "(float source)\n{\n";
+		writeArray(m_functions, "inPoints", in, numPoints);
+		writeArray(m_functions, "outPoints", out, numPoints);
+		m_functions <<
+			"\n"
+			"\tint indexPos;\n"
+			"\tfor (indexPos = 0; indexPos < " << numPoints << "; ++indexPos)\n"
+			"\t{\n"
+			"\t\tif (source < inPoints[indexPos])\n"
+			"\t\t\tbreak;\n"
+			"\t}\n"
+			"\n"
+			"\tint index0 = clamp(indexPos - 2, 0, " << last << ");\n"
+			"\tint index1 = clamp(indexPos - 1, 0, " << last << ");\n"
+			"\tint index2 = clamp(indexPos    , 0, " << last << ");\n"
+			"\tint index3 = clamp(indexPos + 1, 0, " << last << ");\n"
+			"\n"
+			"\tif (index1 == index2)\n"
+			"\t\treturn outPoints[index1];\n"
+			"\n"
+			"\tfloat alpha = (source - inPoints[index1]) / (inPoints[index2] - inPoints[index1]);\n"
+			"\treturn cubicInterp(outPoints[index0], outPoints[index1], outPoints[index2], outPoints[index3], alpha);\n"
+			"}\n\n"
+		;
+	}
+	return assign("float", function + "(" + source + ")");
+}
+
+std::string GLSLNoiseBuilder::terrace(const std::string& source, const float* points, int numPoints)
+{
+	std::string& function = m_pointFunctions[points];
+	if (function.empty())
+	{
+		std::ostringstream name;
+		name << "terrace" << m_pointFunctions.size();
+		function = name.str();
+
+		// terrace() of libnoise with the points baked in
+		const int last = numPoints - 1;
+		m_functions << "float " << function << "(float value)\n{\n";
+		writeArray(m_functions, "points", points, numPoints);
+		m_functions <<
+			"\n"
+			"\tint indexPos;\n"
+			"\tfor (indexPos = 0; indexPos < " << numPoints << "; ++indexPos)\n"
+			"\t{\n"
+			"\t\tif (value < points[indexPos])\n"
+			"\t\t\tbreak;\n"
+			"\t}\n"
+			"\n"
+			"\tint index0 = clamp(indexPos - 1, 0, " << last << ");\n"
+			"\tint index1 = clamp(indexPos    , 0, " << last << ");\n"
+			"\n"
+			"\tif (index0 == index1)\n"
+			"\t\treturn points[index1];\n"
+			"\n"
+			"\tfloat value0 = points[index0];\n"
+			"\tfloat value1 = points[index1];\n"
+			"\tfloat alpha = (value - value0) / (value1 - value0);\n"
+			"\treturn mix(value0, value1, alpha * alpha);\n"
+			"}\n\n"
+		;
+	}
+	return assign("float", function + "(" + source + ")");
+}
+
+std::string GLSLNoiseBuilder::function(const std::string& name, const Value& result) const
+{
+	std::ostringstream oss;
+	oss <<
+		m_functions.str() <<
+		"float " << name << "(vec3 pos, int m_seed, float minWavelength)\n{\n" <<
+		m_body.str() <<
+		"\treturn " << result << ";\n}\n"
+	;
+	return oss.str();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <sstream>
+#include <string>
+
+// Terrain generators as graphs of noise modules.
+//
+// A graph is a function template over a builder type B, written once in
+// terms of the builder's modules (perlin, curve, select...) and returning
+// B::Value. Each builder gives the modules their meaning:
+//
+//  - the CPU kernels' builder (cpu_terrain_kernels.inl) evaluates them over
+//    SIMD_WIDTH samples, so the compiler inlines and specialises the whole
+//    graph, with every constant and curve size known at compile time;
+//  - GLSLNoiseBuilder below emits them as GLSL for the compute shaders.
+//
+// Curve and terrace points are passed as arrays of their exact size, which
+// the builders take as a template parameter.
+//
+// Builders provide:
+//	typedef ... Value;     // Scalar result of a module
+//	typedef ... Position;  // Sample position
+//	Value perlin(pos, seedOffset, freq, persistence, lacunarity, octaves);
+//	Value ridgedMulti(pos, seedOffset, freq, lacunarity, octaves);
+//	Value ridgedMultiBest(pos, seedOffset, freq, lacunarity, octaves);
+//	Value billow(pos, seedOffset, freq, persistence, lacunarity, octaves);
+//	Value billowBest(pos, seedOffset, freq, persistence, lacunarity, octaves);
+//	Value voronoi(pos, seedOffset, freq, displacement);
+//	Position turbulence(pos, seedOffset, freq, power, roughness);
+//	Value constant(value);
+//	Value scaleBias(source, scale, bias);      // source*scale + bias
+//	Value add(a, b), multiply(a, b), min(a, b), max(a, b);
+//	Value clamp(source, lowerBound, upperBound);
+//	Value exponent(source, exponent);          // libnoise Exponent
+//	Value blend(source0, source1, control);    // libnoise Blend
+//	Value select(source0, source1, control, falloff, lowerBound, upperBound);
+//	Value curve(source, const float (&in)[N], const float (&out)[N]);
+//	Value terrace(source, const float (&points)[N]);
+// Seeds are offsets from the planet's seed.
+
+// Writes a graph out as a GLSL function of (vec3 pos, int m_seed,
+// float minWavelength), calling the noise functions of lib_libnoise.glsl.
+// Every module becomes one local variable; curves and terraces become
+// functions of their own with the points as constant arrays.
+class GLSLNoiseBuilder
+{
+	std::ostringstream m_functions;
+	std::ostringstream m_body;
+	std::map<const float*, std::string> m_pointFunctions; // By points array
+	unsigned m_nextName;
+
+	std::string assign(const char* type, const std::string& expression);
+	std::string seed(int seedOffset) const;
+	std::string curve(const std::string& source, const float* in, const float* out, int numPoints);
+	std::string terrace(const std::string& source, const float* points, int numPoints);
+
+	public:
+
+	typedef std::string Value;
+	typedef std::string Position;
+
+	GLSLNoiseBuilder();
+
+	Position position() const { return "pos"; }
+
+	Value perlin(const Position& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves);
+	Value ridgedMulti(const Position& pos, int seedOffset, float freq, float lacunarity, int octaves);
+	Value ridgedMultiBest(const Position& pos, int seedOffset, float freq, float lacunarity, int octaves);
+	Value billow(const Position& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves);
+	Value billowBest(const Position& pos, int seedOffset, float freq, float persistence, float lacunarity, int octaves);
+	Value voronoi(const Position& pos, int seedOffset, float freq, float displacement);
+	Position turbulence(const Position& pos, int seedOffset, float freq, float power, int roughness);
+
+	Value constant(float value);
+	Value scaleBias(const Value& source, float scale, float bias);
+	Value add(const Value& a, const Value& b);
+	Value multiply(const Value& a, const Value& b);
+	Value min(const Value& a, const Value& b);
+	Value max(const Value& a, const Value& b);
+	Value clamp(const Value& source, float lowerBound, float upperBound);
+	Value exponent(const Value& source, float exponent);
+	Value blend(const Value& source0, const Value& source1, const Value& control);
+	Value select(const Value& source0, const Value& source1, const Value& control, float falloff, float lowerBound, float upperBound);
+
+	template <int N>
+	Value curve(const Value& source, const float (&in)[N], const float (&out)[N])
+	{
+		return curve(source, in, out, N);
+	}
+
+	template <int N>
+	Value terrace(const Value& source, const float (&points)[N])
+	{
+		return terrace(source, points, N);
+	}
+
+	// The GLSL for everything built so far, as a function returning result
+	std::string function(const std::string& name, const Value& result) const;
+
+	// A GLSL float literal that converts back to exactly value
+	static std::string literal(float value);
+};
@@ -0,0 +1,187 @@
+#include <smmintrin.h>
+#include <limits>
+
+#include "patch_culling.h"
+#include "planet_patch.h"
+
+// A 3-vector in each of four lanes
+struct Vec3x4
+{
+	__m128 x, y, z;
+
+	Vec3x4() {}
+	Vec3x4(__m128 x_, __m128 y_, __m128 z_) : x(x_), y(y_), z(z_) {}
+	explicit Vec3x4(const glm::vec3& v) : x(_mm_set1_ps(v.x)), y(_mm_set1_ps(v.y)), z(_mm_set1_ps(v.z)) {}
+
+	Vec3x4(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) :
+		x(_mm_setr_ps(a.x, b.x, c.x, d.x)),
+		y(_mm_setr_ps(a.y, b.y, c.y, d.y)),
+		z(_mm_setr_ps(a.z, b.z, c.z, d.z))
+	{}
+};
+
+static inline Vec3x4 operator+(const Vec3x4& a, const Vec3x4& b) { return Vec3x4(_mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z)); }
+static inline Vec3x4 operator-(const Vec3x4& a, const Vec3x4& b) { return Vec3x4(_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)); }
+static inline Vec3x4 operator*(const Vec3x4& a, __m128 s) { return Vec3x4(_mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s)); }
+
+// Summed in the order glm::dot does
+static inline __m128 dot(const Vec3x4& a, const Vec3x4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline float horizontalMin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+static inline float horizontalMax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+static inline __m128 absolute(__m128 v)
+{
+	return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+// sqrt(max(v, 0)), and 0 for NaN
+static inline __m128 sqrtClamped(__m128 v)
+{
+	return _mm_sqrt_ps(_mm_max_ps(v, _mm_setzero_ps()));
+}
+
+// The horizon test of four patches. Every point of a patch has a direction
+// within its corners' angle of its centre's, and a radius within its altitude
+// bounds, so lies in a sphere about the centre's direction holding both
+// extremes. That sphere is hidden when it lies within the cone the
+// occluder subtends at the camera and beyond the plane of its horizon; the
+// least occluder radius that hides it is
+//   max(D sin(phi + alpha), sqrt(D^2 - t + rD)),
+// D the camera's distance from the planet centre, phi the angle at the camera
+// between the centres, alpha the sphere's angular radius, and t the dot of
+// the directions to them.
+//
+// A camera moved by m sees points hidden from where it was by an occluder m
+// larger, and hidden from where it is now by one m smaller, so each answer
+// holds while the camera moves by less than the occluder radius's distance
+// from that least radius.
+static inline __m128 testHidden(
+	const PatchCullingView& view, const PlanetPatch* const patches[4],
+	const Vec3x4& center, const Vec3x4* const corners[4], __m128& slack
+)
+{
+	const __m128 minAltitude = _mm_setr_ps(patches[0]->m_minAltitude, patches[1]->m_minAltitude, patches[2]->m_minAltitude, patches[3]->m_minAltitude);
+	const __m128 maxAltitude = _mm_setr_ps(patches[0]->m_maxAltitude, patches[1]->m_maxAltitude, patches[2]->m_maxAltitude, patches[3]->m_maxAltitude);
+
+	__m128 cosAngle = dot(center, *corners[0]);
+	for (int i = 1; i < 4; ++i)
+		cosAngle = _mm_min_ps(cosAngle, dot(center, *corners[i]));
+
+	// Squared distance from centre*k to a point at the extreme angle and radius a is a^2 - 2ak*cosAngle + k^2
+	const __m128 k = _mm_mul_ps(_mm_mul_ps(cosAngle, _mm_add_ps(minAltitude, maxAltitude)), _mm_set1_ps(0.5f));
+	const __m128 k2 = _mm_mul_ps(k, k);
+	const __m128 twoKCos = _mm_mul_ps(_mm_add_ps(k, k), cosAngle);
+	const __m128 minRadius2 = _mm_add_ps(_mm_mul_ps(minAltitude, _mm_sub_ps(minAltitude, twoKCos)), k2);
+	const __m128 maxRadius2 = _mm_add_ps(_mm_mul_ps(maxAltitude, _mm_sub_ps(maxAltitude, twoKCos)), k2);
+	const __m128 radius = sqrtClamped(_mm_max_ps(minRadius2, maxRadius2));
+
+	const Vec3x4 toPatch = center * k - Vec3x4(view.m_cameraPos_MS);
+	const __m128 patchDist = _mm_sqrt_ps(dot(toPatch, toPatch));
+	const __m128 t = _mm_sub_ps(_mm_setzero_ps(), dot(Vec3x4(view.m_cameraPos_MS), toPatch));
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 cameraDist = _mm_set1_ps(view.m_cameraDist);
+	const __m128 occluderRadius = _mm_set1_ps(view.m_occluderRadius);
+
+	const __m128 cosPhi = _mm_div_ps(t, _mm_mul_ps(cameraDist, patchDist));
+	const __m128 sinPhi = sqrtClamped(_mm_sub_ps(one, _mm_mul_ps(cosPhi, cosPhi)));
+	const __m128 sinAlpha = _mm_div_ps(radius, patchDist);
+	const __m128 cosAlpha = sqrtClamped(_mm_sub_ps(one, _mm_mul_ps(sinAlpha, sinAlpha)));
+	const __m128 sinSum = _mm_add_ps(_mm_mul_ps(sinPhi, cosAlpha), _mm_mul_ps(cosPhi, sinAlpha));
+	const __m128 cosSum = _mm_sub_ps(_mm_mul_ps(cosPhi, cosAlpha), _mm_mul_ps(sinPhi, sinAlpha));
+
+	// No cone short of a half space holds a sphere at or beyond a right angle, or around the camera
+	const __m128 inCone = _mm_and_ps(_mm_cmpgt_ps(cosSum, _mm_setzero_ps()), _mm_cmpgt_ps(patchDist, radius));
+	const __m128 coneRadius = _mm_blendv_ps(cameraDist, _mm_mul_ps(cameraDist, sinSum), inCone);
+	const __m128 planeRadius = sqrtClamped(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(cameraDist, cameraDist), t), _mm_mul_ps(radius, cameraDist)));
+	const __m128 rounding = _mm_mul_ps(_mm_set1_ps(1e-5f), cameraDist); // Allowed for in the answer and its slack
+	const __m128 leastRadius = _mm_add_ps(_mm_min_ps(cameraDist, _mm_max_ps(coneRadius, planeRadius)), rounding);
+
+	// Nothing is hidden from inside the occluder, so the camera crossing it can change any answer
+	const __m128 outside = _mm_cmpgt_ps(cameraDist, occluderRadius);
+	const __m128 crossingSlack = absolute(_mm_sub_ps(cameraDist, occluderRadius));
+	slack = _mm_min_ps(crossingSlack, _mm_blendv_ps(crossingSlack, absolute(_mm_sub_ps(occluderRadius, leastRadius)), outside));
+	slack = _mm_sub_ps(slack, rounding);
+	return _mm_and_ps(outside, _mm_cmpgt_ps(occluderRadius, leastRadius));
+}
+
+static ChildVisibility testVisible(const PatchCullingView& view, const PlanetPatch* const patches[4])
+{
+	const PatchBoundingVectors& b0 = patches[0]->m_boundingVectors;
+	const PatchBoundingVectors& b1 = patches[1]->m_boundingVectors;
+	const PatchBoundingVectors& b2 = patches[2]->m_boundingVectors;
+	const PatchBoundingVectors& b3 = patches[3]->m_boundingVectors;
+
+	const Vec3x4 center(b0.m_center, b1.m_center, b2.m_center, b3.m_center);
+	const Vec3x4 corner00(b0.m_corner00, b1.m_corner00, b2.m_corner00, b3.m_corner00);
+	const Vec3x4 corner01(b0.m_corner01, b1.m_corner01, b2.m_corner01, b3.m_corner01);
+	const Vec3x4 corner10(b0.m_corner10, b1.m_corner10, b2.m_corner10, b3.m_corner10);
+	const Vec3x4 corner11(b0.m_corner11, b1.m_corner11, b2.m_corner11, b3.m_corner11);
+	const __m128 radius = _mm_setr_ps(b0.m_radius, b1.m_radius, b2.m_radius, b3.m_radius);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 huge = _mm_set1_ps(std::numeric_limits<float>::max());
+
+	const Vec3x4* const corners[4] = { &corner00, &corner01, &corner10, &corner11 };
+	__m128 hiddenSlack;
+	const __m128 hidden = testHidden(view, patches, center, corners, hiddenSlack);
+
+	// Outside the frustum if beyond any plane. That holds while any such
+	// plane stays so; inside while every plane's slack does.
+	__m128 outside = zero;
+	__m128 insideSlack = huge;
+	__m128 outsideSlack = zero;
+	for (int i = 0; i < 6; ++i)
+	{
+		const glm::vec4& plane = view.m_frustumPlanes[i];
+		const __m128 planeValue = _mm_add_ps(dot(center, Vec3x4(glm::vec3(plane))), _mm_set1_ps(plane.w));
+		const __m128 margin = _mm_add_ps(planeValue, radius);
+		const __m128 planeOutside = _mm_cmple_ps(planeValue, _mm_sub_ps(zero, radius));
+
+		outside = _mm_or_ps(outside, planeOutside);
+		insideSlack = _mm_min_ps(insideSlack, margin);
+		outsideSlack = _mm_max_ps(outsideSlack, _mm_and_ps(planeOutside, _mm_sub_ps(zero, margin)));
+	}
+
+	const __m128 visible = _mm_andnot_ps(_mm_or_ps(hidden, outside), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+	// Each patch's slack is that of whichever test decided it
+	const __m128 moveSlack = _mm_blendv_ps(hiddenSlack, huge, _mm_andnot_ps(hidden, outside));
+
+	__m128 frustumSlack = _mm_blendv_ps(insideSlack, outsideSlack, outside);
+	frustumSlack = _mm_blendv_ps(frustumSlack, huge, hidden);
+
+	ChildVisibility result;
+	result.m_visibleMask = _mm_movemask_ps(visible);
+	result.m_moveSlack = horizontalMin(moveSlack);
+	result.m_frustumSlack = horizontalMin(frustumSlack);
+	result.m_maxCenterLength = horizontalMax(_mm_sqrt_ps(dot(center, center)));
+	return result;
+}
+
+ChildVisibility testChildrenVisible(const PatchCullingView& view, const PlanetPatch* children)
+{
+	const PlanetPatch* const patches[4] = { children + 0, children + 1, children + 2, children + 3 };
+	return testVisible(view, patches);
+}
+
+bool testPatchVisible(const PatchCullingView& view, const PlanetPatch* patch)
+{
+	const PlanetPatch* const patches[4] = { patch, patch, patch, patch };
+	return (testVisible(view, patches).m_visibleMask & 1) != 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "patchhash.h"
+
+struct PlanetPatch;
+
+// Visibility tests for the four children of a patch at once, one child per
+// SSE lane. Used by Planet::traversePatches.
+
+// What every visibility test of a frame shares, in planet model space
+struct PatchCullingView
+{
+	glm::vec3 m_cameraPos_MS;
+	float m_cameraDist;
+	glm::vec4 m_frustumPlanes[6]; // As Frustum's, in the order Frustum::sphereOutside tests them
+	float m_occluderRadius;       // As Planet's
+};
+
+struct ChildVisibility
+{
+	int m_visibleMask; // Bit i for child i
+
+	// As PatchTraversal's, over the four tests
+	float m_moveSlack;
+	float m_frustumSlack;
+	float m_maxCenterLength;
+};
+
+// Whether each child might be seen from the camera: not hidden behind the
+// occluder sphere given its altitude bounds, and not outside the frustum.
+// Also how far the camera and frustum can move before any answer could change.
+ChildVisibility testChildrenVisible(const PatchCullingView& view, const PlanetPatch* children);
+
+// The same test of a single patch, for those with no parent to test them
+bool testPatchVisible(const PatchCullingView& view, const PlanetPatch* patch);
@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <limits>
+
+#include "patch_generation_queue.h"
+#include "planet_patch.h"
+
+PatchGenerationQueue::PatchGenerationQueue() :
+	m_stamp(1), m_budgetLeft(std::numeric_limits<unsigned>::max()), m_numHoles(0), m_holesOnly(false)
+{
+}
+
+void PatchGenerationQueue::clear()
+{
+	m_heap.clear();
+	m_numHoles = 0;
+	++m_stamp;
+}
+
+void PatchGenerationQueue::push(PlanetPatch* patch, const PatchPriority& priority)
+{
+	if (patch->m_queueStamp == m_stamp)
+		return;
+	patch->m_queueStamp = m_stamp;
+
+	if (patch->m_generating)
+		return;
+
+	const Entry entry = { priority, patch };
+	m_heap.push_back(entry);
+	if (priority.m_hole)
+		++m_numHoles;
+	std::push_heap(m_heap.begin(), m_heap.end());
+}
+
+bool PatchGenerationQueue::contains(const PlanetPatch* patch) const
+{
+	return patch->m_queueStamp == m_stamp;
+}
+
+PlanetPatch* PatchGenerationQueue::pop()
+{
+	if (available() == 0)
+		return nullptr;
+
+	std::pop_heap(m_heap.begin(), m_heap.end());
+	PlanetPatch* const patch = m_heap.back().m_patch;
+	if (m_heap.back().m_priority.m_hole)
+		--m_numHoles;
+	m_heap.pop_back();
+	--m_budgetLeft;
+	return patch;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+struct PlanetPatch;
+
+// What decides which queued patch is generated first
+struct PatchPriority
+{
+	bool m_hole;        // Nothing is drawn in the patch's place until it is generated
+	float m_pixelError; // Its geometric error as projected from the camera
+	float m_distance;   // From the camera to its bounding sphere; breaks ties
+
+	// Whether this should wait until other is generated
+	inline bool operator<(const PatchPriority& other) const
+	{
+		if (m_hole != other.m_hole)
+			return other.m_hole;
+		if (m_pixelError != other.m_pixelError)
+			return m_pixelError < other.m_pixelError;
+		return m_distance > other.m_distance;
+	}
+};
+
+// Patches waiting to be generated, best first. Refilled by every frame's
+// quadtree walk, so a patch that is no longer wanted is simply not queued
+// again, and contains() tells the generators to drop any work on it.
+// Render thread only.
+class PatchGenerationQueue
+{
+	struct Entry
+	{
+		PatchPriority m_priority;
+		PlanetPatch* m_patch;
+
+		inline bool operator<(const Entry& other) const { return m_priority < other.m_priority; }
+	};
+
+	std::vector<Entry> m_heap;
+	unsigned m_stamp;      // Given to PlanetPatch::m_queueStamp by push() since the last clear()
+	unsigned m_budgetLeft; // Patches pop() may still return
+	unsigned m_numHoles;   // Entries with m_priority.m_hole, which sort first
+	bool m_holesOnly;
+
+	public:
+
+	PatchGenerationQueue();
+
+	// Empties the queue for the next frame's walk; the budget is untouched
+	void clear();
+
+	// How many patches pop() may return from now on
+	inline void setBudget(unsigned maxPatches) { m_budgetLeft = maxPatches; }
+
+	// Back-pressure: while set, pop() only returns holes
+	inline void setHolesOnly(bool holesOnly) { m_holesOnly = holesOnly; }
+
+	// Once per patch between clears. A patch already being generated is only
+	// noted as still wanted.
+	void push(PlanetPatch* patch, const PatchPriority& priority);
+
+	// Whether the patch has been pushed since the last clear()
+	bool contains(const PlanetPatch* patch) const;
+
+	// The best patch, counted against the budget; nullptr if none may be returned
+	PlanetPatch* pop();
+
+	inline bool empty() const { return m_heap.empty(); }
+	inline unsigned size() const { return (unsigned)m_heap.size(); }
+
+	// How many patches pop() would return
+	inline unsigned available() const
+	{
+		const unsigned numEligible = m_holesOnly ? m_numHoles : size();
+		return m_budgetLeft < numEligible ? m_budgetLeft : numEligible;
+	}
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Murmur3's 64-bit finaliser. PatchHash values differ mostly in their low
+// dim bits; this spreads them over the whole word.
+inline uint64_t mixPatchHash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccd;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53;
+	key ^= key >> 33;
+	return key;
+}
+
+// Open-addressing map keyed by PatchHash::m_value, so that a lookup reads a
+// slot or two of one array rather than chasing list nodes.
+//
+// Robin-hood probing: an insert takes the slot of any key nearer its home
+// slot than the new one is, so every run stays sorted by distance from home
+// and a miss stops at the first key nearer home than it would be. Erasing
+// shifts the rest of the run back a slot instead of leaving a tombstone.
+//
+// The map grows to stay at most 7/8 full, or when a run gets too long for
+// its distance bytes. clear() keeps the capacity, so a map refilled every
+// frame does not reallocate. Any insert or erase invalidates iterators and
+// references.
+template <typename T>
+class PatchHashMap
+{
+	public:
+
+	typedef std::pair<uint64_t, T> value_type;
+
+	private:
+
+	template <typename Map, typename Value>
+	class Iterator
+	{
+		Map* m_map;
+		size_t m_index;
+
+		inline void skipEmpty()
+		{
+			while (m_index < m_map->m_distances.size() && !m_map->m_distances[m_index])
+				++m_index;
+		}
+
+		public:
+
+		Iterator(Map* map, size_t index) : m_map(map), m_index(index) { skipEmpty(); }
+
+		inline Value& operator*() const { return m_map->m_slots[m_index]; }
+		inline Value* operator->() const { return &m_map->m_slots[m_index]; }
+		inline Iterator& operator++() { ++m_index; skipEmpty(); return *this; }
+		inline bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+		inline bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+
+		friend class PatchHashMap;
+	};
+
+	std::vector<value_type> m_slots;
+	std::vector<uint8_t> m_distances; // Per slot: 0 if empty, else 1 + its distance from its home slot
+	size_t m_size;
+
+	static const uint8_t MAX_DISTANCE = 255;
+
+	inline size_t getMask() const { return m_slots.size() - 1; }
+	inline size_t getHome(uint64_t key) const { return (size_t)mixPatchHash(key) & getMask(); }
+
+	// The key's slot, or m_slots.size() if absent
+	size_t findIndex(uint64_t key) const
+	{
+		if (m_size == 0)
+			return m_slots.size();
+
+		size_t index = getHome(key);
+		for (unsigned distance = 1; distance <= m_distances[index]; ++distance)
+		{
+			if (distance == m_distances[index] && m_slots[index].first == key)
+				return index;
+			index = (index + 1) & getMask();
+		}
+		return m_slots.size();
+	}
+
+	// At least 16 slots, and a power of two, as getHome() masks
+	void rehash(size_t numSlots)
+	{
+		std::vector<value_type> oldSlots(numSlots);
+		std::vector<uint8_t> oldDistances(numSlots, 0);
+		oldSlots.swap(m_slots);
+		oldDistances.swap(m_distances);
+		m_size = 0;
+
+		for (size_t i = 0; i < oldSlots.size(); ++i)
+			if (oldDistances[i])
+				emplace(oldSlots[i].first, std::move(oldSlots[i].second));
+	}
+
+	inline void grow()
+	{
+		rehash(std::max<size_t>(m_slots.size() * 2, 16));
+	}
+
+	public:
+
+	typedef Iterator<PatchHashMap, value_type> iterator;
+	typedef Iterator<const PatchHashMap, const value_type> const_iterator;
+
+	PatchHashMap() : m_size(0) {}
+
+	inline iterator begin() { return iterator(this, 0); }
+	inline iterator end() { return iterator(this, m_slots.size()); }
+	inline const_iterator begin() const { return const_iterator(this, 0); }
+	inline const_iterator end() const { return const_iterator(this, m_slots.size()); }
+
+	inline size_t size() const { return m_size; }
+	inline bool empty() const { return m_size == 0; }
+
+	inline iterator find(uint64_t key) { return iterator(this, findIndex(key)); }
+	inline const_iterator find(uint64_t key) const { return const_iterator(this, findIndex(key)); }
+
+	// Room for numKeys without growing
+	void reserve(size_t numKeys)
+	{
+		size_t numSlots = std::max<size_t>(m_slots.size(), 16);
+		while (numSlots * 7 < numKeys * 8)
+			numSlots *= 2;
+		if (numSlots != m_slots.size())
+			rehash(numSlots);
+	}
+
+	// Keeps the capacity
+	void clear()
+	{
+		std::fill(m_distances.begin(), m_distances.end(), (uint8_t)0);
+		m_size = 0;
+	}
+
+	// As std::unordered_map's: the key's entry, and whether it was new
+	std::pair<iterator, bool> emplace(uint64_t key, T value)
+	{
+		if ((m_size + 1) * 8 > m_slots.size() * 7)
+			grow();
+
+		while (true)
+		{
+			// Walk the run to where the key is, or where it belongs
+			size_t index = getHome(key);
+			unsigned distance = 1;
+			for ( ; distance <= m_distances[index]; ++distance)
+			{
+				if (distance == m_distances[index] && m_slots[index].first == key)
+					return std::make_pair(iterator(this, index), false);
+				index = (index + 1) & getMask();
+			}
+
+			// The keys from there to the next empty slot each move one further
+			// from home; grow instead if any would go past MAX_DISTANCE
+			bool overflows = distance > MAX_DISTANCE;
+			size_t empty = index;
+			for ( ; m_distances[empty]; empty = (empty + 1) & getMask())
+				overflows |= m_distances[empty] == MAX_DISTANCE;
+			if (overflows)
+			{
+				grow();
+				continue;
+			}
+
+			for (size_t to = empty; to != index; )
+			{
+				const size_t from = (to - 1) & getMask();
+				m_slots[to] = std::move(m_slots[from]);
+				m_distances[to] = m_distances[from] + 1;
+				to = from;
+			}
+
+			m_slots[index].first = key;
+			m_slots[index].second = std::move(value);
+			m_distances[index] = (uint8_t)distance;
+			++m_size;
+			return std::make_pair(iterator(this, index), true);
+		}
+	}
+
+	// Returns the number erased, 0 or 1
+	size_t erase(uint64_t key)
+	{
+		size_t index = findIndex(key);
+		if (index == m_slots.size())
+			return 0;
+
+		// Pull the rest of the run back towards home, until a key already there
+		for (size_t next = (index + 1) & getMask(); m_distances[next] > 1; next = (next + 1) & getMask())
+		{
+			m_slots[index] = std::move(m_slots[next]);
+			m_distances[index] = m_distances[next] - 1;
+			index = next;
+		}
+
+		m_slots[index].second = T();
+		m_distances[index] = 0;
+		--m_size;
+		return 1;
+	}
+};
@@ -0,0 +1,45 @@
+#include "patch_pool.h"
+
+PatchPool::PatchPool(unsigned blocksPerSlab) :
+	m_blocksPerSlab(blocksPerSlab), m_freeList(nullptr), m_blocksInUse(0)
+{
+}
+
+PatchPool::~PatchPool()
+{
+	for (auto slab : m_slabs)
+		delete[] slab;
+}
+
+PlanetPatch* PatchPool::allocate()
+{
+	m_lock.acquire();
+
+	if (!m_freeList)
+	{
+		Block* const slab = new Block[m_blocksPerSlab];
+		m_slabs.push_back(slab);
+
+		for (unsigned i = 0; i < m_blocksPerSlab; ++i)
+			slab[i].m_next = (i + 1 < m_blocksPerSlab) ? slab + i + 1 : nullptr;
+		m_freeList = slab;
+	}
+
+	Block* const block = m_freeList;
+	m_freeList = block->m_next;
+	++m_blocksInUse;
+
+	m_lock.release();
+	return reinterpret_cast<PlanetPatch*>(block->m_patches);
+}
+
+void PatchPool::free(PlanetPatch* patches)
+{
+	Block* const block = reinterpret_cast<Block*>(patches);
+
+	m_lock.acquire();
+	block->m_next = m_freeList;
+	m_freeList = block;
+	--m_blocksInUse;
+	m_lock.release();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "planet_patch.h"
+#include "utils.h"
+
+// Blocks of four PlanetPatch, for the children Planet::makeChildren makes,
+// carved out of large slabs. Freed blocks are kept on a free list for the
+// next children, so node memory stays at the most ever in use at once
+// rather than growing for as long as the camera keeps moving. Thread safe,
+// as walk tasks make children concurrently.
+class PatchPool
+{
+	union Block
+	{
+		Block* m_next; // While free
+		char m_patches[4 * sizeof(PlanetPatch)];
+	};
+
+	const unsigned m_blocksPerSlab;
+	std::vector<Block*> m_slabs;
+	Block* m_freeList;
+	unsigned m_blocksInUse;
+	SpinLock m_lock;
+
+	public:
+
+	PatchPool(unsigned blocksPerSlab);
+	~PatchPool(); // Frees the slabs; the patches in them must be done with
+
+	// Room for four patches, to be constructed in place
+	PlanetPatch* allocate();
+
+	// Takes back allocate()'s block, once its patches are destroyed
+	void free(PlanetPatch* patches);
+
+	// Approximate while other threads allocate
+	inline unsigned getBlocksInUse() const { return m_blocksInUse; }
+	inline unsigned getCapacityBlocks() const { return (unsigned)m_slabs.size() * m_blocksPerSlab; }
+	inline size_t getSizeBytes() const { return m_slabs.size() * m_blocksPerSlab * sizeof(Block); }
+};
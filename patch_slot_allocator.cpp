@@ -0,0 +1,55 @@
+#include <cassert>
+
+#include "patch_slot_allocator.h"
+
+PatchSlotAllocator::PatchSlotAllocator(unsigned numSlots) :
+	m_numSlots(numSlots),
+	m_next(new std::atomic<uint32_t>[numSlots])
+{
+	assert(numSlots < EMPTY);
+
+	for (unsigned slot = 0; slot < numSlots; ++slot)
+		m_next[slot].store(slot + 1 < numSlots ? slot + 1 : EMPTY, std::memory_order_relaxed);
+
+	m_head.store(numSlots > 0 ? 0 : EMPTY, std::memory_order_relaxed);
+	m_numFree.store(numSlots, std::memory_order_release);
+}
+
+PatchSlotAllocator::~PatchSlotAllocator()
+{
+	delete[] m_next;
+}
+
+int PatchSlotAllocator::allocate()
+{
+	uint64_t head = m_head.load(std::memory_order_acquire);
+	while (true)
+	{
+		const uint32_t top = (uint32_t)head;
+		if (top == EMPTY)
+			return -1;
+
+		// Stale if top has been taken meanwhile, but then so is head, and the exchange fails
+		const uint32_t next = m_next[top].load(std::memory_order_relaxed);
+		if (m_head.compare_exchange_weak(head, makeHead(head, next), std::memory_order_acquire, std::memory_order_acquire))
+			break;
+	}
+
+	// Only after the pop, and free() counts before its push, so the count never falls short
+	m_numFree.fetch_sub(1, std::memory_order_relaxed);
+	return (int)(uint32_t)head;
+}
+
+void PatchSlotAllocator::free(int slot)
+{
+	assert(slot >= 0 && (unsigned)slot < m_numSlots);
+
+	m_numFree.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	do
+	{
+		m_next[slot].store((uint32_t)head, std::memory_order_relaxed);
+	}
+	while (!m_head.compare_exchange_weak(head, makeHead(head, (uint32_t)slot), std::memory_order_release, std::memory_order_relaxed));
+}
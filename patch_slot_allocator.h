@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// The free slots of PlanetDataBuffer, as a lock-free (Treiber) stack of
+// slot indices. Each free slot holds the index of the one below it, and the
+// head packs the top slot with a count of changes, so that a pop which read
+// a top since popped and pushed back by another thread fails its
+// compare-exchange rather than installing a stale next (the ABA problem).
+// Safe to call from any number of threads at once.
+class PatchSlotAllocator
+{
+	static const uint32_t EMPTY = 0xffffffff;
+
+	const unsigned m_numSlots;
+	std::atomic<uint32_t>* const m_next; // By slot, while free: the slot below it, or EMPTY
+	std::atomic<uint64_t> m_head;        // Top slot in the low 32 bits, change count in the high 32
+	std::atomic<unsigned> m_numFree;
+
+	static inline uint64_t makeHead(uint64_t oldHead, uint32_t top)
+	{
+		return (((oldHead >> 32) + 1) << 32) | top;
+	}
+
+	public:
+
+	PatchSlotAllocator(unsigned numSlots); // All free; allocated lowest first
+	~PatchSlotAllocator();
+
+	// A free slot, or -1 if there are none
+	int allocate();
+
+	// Takes back allocate()'s slot
+	void free(int slot);
+
+	// Never fewer than are free, but while other threads allocate,
+	// allocate() may still find none
+	inline unsigned numFree() const { return m_numFree.load(std::memory_order_relaxed); }
+	inline unsigned numSlots() const { return m_numSlots; }
+};
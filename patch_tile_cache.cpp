@@ -0,0 +1,262 @@
+#define NOMINMAX
+#include <windows.h>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include "patch_tile_cache.h"
+#include "planet_data_buffer.h"
+
+static const char TILE_CACHE_MAGIC[8] = { 'G', 'E', 'N', 'T', 'I', 'L', 'E', 'S' };
+static const uint32_t TILE_CACHE_VERSION = 3; // 2: RidgedMF analytic normals; 3: vertex size
+
+// Beyond this many unwritten tiles, further ones are dropped
+static const size_t MAX_PENDING_TILES = 256;
+
+struct PatchTileCache::Header
+{
+	char m_magic[8];
+	uint32_t m_version;
+	uint32_t m_totalVertices;
+	uint64_t m_fingerprint;
+	uint32_t m_maxTiles;
+	uint32_t m_indexSize;
+	uint32_t m_numTiles; // Tiles written, including any not yet in the index
+	uint32_t m_vertexSizeBytes;
+};
+
+static inline size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline uint64_t mixHash(uint64_t key) // As PlanetPatchHashFunc
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccd;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53;
+	key ^= key >> 33;
+	return key;
+}
+
+PatchTileCache::PatchTileCache(const std::string& directory, unsigned maxTiles) :
+	m_directory(directory),
+	m_maxTiles(maxTiles),
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr),
+	m_view(nullptr),
+	m_header(nullptr),
+	m_index(nullptr),
+	m_indexMask(0),
+	m_tiles(nullptr),
+	m_tileSizeBytes(0),
+	m_stopping(false)
+{
+	if (maxTiles == 0)
+		throw std::exception("Tile cache needs space for at least one tile");
+}
+
+PatchTileCache::~PatchTileCache()
+{
+	if (m_writer.joinable())
+	{
+		// Finish writing everything queued before unmapping
+		{
+			std::lock_guard<std::mutex> lock(m_pendingMutex);
+			m_stopping = true;
+		}
+		m_pendingCondition.notify_one();
+		m_writer.join();
+	}
+
+	for (auto tile : m_freeTiles)
+		delete tile;
+
+	if (m_view)
+		UnmapViewOfFile(m_view);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+}
+
+void PatchTileCache::open(const std::string& planetName, uint64_t fingerprint)
+{
+	// Twice as many index entries as tiles keeps probe sequences short
+	uint32_t indexSize = 1;
+	while (indexSize < 2 * m_maxTiles)
+		indexSize <<= 1;
+	m_indexMask = indexSize - 1;
+
+	m_tileSizeBytes = alignUp(sizeof(PatchStats), 16) + PLANET_PATCH_CONSTANTS->m_totalSizeBytes;
+	const size_t indexOffset = alignUp(sizeof(Header), 64);
+	const size_t tilesOffset = alignUp(indexOffset + indexSize * sizeof(IndexEntry), 64);
+	const uint64_t fileSize = tilesOffset + (uint64_t)m_maxTiles * m_tileSizeBytes;
+
+	if (fileSize > std::numeric_limits<size_t>::max())
+		throw std::exception("Tile cache is too large to map in a 32-bit build");
+
+	std::ostringstream path;
+	path << m_directory << "\\" << planetName << "_" << std::hex << fingerprint << ".tiles";
+
+	CreateDirectoryA(m_directory.c_str(), nullptr); // Fails harmlessly if it exists
+
+	m_file = CreateFileA(
+		path.str().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+		nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::exception("Could not open tile cache file");
+
+	LARGE_INTEGER existingSize;
+	if (!GetFileSizeEx(m_file, &existingSize))
+		existingSize.QuadPart = 0;
+
+	// Grows the file to fileSize if it is smaller
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, (DWORD)(fileSize >> 32), (DWORD)fileSize, nullptr);
+	if (!m_mapping)
+		throw std::exception("Could not create tile cache mapping");
+
+	m_view = (char*)MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)fileSize);
+	if (!m_view)
+		throw std::exception("Could not map tile cache file");
+
+	m_header = reinterpret_cast<Header*>(m_view);
+	m_index = reinterpret_cast<IndexEntry*>(m_view + indexOffset);
+	m_tiles = m_view + tilesOffset;
+
+	const bool valid =
+		(uint64_t)existingSize.QuadPart == fileSize &&
+		memcmp(m_header->m_magic, TILE_CACHE_MAGIC, sizeof(TILE_CACHE_MAGIC)) == 0 &&
+		m_header->m_version == TILE_CACHE_VERSION &&
+		m_header->m_totalVertices == PLANET_PATCH_CONSTANTS->m_totalVertices &&
+		m_header->m_vertexSizeBytes == PLANET_PATCH_CONSTANTS->m_vertexSizeBytes &&
+		m_header->m_fingerprint == fingerprint &&
+		m_header->m_maxTiles == m_maxTiles &&
+		m_header->m_indexSize == indexSize &&
+		m_header->m_numTiles <= m_maxTiles
+	;
+
+	if (!valid)
+	{
+		memset(m_index, 0, indexSize * sizeof(IndexEntry));
+
+		memcpy(m_header->m_magic, TILE_CACHE_MAGIC, sizeof(TILE_CACHE_MAGIC));
+		m_header->m_version = TILE_CACHE_VERSION;
+		m_header->m_totalVertices = PLANET_PATCH_CONSTANTS->m_totalVertices;
+		m_header->m_vertexSizeBytes = PLANET_PATCH_CONSTANTS->m_vertexSizeBytes;
+		m_header->m_fingerprint = fingerprint;
+		m_header->m_maxTiles = m_maxTiles;
+		m_header->m_indexSize = indexSize;
+		m_header->m_numTiles = 0;
+	}
+
+	m_writer = std::thread(&PatchTileCache::runWriter, this);
+}
+
+PatchTileCache::IndexEntry* PatchTileCache::findEntry(uint64_t hash) const
+{
+	// Linear probing; the index is never more than half full
+	uint32_t i = (uint32_t)mixHash(hash) & m_indexMask;
+	while (m_index[i].m_tile && m_index[i].m_hash != hash)
+		i = (i + 1) & m_indexMask;
+	return m_index + i;
+}
+
+bool PatchTileCache::find(const PatchHash& hash, PatchStats& stats, const void*& vertices)
+{
+	uint32_t tile;
+	{
+		std::lock_guard<std::mutex> lock(m_indexMutex);
+		tile = findEntry(hash.m_value)->m_tile;
+	}
+	if (!tile)
+		return false;
+
+	const char* const tileData = m_tiles + (tile - 1) * m_tileSizeBytes;
+	memcpy(&stats, tileData, sizeof(PatchStats));
+	vertices = tileData + alignUp(sizeof(PatchStats), 16);
+	return true;
+}
+
+void PatchTileCache::store(const PatchHash& hash, const PatchStats& stats, const void* vertices)
+{
+	PendingTile* tile;
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		if (m_pendingTiles.size() >= MAX_PENDING_TILES)
+			return;
+
+		if (m_freeTiles.empty())
+		{
+			tile = new PendingTile();
+		}
+		else
+		{
+			tile = m_freeTiles.back();
+			m_freeTiles.pop_back();
+		}
+	}
+
+	tile->m_hash = hash.m_value;
+	tile->m_stats = stats;
+	const char* const vertexBytes = static_cast<const char*>(vertices);
+	tile->m_vertices.assign(vertexBytes, vertexBytes + PLANET_PATCH_CONSTANTS->m_totalSizeBytes);
+
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		m_pendingTiles.push_back(tile);
+	}
+	m_pendingCondition.notify_one();
+}
+
+void PatchTileCache::writeTile(const PendingTile& tile)
+{
+	// Only this thread adds entries, so reading the index needs no lock
+	if (findEntry(tile.m_hash)->m_tile || m_header->m_numTiles == m_maxTiles)
+		return; // Already stored, or no room left
+
+	const uint32_t tileNumber = ++m_header->m_numTiles;
+
+	char* const tileData = m_tiles + (tileNumber - 1) * m_tileSizeBytes;
+	memcpy(tileData, &tile.m_stats, sizeof(PatchStats));
+	memcpy(tileData + alignUp(sizeof(PatchStats), 16), &tile.m_vertices[0], PLANET_PATCH_CONSTANTS->m_totalSizeBytes);
+
+	// Publish only once the tile is complete
+	std::lock_guard<std::mutex> lock(m_indexMutex);
+	IndexEntry* const entry = findEntry(tile.m_hash);
+	entry->m_hash = tile.m_hash;
+	entry->m_tile = tileNumber;
+}
+
+void PatchTileCache::runWriter()
+{
+	std::unique_lock<std::mutex> lock(m_pendingMutex);
+
+	while (true)
+	{
+		m_pendingCondition.wait(lock, [this]() { return m_stopping || !m_pendingTiles.empty(); });
+		if (m_pendingTiles.empty())
+			return; // Stopping, with nothing left to write
+
+		PendingTile* const tile = m_pendingTiles.front();
+		m_pendingTiles.pop_front();
+
+		lock.unlock();
+		writeTile(*tile);
+		lock.lock();
+
+		m_freeTiles.push_back(tile);
+	}
+}
+
+PatchTileCache* PatchTileCache::buildFromXMLNode(XMLNode& node)
+{
+	XMLChildFinder finder(node);
+
+	return new PatchTileCache(
+		finder.required("Directory", buildStringFromXMLNode),
+		(unsigned)finder.required("MaxTiles", buildIntFromXMLNode)
+	);
+}
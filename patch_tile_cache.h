@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu_terrain.h"
+#include "patchhash.h"
+#include "xml.h"
+
+// Persistent store of generated patches, so that revisited terrain and later
+// runs read patches from disk rather than generating them again.
+//
+// Each planet and generator fingerprint gets its own memory-mapped file: a
+// header, an open-addressed index from PatchHash::m_value to tile number,
+// then fixed-size tiles of PatchStats followed by the patch's vertices, in
+// the layout PLANET_PATCH_CONSTANTS says.
+// Tiles are written by a background thread and never change once in the
+// index. When the file is full, new tiles are simply not stored.
+class PatchTileCache
+{
+	struct Header;
+
+	struct IndexEntry
+	{
+		uint64_t m_hash;
+		uint32_t m_tile; // 1-based; 0 marks an empty entry
+		uint32_t m_padding;
+	};
+
+	struct PendingTile
+	{
+		uint64_t m_hash;
+		PatchStats m_stats;
+		std::vector<char> m_vertices;
+	};
+
+	const std::string m_directory;
+	const unsigned m_maxTiles;
+
+	// Win32 handles, kept as void* so that windows.h stays out of headers
+	void* m_file;
+	void* m_mapping;
+
+	char* m_view;
+	Header* m_header;
+	IndexEntry* m_index;
+	unsigned m_indexMask;
+	char* m_tiles;
+	size_t m_tileSizeBytes;
+
+	std::mutex m_indexMutex; // Index entries are only added by the writer
+
+	std::thread m_writer;
+	std::mutex m_pendingMutex;
+	std::condition_variable m_pendingCondition;
+	std::deque<PendingTile*> m_pendingTiles;
+	std::vector<PendingTile*> m_freeTiles;
+	bool m_stopping;
+
+	IndexEntry* findEntry(uint64_t hash) const;
+	void writeTile(const PendingTile& tile);
+	void runWriter();
+
+	public:
+
+	PatchTileCache(const std::string& directory, unsigned maxTiles);
+	~PatchTileCache();
+
+	// Maps the file for this planet and generator, starting it afresh if it
+	// was written by a different generator or with other patch constants.
+	void open(const std::string& planetName, uint64_t fingerprint);
+
+	// Looks up a stored patch. vertices points into the mapped file and stays
+	// valid while the cache is open.
+	bool find(const PatchHash& hash, PatchStats& stats, const void*& vertices);
+
+	// Queues a copy of a newly generated patch to be written; render thread only
+	void store(const PatchHash& hash, const PatchStats& stats, const void* vertices);
+
+	static PatchTileCache* buildFromXMLNode(XMLNode& node);
+};
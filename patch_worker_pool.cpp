@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstring>
+
+#include "patch_worker_pool.h"
+#include "patch_tile_cache.h"
+#include "planet_patch.h"
+#include "terrain_generators.h"
+
+PatchJob* PatchCompletionQueue::popAll()
+{
+	PatchJob* newestFirst = m_head.exchange(nullptr, std::memory_order_acquire);
+
+	// Reverse so that patches are uploaded in the order they finished
+	PatchJob* oldestFirst = nullptr;
+	while (newestFirst)
+	{
+		PatchJob* const next = newestFirst->m_next;
+		newestFirst->m_next = oldestFirst;
+		oldestFirst = newestFirst;
+		newestFirst = next;
+	}
+	return oldestFirst;
+}
+
+PatchWorkerPool::PatchWorkerPool(unsigned numWorkers) :
+	m_nextQueue(0)
+{
+	m_numQueuedJobs = 0;
+	m_stopping = false;
+
+	for (unsigned i = 0; i < numWorkers; ++i)
+		m_queues.push_back(new WorkerQueue());
+
+	// Only start threads once every queue exists, as any worker may steal from any queue
+	for (unsigned i = 0; i < numWorkers; ++i)
+		m_threads.emplace_back(&PatchWorkerPool::runWorker, this, i);
+}
+
+PatchWorkerPool::~PatchWorkerPool()
+{
+	stop();
+
+	for (auto queue : m_queues)
+		delete queue;
+}
+
+void PatchWorkerPool::submit(PatchJob* job)
+{
+	WorkerQueue* const queue = m_queues[m_nextQueue];
+	m_nextQueue = (m_nextQueue + 1) % m_queues.size();
+
+	queue->m_lock.acquire();
+	queue->m_jobs.push_back(job);
+	queue->m_lock.release();
+
+	// Count before taking the mutex, so a worker about to sleep sees the job
+	++m_numQueuedJobs;
+	std::lock_guard<std::mutex> lock(m_wakeMutex);
+	m_wakeCondition.notify_one();
+}
+
+void PatchWorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_stopping = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (auto& thread : m_threads)
+		if (thread.joinable())
+			thread.join();
+
+	// Hand back the jobs no worker took, so their owners can wait for every job
+	for (auto queue : m_queues)
+	{
+		for (auto job : queue->m_jobs)
+		{
+			job->m_skipped = true;
+			job->m_completionQueue->push(job);
+		}
+		queue->m_jobs.clear();
+	}
+	m_numQueuedJobs = 0;
+}
+
+PatchJob* PatchWorkerPool::takeJob(unsigned workerIndex)
+{
+	PatchJob* job = nullptr;
+
+	// Own queue first, oldest job first
+	WorkerQueue* const ownQueue = m_queues[workerIndex];
+	ownQueue->m_lock.acquire();
+	if (!ownQueue->m_jobs.empty())
+	{
+		job = ownQueue->m_jobs.front();
+		ownQueue->m_jobs.pop_front();
+	}
+	ownQueue->m_lock.release();
+
+	// Otherwise steal the newest job of the next busy worker
+	for (unsigned i = 1; !job && i < m_queues.size(); ++i)
+	{
+		WorkerQueue* const victim = m_queues[(workerIndex + i) % m_queues.size()];
+		victim->m_lock.acquire();
+		if (!victim->m_jobs.empty())
+		{
+			job = victim->m_jobs.back();
+			victim->m_jobs.pop_back();
+		}
+		victim->m_lock.release();
+	}
+
+	if (job)
+		--m_numQueuedJobs;
+	return job;
+}
+
+void PatchWorkerPool::runWorker(unsigned workerIndex)
+{
+	TerrainSamples samples; // Scratch space, reused for every patch
+
+	while (!m_stopping)
+	{
+		PatchJob* const job = takeJob(workerIndex);
+
+		if (job)
+		{
+			job->m_skipped = job->m_cancelled.load(std::memory_order_relaxed);
+			job->m_fromTileCache = false;
+			if (!job->m_skipped)
+			{
+				const void* cachedVertices;
+				if (job->m_tileCache && job->m_tileCache->find(job->m_patch->m_hash, job->m_stats, cachedVertices))
+				{
+					// Copied into staging here, so the render thread never reads the mapped file
+					memcpy(&job->m_vertices[0], cachedVertices, PLANET_PATCH_CONSTANTS->m_totalSizeBytes);
+					job->m_fromTileCache = true;
+				}
+				else
+				{
+					job->m_generator->generatePatchCPU(job->m_patch->m_hash, samples, &job->m_vertices[0], job->m_stats);
+				}
+			}
+			job->m_completionQueue->push(job);
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(m_wakeMutex);
+			m_wakeCondition.wait(lock, [this]() { return m_stopping || m_numQueuedJobs > 0; });
+		}
+	}
+}
+
+PatchWorkerPool* PATCH_WORKER_POOL;
+
+void initPatchWorkerPool()
+{
+	PATCH_WORKER_POOL = new PatchWorkerPool(std::max(std::thread::hardware_concurrency(), 1u));
+}
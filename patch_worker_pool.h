@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpu_terrain.h"
+#include "planet_data_buffer.h"
+#include "utils.h"
+
+struct PlanetPatch;
+class TerrainGenerator;
+class PatchTileCache;
+class PatchCompletionQueue;
+
+// One patch to be generated by a CPU terrain backend, or read from the tile
+// cache when stored there. Jobs belong to the Planet that submitted them; a
+// worker only touches a job between taking it and pushing it onto
+// m_completionQueue.
+struct PatchJob
+{
+	PlanetPatch* m_patch;
+	const TerrainGenerator* m_generator;
+	PatchTileCache* m_tileCache; // Read from before generating; null if the planet has none
+	PatchCompletionQueue* m_completionQueue;
+
+	// Set by the render thread once the patch is no longer wanted; a worker
+	// that has yet to start the job then skips it
+	std::atomic_bool m_cancelled;
+
+	// Results, read back on the render thread
+	bool m_skipped; // Cancelled in time; nothing was generated
+	bool m_fromTileCache; // Read back from m_tileCache rather than generated
+	PatchStats m_stats;
+	std::vector<char> m_vertices; // Staging memory for the upload, laid out as PLANET_PATCH_CONSTANTS says
+
+	PatchJob* m_next; // Link while in a PatchCompletionQueue
+
+	PatchJob() :
+		m_patch(nullptr), m_generator(nullptr), m_tileCache(nullptr), m_completionQueue(nullptr),
+		m_skipped(false), m_fromTileCache(false), m_vertices(PLANET_PATCH_CONSTANTS->m_totalSizeBytes), m_next(nullptr)
+	{
+		m_cancelled = false;
+	}
+};
+
+// Lock-free multiple-producer, single-consumer list of finished jobs.
+// Workers push one job at a time; the consumer only ever takes the whole
+// list, so a compare-and-swap push cannot suffer from ABA.
+class PatchCompletionQueue
+{
+	std::atomic<PatchJob*> m_head;
+
+	public:
+
+	PatchCompletionQueue() { m_head = nullptr; }
+
+	inline void push(PatchJob* job)
+	{
+		PatchJob* head = m_head.load(std::memory_order_relaxed);
+		do
+		{
+			job->m_next = head;
+		}
+		while (!m_head.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// Takes every finished job, returned as a list in completion order
+	PatchJob* popAll();
+
+	inline bool empty() const { return !m_head.load(std::memory_order_acquire); }
+};
+
+// Work-stealing pool of patch generation threads, one per core.
+// Submitted jobs are dealt round-robin onto per-worker queues. A worker takes
+// from the front of its own queue, which keeps the priority order of
+// Planet::m_queuedPatches, and when that runs dry steals from the back of
+// the others'.
+class PatchWorkerPool
+{
+	struct WorkerQueue
+	{
+		SpinLock m_lock;
+		std::deque<PatchJob*> m_jobs;
+	};
+
+	std::vector<std::thread> m_threads;
+	std::vector<WorkerQueue*> m_queues;
+	unsigned m_nextQueue; // Render thread only
+
+	std::atomic<int> m_numQueuedJobs; // Submitted, not yet taken by a worker
+	std::atomic_bool m_stopping;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+
+	PatchJob* takeJob(unsigned workerIndex);
+	void runWorker(unsigned workerIndex);
+
+	public:
+
+	PatchWorkerPool(unsigned numWorkers);
+	~PatchWorkerPool();
+
+	inline unsigned numWorkers() const { return (unsigned)m_threads.size(); }
+
+	// Render thread only
+	void submit(PatchJob* job);
+
+	// Finishes the job being run by each worker, then joins them. Jobs not yet
+	// started are pushed onto their completion queues as skipped.
+	void stop();
+};
+extern PatchWorkerPool* PATCH_WORKER_POOL;
+
+// Starts one worker per hardware thread
+void initPatchWorkerPool();
@@ -1,5 +1,46 @@
 #include "patchhash.h"
 
+// Found from dimsToUnnormalisedVec3: the point just past the middle of each
+// edge, projected onto the cube
+const FaceCrossing FACE_CROSSINGS[6][4] = {
+	{ // X_NEGATIVE
+		{ PatchOrientation::Z_NEGATIVE, MoveDirection::DIM0_NEGATIVE, false },
+		{ PatchOrientation::Z_POSITIVE, MoveDirection::DIM0_POSITIVE, false },
+		{ PatchOrientation::Y_NEGATIVE, MoveDirection::DIM0_POSITIVE, false },
+		{ PatchOrientation::Y_POSITIVE, MoveDirection::DIM0_POSITIVE, true }
+	},
+	{ // X_POSITIVE
+		{ PatchOrientation::Z_POSITIVE, MoveDirection::DIM0_NEGATIVE, false },
+		{ PatchOrientation::Z_NEGATIVE, MoveDirection::DIM0_POSITIVE, false },
+		{ PatchOrientation::Y_NEGATIVE, MoveDirection::DIM0_NEGATIVE, true },
+		{ PatchOrientation::Y_POSITIVE, MoveDirection::DIM0_NEGATIVE, false }
+	},
+	{ // Y_NEGATIVE
+		{ PatchOrientation::X_NEGATIVE, MoveDirection::DIM1_POSITIVE, false },
+		{ PatchOrientation::X_POSITIVE, MoveDirection::DIM1_POSITIVE, true },
+		{ PatchOrientation::Z_NEGATIVE, MoveDirection::DIM1_POSITIVE, true },
+		{ PatchOrientation::Z_POSITIVE, MoveDirection::DIM1_POSITIVE, false }
+	},
+	{ // Y_POSITIVE
+		{ PatchOrientation::X_NEGATIVE, MoveDirection::DIM1_NEGATIVE, true },
+		{ PatchOrientation::X_POSITIVE, MoveDirection::DIM1_NEGATIVE, false },
+		{ PatchOrientation::Z_POSITIVE, MoveDirection::DIM1_NEGATIVE, false },
+		{ PatchOrientation::Z_NEGATIVE, MoveDirection::DIM1_NEGATIVE, true }
+	},
+	{ // Z_NEGATIVE
+		{ PatchOrientation::X_POSITIVE, MoveDirection::DIM0_NEGATIVE, false },
+		{ PatchOrientation::X_NEGATIVE, MoveDirection::DIM0_POSITIVE, false },
+		{ PatchOrientation::Y_NEGATIVE, MoveDirection::DIM1_POSITIVE, true },
+		{ PatchOrientation::Y_POSITIVE, MoveDirection::DIM1_NEGATIVE, true }
+	},
+	{ // Z_POSITIVE
+		{ PatchOrientation::X_NEGATIVE, MoveDirection::DIM0_NEGATIVE, false },
+		{ PatchOrientation::X_POSITIVE, MoveDirection::DIM0_POSITIVE, false },
+		{ PatchOrientation::Y_NEGATIVE, MoveDirection::DIM1_NEGATIVE, false },
+		{ PatchOrientation::Y_POSITIVE, MoveDirection::DIM1_POSITIVE, false }
+	}
+};
+
 void printHash(PatchHash p)
 {
 	const PatchOrientation po = p.getOrientation();
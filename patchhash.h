@@ -96,6 +96,32 @@ inline glm::vec3 dimsToVec3(PatchOrientation patchOrientation, float dim0, float
 	return glm::normalize(dimsToUnnormalisedVec3(patchOrientation, dim0, dim1));
 }
 
+// Builds a hash from the patch's place among the (1 << level) by (1 << level)
+// patches of its level on its face
+inline uint64_t makePatchHashFromIndexes(
+	PatchOrientation patchOrientation, int level, uint32_t dim0Index, uint32_t dim1Index
+)
+{
+	assert(dim0Index < (1u << level) && dim1Index < (1u << level));
+	return
+		patchOrientationToBits(patchOrientation) |
+		levelToBits(level) |
+		(static_cast<uint64_t>(dim0Index) << (DIM0_SHIFT + 28 - level)) |
+		(static_cast<uint64_t>(dim1Index) << (DIM1_SHIFT + 28 - level))
+	;
+}
+
+// Where moving off each edge of each face leads: the face, the direction that
+// continues the same way on it, and whether positions along the edge run the
+// other way there. By PatchOrientation, then MoveDirection.
+struct FaceCrossing
+{
+	PatchOrientation m_orientation;
+	MoveDirection m_direction;
+	bool m_reversed;
+};
+extern const FaceCrossing FACE_CROSSINGS[6][4];
+
 const uint64_t X_NEGATIVE_ROOT = (uint64_t)PatchOrientation::X_NEGATIVE << ORIENTATION_SHIFT;
 const uint64_t X_POSITIVE_ROOT = (uint64_t)PatchOrientation::X_POSITIVE << ORIENTATION_SHIFT;
 const uint64_t Y_NEGATIVE_ROOT = (uint64_t)PatchOrientation::Y_NEGATIVE << ORIENTATION_SHIFT;
@@ -166,6 +192,79 @@ struct PatchHash
 		);
 	}
 
+	// Place among the patches of this level on this face, from 0 to (1 << level) - 1
+	inline uint32_t getDim0Index() const { return static_cast<uint32_t>(getDim0Bits() >> (DIM0_SHIFT + 28 - getLevel())); }
+	inline uint32_t getDim1Index() const { return static_cast<uint32_t>(getDim1Bits() >> (DIM1_SHIFT + 28 - getLevel())); }
+
+	// The patch of the same level across the given edge. Where that is on
+	// another face, direction becomes the one that continues the same way there.
+	inline PatchHash move(MoveDirection& direction) const
+	{
+		const PatchOrientation po = getOrientation();
+		const int level = getLevel();
+		const uint32_t lastIndex = (1u << level) - 1;
+		const uint32_t dim0Index = getDim0Index();
+		const uint32_t dim1Index = getDim1Index();
+
+		uint32_t alongIndex; // Position along the edge crossed
+		switch (direction)
+		{
+			case MoveDirection::DIM0_NEGATIVE:
+				if (dim0Index > 0)
+					return makePatchHashFromIndexes(po, level, dim0Index - 1, dim1Index);
+				alongIndex = dim1Index;
+				break;
+			case MoveDirection::DIM0_POSITIVE:
+				if (dim0Index < lastIndex)
+					return makePatchHashFromIndexes(po, level, dim0Index + 1, dim1Index);
+				alongIndex = dim1Index;
+				break;
+			case MoveDirection::DIM1_NEGATIVE:
+				if (dim1Index > 0)
+					return makePatchHashFromIndexes(po, level, dim0Index, dim1Index - 1);
+				alongIndex = dim0Index;
+				break;
+			default:
+				if (dim1Index < lastIndex)
+					return makePatchHashFromIndexes(po, level, dim0Index, dim1Index + 1);
+				alongIndex = dim0Index;
+				break;
+		}
+
+		const FaceCrossing& crossing = FACE_CROSSINGS[static_cast<int>(po)][static_cast<int>(direction)];
+		if (crossing.m_reversed)
+			alongIndex = lastIndex - alongIndex;
+		direction = crossing.m_direction;
+
+		switch (direction)
+		{
+			case MoveDirection::DIM0_NEGATIVE: return makePatchHashFromIndexes(crossing.m_orientation, level, lastIndex, alongIndex);
+			case MoveDirection::DIM0_POSITIVE: return makePatchHashFromIndexes(crossing.m_orientation, level, 0, alongIndex);
+			case MoveDirection::DIM1_NEGATIVE: return makePatchHashFromIndexes(crossing.m_orientation, level, alongIndex, lastIndex);
+			default:                           return makePatchHashFromIndexes(crossing.m_orientation, level, alongIndex, 0);
+		}
+	}
+
+	// As move(), for when the direction on the far side doesn't matter
+	inline PatchHash getNeighbour(MoveDirection direction) const
+	{
+		return move(direction);
+	}
+
+	inline PatchHash getChild(ChildPosition childPosition) const
+	{
+		const int level = getLevel() + 1;
+		const bool dim0Hi = childPosition == ChildPosition::DIM0HI_DIM1LO || childPosition == ChildPosition::DIM0HI_DIM1HI;
+		const bool dim1Hi = childPosition == ChildPosition::DIM0LO_DIM1HI || childPosition == ChildPosition::DIM0HI_DIM1HI;
+
+		return PatchHash(
+			getOrientationBits() |
+			levelToBits(level) |
+			getDim0Bits() | (static_cast<uint64_t>(dim0Hi) << (DIM0_SHIFT + 28 - level)) |
+			getDim1Bits() | (static_cast<uint64_t>(dim1Hi) << (DIM1_SHIFT + 28 - level))
+		);
+	}
+
 	inline PatchHash getParent(ChildPosition& childPosition) const
 	{
 		const int level = getLevel();
@@ -5,6 +5,8 @@
 #include "utils.h"
 #include "planet_data_buffer.h"
 #include "lightsource.h"
+#include "frame_task_pool.h"
+#include "patch_culling.h"
 
 static inline int fastIntMaxZero(int x)
 {
@@ -63,12 +65,12 @@ static inline void cameraPositionToPatchPosition(
 		if (cameraPosition.y < 0.0)
 		{
 			*po = PatchOrientation::Y_NEGATIVE; 
-			patchPosition.x = positionOnCube.x; patchPosition.y = -positionOnCube.z;
+			patchPosition.x = positionOnCube.x; patchPosition.y = positionOnCube.z;
 		}
 		else
 		{
 			*po = PatchOrientation::Y_POSITIVE; 
-			patchPosition.x = positionOnCube.x; patchPosition.y = positionOnCube.z;
+			patchPosition.x = positionOnCube.x; patchPosition.y = -positionOnCube.z;
 		}
 	}
 	else
@@ -88,6 +90,14 @@ static inline void cameraPositionToPatchPosition(
 	}
 }
 
+// The two children along each edge, by MoveDirection
+const ChildPosition EDGE_CHILD_POSITIONS[4][2] = {
+	{ ChildPosition::DIM0LO_DIM1LO, ChildPosition::DIM0LO_DIM1HI },
+	{ ChildPosition::DIM0HI_DIM1LO, ChildPosition::DIM0HI_DIM1HI },
+	{ ChildPosition::DIM0LO_DIM1LO, ChildPosition::DIM0HI_DIM1LO },
+	{ ChildPosition::DIM0LO_DIM1HI, ChildPosition::DIM0HI_DIM1HI }
+};
+
 static std::vector<PlanetPatch*> makeRootPatches()
 {
 	return std::vector<PlanetPatch*>({
@@ -109,10 +119,21 @@ static AtmosphereConstants* addRadiusToConstants(AtmosphereConstants* ac, float
 
 #include "planet_overlay_macros.inl"
 
+// Until a patch is generated, bound it by its generator's altitude estimate,
+// or failing that guess it spans its parent's range
+static inline void setEstimatedAltitudes(PlanetPatch* patch, const TerrainGenerator* generator)
+{
+	float minAltitude, maxAltitude;
+	if (generator->getAltitudeBounds(patch->m_hash, minAltitude, maxAltitude))
+		patch->setAltitudes(minAltitude, maxAltitude);
+	else if (patch->m_parent)
+		patch->setAltitudes(patch->m_parent->m_minAltitude, patch->m_parent->m_maxAltitude);
+}
+
 Planet::Planet(
 	const std::string& name, 
 	float radius, TerrainGenerator* terrainGenerator, 
-	AtmosphereConstants* atmosphereConstants,
+	PatchTileCache* tileCache, AtmosphereConstants* atmosphereConstants,
 	Water* water, Position* position
 ) :
 	Shape(name, position),
@@ -127,7 +148,11 @@ Planet::Planet(
 	m_atmosphereConstants(atmosphereConstants),
 	m_overlay_bar(TwNewBar(std::string("Planet - " + m_name).c_str())),
 	m_rootPatches(makeRootPatches()),
+	m_patchPool(1024),
+	m_lastReclaimTime(0.0),
+	m_traversalNumber(0),
 	m_terrainGenerator(terrainGenerator),
+	m_tileCache(tileCache),
 	m_terrainInAtmProgram(
 		new TerrainDrawProgram(
 			atmosphereConstants ?
@@ -156,36 +181,91 @@ Planet::Planet(
 		) :
 		0
 	),
-	m_water(water)
+	m_water(water),
+	m_overlay_patchJobsInFlight(0),
+	m_overlay_patchJobsCancelled(0),
+	m_overlay_patchBlocksReclaimed(0),
+	m_overlay_tileCacheHits(0)
 {
 	// Set up overlay
 	TwSetParam(m_overlay_bar, NULL, "refresh", TW_PARAM_CSTRING, 1, "0.1");
 	TwAddVarRO(m_overlay_bar, "Num CPU Patches", TW_TYPE_INT32, &m_overlay_numPatches, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Queue Size", TW_TYPE_INT32, &m_overlay_queueSize, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Jobs In Flight", TW_TYPE_INT32, &m_overlay_patchJobsInFlight, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Jobs Cancelled", TW_TYPE_INT32, &m_overlay_patchJobsCancelled, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Tile Cache Hits", TW_TYPE_INT32, &m_overlay_tileCacheHits, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "T Patches Drawn", TW_TYPE_INT32, &m_overlay_terrainPatchesDrawn, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "W Patches Drawn", TW_TYPE_INT32, &m_overlay_waterPatchesDrawn, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Lowest Patch", TW_TYPE_INT32, &m_overlay_lowestPatchLevel, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Highest Patch", TW_TYPE_INT32, &m_overlay_highestPatchLevel, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Patches Traversed", TW_TYPE_INT32, &m_overlay_patchesTraversed, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Subtrees Reused", TW_TYPE_INT32, &m_overlay_subtreesReused, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Balance Splits", TW_TYPE_INT32, &m_overlay_balanceSplits, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Patches Discarded", TW_TYPE_INT32, &m_overlay_patchesDiscarded, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Node Blocks Used", TW_TYPE_INT32, &m_overlay_patchBlocksInUse, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Node Blocks Freed", TW_TYPE_INT32, &m_overlay_patchBlocksReclaimed, " group=Statistics ");
+	TwAddVarRO(m_overlay_bar, "Node Pool MB", TW_TYPE_FLOAT, &m_overlay_patchPoolMB, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Altitude", TW_TYPE_FLOAT, &m_overlay_altitude, " group=Statistics ");
 	TwAddVarRO(m_overlay_bar, "Ground Altitude", TW_TYPE_FLOAT, &m_overlay_groundAltitude, " group=Statistics ");
 	m_terrainGenerator->addToOverlay(m_overlay_bar);
+
+	if (m_tileCache)
+		m_tileCache->open(m_name, m_terrainGenerator->getFingerprint());
 	
+	// Room for a full page's patches, and as many again unpopulated. The data
+	// buffer is shared between planets and its pages are only made resident
+	// as needed, so the map grows with the pages this planet fills rather
+	// than reserving for the whole buffer up front.
+	m_patchMap.reserve(2 * PLANET_DATA_BUFFER->m_pageSizePatches);
+
 	// Add root patches to patchmap
 	for (int i = 0; i < m_rootPatches.size(); ++i)
+	{
 		m_patchMap.emplace(m_rootPatches[i]->m_hash.m_value, m_rootPatches[i]);
+		setEstimatedAltitudes(m_rootPatches[i], m_terrainGenerator);
+	}
+
+	// The root patches' bounds between them bound the whole planet
+	{
+		bool bounded = true;
+		float lowest = std::numeric_limits<float>::max();
+		for (int i = 0; i < m_rootPatches.size(); ++i)
+		{
+			float minAltitude, maxAltitude;
+			if (m_terrainGenerator->getAltitudeBounds(m_rootPatches[i]->m_hash, minAltitude, maxAltitude))
+				lowest = std::min(lowest, minAltitude);
+			else
+				bounded = false;
+		}
+
+		m_occluderRadius = m_water ? 1.0f : 0.0f;
+		if (bounded)
+			m_occluderRadius = std::max(m_occluderRadius, lowest);
+	}
 
 	// Set up terrain vertex array
 	{
+		// Vertices come from binding 0, which drawImmediate points at each page's buffer in turn
 		glBindVertexArray(m_terrainDrawVertexArray.m_id);
-		glBindBuffer(GL_ARRAY_BUFFER, PLANET_DATA_BUFFER->m_vertexBuffer.m_id);
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PatchVertexData), (void*)offsetof(PatchVertexData, positionAndNormal));
-		glVertexAttribPointer(1, GL_BGRA, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE, sizeof(PatchVertexData), (void*)offsetof(PatchVertexData, positionAndNormal.w));
-		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(PatchVertexData), (void*)offsetof(PatchVertexData, colour));
+		if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+		{
+			// Decoded in the shader; see lib_patch_vertex.glsl
+			glEnableVertexAttribArray(0);
+			glVertexAttribIFormat(0, 2, GL_UNSIGNED_INT, 0);
+			glVertexAttribBinding(0, 0);
+		}
+		else
+		{
+			glEnableVertexAttribArray(0);
+			glEnableVertexAttribArray(1);
+			glEnableVertexAttribArray(2);
+			glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, offsetof(PatchVertexData, positionAndNormal));
+			glVertexAttribFormat(1, GL_BGRA, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE, offsetof(PatchVertexData, positionAndNormal.w));
+			glVertexAttribFormat(2, 4, GL_FLOAT, GL_FALSE, offsetof(PatchVertexData, colour));
+			glVertexAttribBinding(0, 0);
+			glVertexAttribBinding(1, 0);
+			glVertexAttribBinding(2, 0);
+		}
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, PLANET_DATA_BUFFER->m_indexBuffer.m_id);
 		glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer.m_id);
 		glBufferData(GL_UNIFORM_BUFFER, sizeof(PlanetUniforms), nullptr, GL_DYNAMIC_DRAW); // Allocate space here (because we bind it first)
@@ -197,9 +277,12 @@ Planet::Planet(
 	if (m_water)
 	{
 		glBindVertexArray(m_waterDrawVertexArray.m_id);
-		glBindBuffer(GL_ARRAY_BUFFER, PLANET_DATA_BUFFER->m_vertexBuffer.m_id);
 		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PatchVertexData), (void*)offsetof(PatchVertexData, positionAndNormal));
+		if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+			glVertexAttribIFormat(0, 2, GL_UNSIGNED_INT, 0);
+		else
+			glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, offsetof(PatchVertexData, positionAndNormal));
+		glVertexAttribBinding(0, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, PLANET_DATA_BUFFER->m_indexBuffer.m_id);
 		glBindBufferBase(GL_UNIFORM_BUFFER, PLANET_UNIFORMS_BINDING_POINT, m_uniformBuffer.m_id);
 		glBindVertexArray(0);
@@ -255,31 +338,122 @@ Planet::Planet(
 
 Planet::~Planet()
 {
+	// Workers may still hold jobs, which point at this planet's patches and
+	// generator. Cancel them all and wait for each to come back, finished
+	// jobs not yet uploaded included.
+	for (auto job : m_patchJobsInFlight)
+		job->m_cancelled.store(true, std::memory_order_relaxed);
+
+	while (!m_patchJobsInFlight.empty())
+	{
+		PatchJob* job = m_completedPatchJobs.popAll();
+		if (!job)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		while (job)
+		{
+			PatchJob* const next = job->m_next;
+			m_patchJobsInFlight.erase(std::find(m_patchJobsInFlight.begin(), m_patchJobsInFlight.end(), job));
+			delete job;
+			job = next;
+		}
+	}
+
+	for (auto job : m_freePatchJobs)
+		delete job;
+
+	delete m_tileCache; // Finishes writing queued tiles
 	delete m_terrainGenerator;
 	delete m_position;
 	TwDeleteBar(m_overlay_bar);
 }
 
 
-static inline int patchVisible(
-	const glm::vec3& v3_cameraPos_MS,
-	const PatchHash& hash,
-	const PatchHash& currentPatchHashPosition,
-	const PatchBoundingVectors& vecs,
-	const Frustum& frustum
+// Per-frame inputs of the patch quadtree walk, shared by every task
+struct PatchTraversalView : public PatchCullingView
+{
+	float m_pixelsPerRadian; // At the centre of the view
+
+	// For GLOBALS.m_screenSpaceErrorLod: geometric error times this is the
+	// distance at which it projects to GLOBALS.m_maxPixelError pixels
+	float m_errorSplitScale;
+	float m_rootFacetError; // Of a level 0 patch; see getGeometricError
+	double m_time;          // For PlanetPatch::m_splitTime
+
+	PatchTraversalView(const glm::vec3& cameraPos_MS, const Frustum& frustum, float occluderRadius, float pixelsPerRadian, double time)
+	{
+		m_time = time;
+		m_cameraPos_MS = cameraPos_MS;
+		m_cameraDist = glm::length(cameraPos_MS);
+		m_occluderRadius = occluderRadius;
+		m_frustumPlanes[0] = frustum.m_nearPlane;
+		m_frustumPlanes[1] = frustum.m_rightPlane;
+		m_frustumPlanes[2] = frustum.m_leftPlane;
+		m_frustumPlanes[3] = frustum.m_bottomPlane;
+		m_frustumPlanes[4] = frustum.m_topPlane;
+		m_frustumPlanes[5] = frustum.m_farPlane;
+
+		m_pixelsPerRadian = pixelsPerRadian;
+		m_errorSplitScale = pixelsPerRadian / GLOBALS.m_maxPixelError;
+		const float vertexSpacing = 2.0f / PLANET_PATCH_CONSTANTS->m_visiblePolygons;
+		m_rootFacetError = 0.125f * vertexSpacing * vertexSpacing;
+	}
+
+	// How far a patch's triangles may be from the terrain: its altitude
+	// spread, plus how far a flat triangle sags below the sphere. A chord c
+	// of the unit sphere sags by at most c^2/8, and a vertex spacing on the
+	// sphere is at most that on the cube.
+	inline float getGeometricError(const PlanetPatch* patch) const
+	{
+		return patch->m_geometricError + ldexpf(m_rootFacetError, -2 * patch->m_hash.getLevel());
+	}
+
+	// hole: nothing will be drawn in the patch's place until it is generated
+	inline PatchPriority getGenerationPriority(const PlanetPatch* patch, bool hole) const
+	{
+		PatchPriority priority;
+		priority.m_hole = hole;
+		priority.m_distance = std::max(
+			glm::length(m_cameraPos_MS - patch->m_boundingVectors.m_center) - patch->m_boundingVectors.m_radius, 0.0f
+		);
+		priority.m_pixelError = getGeometricError(patch) * m_pixelsPerRadian / std::max(priority.m_distance, 1e-9f);
+		return priority;
+	}
+};
+
+// Whether a subtree's walk from an earlier frame still holds: no patch in it
+// has changed, and neither the camera nor the frustum has moved by its slack.
+static bool traversalStillValid(
+	const PatchTraversalView& view,
+	const std::pair<PlanetPatch*, bool>& root,
+	const PatchTraversal& traversal
 )
 {
-	const float maxDist2 = glm::length2(v3_cameraPos_MS) - 1.0f;
-	return (
-		(
-			currentPatchHashPosition.m_value != hash.m_value && 
-			dist2PointToLineSegment(v3_cameraPos_MS, vecs.m_corner00, vecs.m_corner01) > maxDist2 && // FIX maxDist2 so this works underwater!
-			dist2PointToLineSegment(v3_cameraPos_MS, vecs.m_corner00, vecs.m_corner10) > maxDist2 &&
-			dist2PointToLineSegment(v3_cameraPos_MS, vecs.m_corner11, vecs.m_corner01) > maxDist2 &&
-			dist2PointToLineSegment(v3_cameraPos_MS, vecs.m_corner11, vecs.m_corner10) > maxDist2
-		) ||
-		frustum.sphereOutside(vecs.m_center, vecs.m_radius)
-	) ? 0 : 1;
+	const PlanetPatch* const patch = root.first;
+
+	if (patch->m_subtreeChanged || traversal.m_rootParentDrawn != root.second)
+		return false;
+
+	if (traversal.m_level1Distance != GLOBALS.m_planetLevel1Distance || traversal.m_maxPatchLevel != GLOBALS.m_maxPlanetPatchLevel)
+		return false;
+
+	if (traversal.m_screenSpaceErrorLod != GLOBALS.m_screenSpaceErrorLod || traversal.m_errorSplitScale != view.m_errorSplitScale)
+		return false;
+
+	if (glm::length(view.m_cameraPos_MS - traversal.m_cameraPos_MS) >= traversal.m_moveSlack)
+		return false;
+
+	// A plane's value at a point p changes by at most |dn|*|p| + |dw|
+	for (int i = 0; i < 6; ++i)
+	{
+		const glm::vec4 delta = view.m_frustumPlanes[i] - traversal.m_frustumPlanes[i];
+		if (glm::length(glm::vec3(delta))*traversal.m_maxCenterLength + fabs(delta.w) >= traversal.m_frustumSlack)
+			return false;
+	}
+	return true;
 }
 
 void Planet::updateGeneral(const WorldClock& worldClock)
@@ -310,27 +484,29 @@ void Planet::draw(const Scene* scene, const Camera* camera)
 {
 	std::vector<PlanetPatch*> drawList;
 
-	//PLANET_DATA_BUFFER->m_bufferLock.acquire();
+	// No walk is in flight, this planet's or another's, so evicting here
+	// can't race one; nor can a patch in drawList be evicted before it is drawn
+	PLANET_DATA_BUFFER->applyPendingEvictions();
 
 	populateDrawLists(scene, camera, drawList);
 
 	// Draw terrain and sky
 	drawImmediate(scene, camera, drawList);
-
-	// If there are patches to be calculated, don't release the buffer lock,
-	// because garbage collection will corrupt the state of the buffer - 
-	// calculation of queued patches must finish first.
-	//glFinish();
-	//if (m_queuedPatches.empty())
-	//	PLANET_DATA_BUFFER->m_bufferLock.release(); // What about multiple shapes??!?
 }
 
 void Planet::populateDrawLists(const Scene* scene, const Camera* camera, std::vector<PlanetPatch*>& drawList)
 {
-	const unsigned oldQueueSize = (unsigned)m_queuedPatches.size();
 	m_queuedPatches.clear();
 
+	const double time = glfwGetTime();
+	if (time - m_lastReclaimTime >= 1.0)
+	{
+		reclaimPatches(time);
+		m_lastReclaimTime = time;
+	}
+
 	const glm::vec3 v3f_cameraPos_MS(glm::inverse(m_m4d_absTerrainM) * glm::dvec4(camera->getAbsPosition(), 1.0f));
+	m_v3f_cameraPos_MS = v3f_cameraPos_MS;
 	m_overlay_altitude = glm::length(m_v3f_planetPos_VS) - m_radius;
 
 	PatchOrientation eyePatchOrientation; glm::vec3 eyePatchPosition;
@@ -338,55 +514,15 @@ void Planet::populateDrawLists(const Scene* scene, const Camera* camera, std::ve
 	
 	const Frustum frustum(glm::mat4(camera->getAbsViewProjectionMatrix() * m_m4d_absTerrainM));
 
-	std::vector<std::pair<PlanetPatch*, bool>> patchQueue;
-	patchQueue.reserve(100000);
-	for (int i = 0; i < m_rootPatches.size(); ++i)
-		patchQueue.emplace_back(m_rootPatches[i], false);
-
-	// Reset variables
-	m_overlay_lowestPatchLevel = 10000;
-	m_overlay_highestPatchLevel = -1;
-	m_overlay_patchesTraversed = 0;
-	m_overlay_patchesDiscarded = 0;
+	// Screen pixels per radian at the centre of the view, as the projection scales them
+	const float pixelsPerRadian = 0.5f * GLOBALS.getWindowHeight() * camera->getProjectionMatrix()[1][1];
 
-	// We should be grouping patches into which edges are drawn based on the detail level of neighbouring patches.
-	// For now, we'll just draw everything at maximum detail and cope with the seams.
-
-	const PatchHash currentPatchHashPositions[28] = {
-		makePatchHash(eyePatchOrientation, 0, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 1, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 2, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 3, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 4, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 5, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 6, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 7, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 8, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 9, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 10, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 11, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 12, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 13, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 14, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 15, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 16, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 17, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 18, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 19, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 20, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 21, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 22, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 23, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 24, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 25, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 26, eyePatchPosition.x, eyePatchPosition.y),
-		makePatchHash(eyePatchOrientation, 27, eyePatchPosition.x, eyePatchPosition.y)
-	};
+	PatchTraversalView view(v3f_cameraPos_MS, frustum, m_occluderRadius, pixelsPerRadian, time);
 
 	// Find current ground altitude
 	for (int i = 0; i < 28; ++i)
 	{
-		auto it = m_patchMap.find(currentPatchHashPositions[i].m_value);
+		auto it = m_patchMap.find(makePatchHash(eyePatchOrientation, i, eyePatchPosition.x, eyePatchPosition.y));
 		if (it == m_patchMap.end())
 			break;
 
@@ -396,100 +532,421 @@ void Planet::populateDrawLists(const Scene* scene, const Camera* camera, std::ve
 		m_overlay_groundAltitude = it->second->m_averageAltitude - 1.0f;
 	}
 
-	for (auto it = patchQueue.begin(); it != patchQueue.end(); ++it)
+	// Walk down to the split level here. Each patch reached there roots a
+	// subtree, walked again by a task on FRAME_TASK_POOL only when its walk
+	// from an earlier frame no longer holds; otherwise that walk is reused.
+	++m_traversalNumber;
+	m_topTraversal.reset();
+	for (int i = 0; i < m_rootPatches.size(); ++i)
+		if (testPatchVisible(view, m_rootPatches[i]))
+			m_topTraversal.m_queue.emplace_back(m_rootPatches[i], false);
+	traversePatches(view, std::max(GLOBALS.m_parallelTraversalLevel, 0), m_topTraversal);
+
+	const std::vector<std::pair<PlanetPatch*, bool>>& splitPatches = m_topTraversal.m_splitPatches;
+	m_splitTraversals.clear();
+	m_staleSplits.clear();
+	for (unsigned i = 0; i < splitPatches.size(); ++i)
+	{
+		PatchTraversal& traversal = m_subtreeTraversals[splitPatches[i].first->m_hash.m_value];
+		traversal.m_traversalNumber = m_traversalNumber;
+		m_splitTraversals.push_back(&traversal);
+
+		if (!traversalStillValid(view, splitPatches[i], traversal))
+			m_staleSplits.push_back(i);
+	}
+
+	FRAME_TASK_POOL->run((unsigned)m_staleSplits.size(), [this, &view](unsigned task) {
+		const unsigned split = m_staleSplits[task];
+		const std::pair<PlanetPatch*, bool>& root = m_topTraversal.m_splitPatches[split];
+		PatchTraversal& traversal = *m_splitTraversals[split];
+
+		root.first->m_subtreeChanged = false; // Before the walk, so that changes during it count
+		traversal.reset();
+		traversal.m_queue.push_back(root);
+		traversePatches(view, std::numeric_limits<int>::max(), traversal);
+
+		traversal.m_cameraPos_MS = view.m_cameraPos_MS;
+		std::copy(view.m_frustumPlanes, view.m_frustumPlanes + 6, traversal.m_frustumPlanes);
+		traversal.m_level1Distance = GLOBALS.m_planetLevel1Distance;
+		traversal.m_screenSpaceErrorLod = GLOBALS.m_screenSpaceErrorLod;
+		traversal.m_errorSplitScale = view.m_errorSplitScale;
+		traversal.m_maxPatchLevel = GLOBALS.m_maxPlanetPatchLevel;
+		traversal.m_rootParentDrawn = root.second;
+	});
+
+	// Forget the subtrees no longer reached
+	for (auto it = m_subtreeTraversals.begin(); it != m_subtreeTraversals.end(); )
+	{
+		if (it->second.m_traversalNumber != m_traversalNumber)
+			it = m_subtreeTraversals.erase(it);
+		else
+			++it;
+	}
+
+	// Reset variables
+	m_overlay_lowestPatchLevel = 10000;
+	m_overlay_highestPatchLevel = -1;
+	m_overlay_patchesTraversed = m_topTraversal.m_patchesTraversed;
+	m_overlay_patchesDiscarded = 0;
+	m_overlay_subtreesReused = (int)(splitPatches.size() - m_staleSplits.size());
+
+	for (auto split : m_staleSplits)
+		m_overlay_patchesTraversed += m_splitTraversals[split]->m_patchesTraversed;
+
+	// Merge in split order, so the result does not depend on scheduling
+	m_splitTraversals.insert(m_splitTraversals.begin(), &m_topTraversal);
+	for (auto traversal : m_splitTraversals)
+	{
+		drawList.insert(drawList.end(), traversal->m_drawList.begin(), traversal->m_drawList.end());
+		for (auto& queued : traversal->m_queuedPatches)
+			m_queuedPatches.push(queued.first, queued.second);
+
+		for (auto patch : traversal->m_newPatches)
+			m_patchMap.emplace(patch->m_hash.m_value, patch);
+		traversal->m_newPatches.clear(); // Not again if the walk is reused
+
+		m_overlay_lowestPatchLevel = std::min(traversal->m_lowestPatchLevel, m_overlay_lowestPatchLevel);
+		m_overlay_highestPatchLevel = std::max(traversal->m_highestPatchLevel, m_overlay_highestPatchLevel);
+	}
+
+	balanceDrawList(view, drawList);
+
+	// Back-pressure: start no more patches than there are slots left for,
+	// counting those of jobs in flight, and only holes once nearly full
+	const unsigned numFreePatches = PLANET_DATA_BUFFER->numFreePatches();
+	const bool bufferNearlyFull = PLANET_DATA_BUFFER->isNearlyFull();
+
+	const unsigned numPatchesRoomFor = numFreePatches > m_patchJobsInFlight.size() ?
+		numFreePatches - (unsigned)m_patchJobsInFlight.size() : 0
+	;
+	m_queuedPatches.setBudget(std::min(numPatchesRoomFor, GLOBALS.m_patchBudgetPerFrame > 0 ? 
+		(unsigned)GLOBALS.m_patchBudgetPerFrame : std::numeric_limits<unsigned>::max()
+	));
+	m_queuedPatches.setHolesOnly(bufferNearlyFull);
+
+	// Workers skip jobs for patches this frame no longer wants
+	for (auto job : m_patchJobsInFlight)
+	{
+		if (!m_queuedPatches.contains(job->m_patch) && !job->m_cancelled.load(std::memory_order_relaxed))
+		{
+			job->m_cancelled.store(true, std::memory_order_relaxed);
+			++m_overlay_patchJobsCancelled;
+		}
+	}
+	
+	// Jobs in flight still need uploading once done, even with nothing new queued
+	if (m_queuedPatches.available() > 0 || !m_patchJobsInFlight.empty())
+		ComputeQueue::get().addClient(this);
+	
+	m_overlay_numPatches = (int)m_patchMap.size();
+	m_overlay_patchBlocksInUse = (int)m_patchPool.getBlocksInUse();
+	m_overlay_patchPoolMB = (float)m_patchPool.getSizeBytes() / (1024.0f * 1024.0f);
+	m_overlay_queueSize = (int)m_queuedPatches.size();
+}
+
+void Planet::traversePatches(const PatchTraversalView& view, int splitLevel, PatchTraversal& traversal) const
+{
+	// The queue grows as it is walked, so index rather than iterate
+	for (size_t queueIndex = 0; queueIndex < traversal.m_queue.size(); ++queueIndex)
 	{
-		++m_overlay_patchesTraversed;
-		PlanetPatch* const patch = it->first;
-		const bool parentAlreadyDrawn = it->second;
+		PlanetPatch* const patch = traversal.m_queue[queueIndex].first;
+		const bool parentAlreadyDrawn = traversal.m_queue[queueIndex].second;
 		
 		// Note: this can be made faster - do it later if necessary
 		const PatchHash& hash = patch->m_hash;
 		const int patchLevel = hash.getLevel();
+
+		if (patchLevel >= splitLevel)
+		{
+			traversal.m_splitPatches.push_back(traversal.m_queue[queueIndex]);
+			continue;
+		}
+
+		++traversal.m_patchesTraversed;
+
+		bool split = false;
+		if (patchLevel < GLOBALS.m_maxPlanetPatchLevel)
+		{
+			const float distance = glm::length(view.m_cameraPos_MS - patch->m_boundingVectors.m_center);
+			if (GLOBALS.m_screenSpaceErrorLod)
+			{
+				// Split while the error, seen from the patch's nearest point,
+				// would project to more than the pixel tolerance
+				const float splitDistance = 
+					view.getGeometricError(patch) * view.m_errorSplitScale + patch->m_boundingVectors.m_radius;
+				split = distance < splitDistance;
+				traversal.m_moveSlack = std::min(traversal.m_moveSlack, fabsf(distance - splitDistance) - 1e-5f*splitDistance);
+			}
+			else
+			{
+				// desiredLevel > patchLevel exactly when the camera is nearer than
+				// this; allow for fastLog2's rounding at the boundary
+				const float splitDistance = ldexpf(GLOBALS.m_planetLevel1Distance / SQRT_2, -patchLevel);
+				traversal.m_moveSlack = std::min(traversal.m_moveSlack, fabsf(distance - splitDistance) - 1e-5f*splitDistance);
+
+				// log(x^2) == log(x)*2, therefore right shift by 1 (divide by 2) at the end:
+				// this means we don't need a sqrtf via glm::length.
+				const int desiredLevel = fastIntMaxZero(fastCeil(fastLog2(
+					GLOBALS.m_planetLevel1Distance * GLOBALS.m_planetLevel1Distance / 
+					glm::length2(view.m_cameraPos_MS - patch->m_boundingVectors.m_center)
+				))) >> 1;
+				split = desiredLevel > patchLevel;
+			}
+		}
 		
-		// log(x^2) == log(x)*2, therefore right shift by 1 (divide by 2) at the end:
-		// this means we don't need a sqrtf via glm::length.
-		const int desiredLevel = fastIntMaxZero(fastCeil(fastLog2(
-			GLOBALS.m_planetLevel1Distance * GLOBALS.m_planetLevel1Distance / 
-			glm::length2(v3f_cameraPos_MS - patch->m_boundingVectors.m_center)
-		))) >> 1;
-		
-		if (desiredLevel > patchLevel && patchLevel < GLOBALS.m_maxPlanetPatchLevel) 
+		if (split) 
 		{
 			// We need to traverse deeper
+			patch->m_splitTime = view.m_time;
+			traversal.m_splitPatchesInWalk.push_back(patch);
 
 			if (!patch->m_children)
 			{
 				// Need children drawn - make child patches if necessary
-				
-				const PatchOrientation po = hash.getOrientation();
-				const float dim0 = hash.getDim0();
-				const float dim1 = hash.getDim1();
-				const float halfSize = hash.getSize() / 2.0f;
-
-				PlanetPatch* children = (PlanetPatch*)malloc(4 * sizeof(PlanetPatch));
-				new (children + 0) PlanetPatch(makePatchHash(po, patchLevel + 1, dim0, dim1), 0, patch);
-				new (children + 1) PlanetPatch(makePatchHash(po, patchLevel + 1, dim0+halfSize, dim1), 1, patch);
-				new (children + 2) PlanetPatch(makePatchHash(po, patchLevel + 1, dim0, dim1+halfSize), 2, patch);
-				new (children + 3) PlanetPatch(makePatchHash(po, patchLevel + 1, dim0+halfSize, dim1+halfSize), 3, patch);
-				patch->m_children = children;
-				m_patchMap.emplace((children+0)->m_hash.m_value, children+0);
-				m_patchMap.emplace((children+1)->m_hash.m_value, children+1);
-				m_patchMap.emplace((children+2)->m_hash.m_value, children+2);
-				m_patchMap.emplace((children+3)->m_hash.m_value, children+3);
+				makeChildren(patch);
+				for (int i = 0; i < 4; ++i)
+					traversal.m_newPatches.push_back(patch->m_children + i); // m_patchMap is not safe to touch from tasks
 			}
 
-			const int c0Visible = patchVisible(v3f_cameraPos_MS, (patch->m_children + 0)->m_hash, currentPatchHashPositions[patchLevel + 1], (patch->m_children + 0)->m_boundingVectors, frustum);
-			const int c1Visible = patchVisible(v3f_cameraPos_MS, (patch->m_children + 1)->m_hash, currentPatchHashPositions[patchLevel + 1], (patch->m_children + 1)->m_boundingVectors, frustum);
-			const int c2Visible = patchVisible(v3f_cameraPos_MS, (patch->m_children + 2)->m_hash, currentPatchHashPositions[patchLevel + 1], (patch->m_children + 2)->m_boundingVectors, frustum);
-			const int c3Visible = patchVisible(v3f_cameraPos_MS, (patch->m_children + 3)->m_hash, currentPatchHashPositions[patchLevel + 1], (patch->m_children + 3)->m_boundingVectors, frustum);
-
 			// Check visibility of children
-			const int childVisibleMask = (c0Visible << 0) | (c1Visible << 1) | (c2Visible << 2) | (c3Visible << 3);
+			const ChildVisibility visibility = testChildrenVisible(view, patch->m_children);
+			traversal.m_moveSlack = std::min(traversal.m_moveSlack, visibility.m_moveSlack);
+			traversal.m_frustumSlack = std::min(traversal.m_frustumSlack, visibility.m_frustumSlack);
+			traversal.m_maxCenterLength = std::max(traversal.m_maxCenterLength, visibility.m_maxCenterLength);
+
+			const int childVisibleMask = visibility.m_visibleMask;
+			const bool c0Visible = (childVisibleMask & 1) != 0;
+			const bool c1Visible = (childVisibleMask & 2) != 0;
+			const bool c2Visible = (childVisibleMask & 4) != 0;
+			const bool c3Visible = (childVisibleMask & 8) != 0;
 
 			if (!parentAlreadyDrawn && patch->m_populated && patch->m_numChildrenPopulated < childVisibleMask)
 			{
-				drawList.push_back(patch); // Draw this until children ready
+				traversal.m_drawList.push_back(patch); // Draw this until children ready
 				// Children are not drawable!
-				if (c0Visible) patchQueue.emplace_back(patch->m_children + 0, true);
-				if (c1Visible) patchQueue.emplace_back(patch->m_children + 1, true);
-				if (c2Visible) patchQueue.emplace_back(patch->m_children + 2, true);
-				if (c3Visible) patchQueue.emplace_back(patch->m_children + 3, true);
+				if (c0Visible) traversal.m_queue.emplace_back(patch->m_children + 0, true);
+				if (c1Visible) traversal.m_queue.emplace_back(patch->m_children + 1, true);
+				if (c2Visible) traversal.m_queue.emplace_back(patch->m_children + 2, true);
+				if (c3Visible) traversal.m_queue.emplace_back(patch->m_children + 3, true);
 			}
 			else
 			{
-				if (c0Visible) patchQueue.emplace_back(patch->m_children + 0, parentAlreadyDrawn);
-				if (c1Visible) patchQueue.emplace_back(patch->m_children + 1, parentAlreadyDrawn);
-				if (c2Visible) patchQueue.emplace_back(patch->m_children + 2, parentAlreadyDrawn);
-				if (c3Visible) patchQueue.emplace_back(patch->m_children + 3, parentAlreadyDrawn);
+				if (c0Visible) traversal.m_queue.emplace_back(patch->m_children + 0, parentAlreadyDrawn);
+				if (c1Visible) traversal.m_queue.emplace_back(patch->m_children + 1, parentAlreadyDrawn);
+				if (c2Visible) traversal.m_queue.emplace_back(patch->m_children + 2, parentAlreadyDrawn);
+				if (c3Visible) traversal.m_queue.emplace_back(patch->m_children + 3, parentAlreadyDrawn);
 
 				if (!patch->m_populated)
-					m_queuedPatches.push_back(patch);
+				{
+					// As a stand-in for whichever visible children are not ready
+					const bool hole = !parentAlreadyDrawn && (patch->m_numChildrenPopulated & childVisibleMask) != childVisibleMask;
+					traversal.m_queuedPatches.emplace_back(patch, view.getGenerationPriority(patch, hole));
+				}
 			}
 		}
 		else // Need this patch drawn
 		{
 			if (patch->m_populated)
 			{
-				m_overlay_lowestPatchLevel = std::min(patchLevel, m_overlay_lowestPatchLevel);
-				m_overlay_highestPatchLevel = std::max(patchLevel, m_overlay_highestPatchLevel);
+				traversal.m_lowestPatchLevel = std::min(patchLevel, traversal.m_lowestPatchLevel);
+				traversal.m_highestPatchLevel = std::max(patchLevel, traversal.m_highestPatchLevel);
 				if (!parentAlreadyDrawn)
-					drawList.push_back(patch);
+					traversal.m_drawList.push_back(patch);
 			}
 			else
 			{
-				m_queuedPatches.push_back(patch);
+				traversal.m_queuedPatches.emplace_back(patch, view.getGenerationPriority(patch, !parentAlreadyDrawn));
 			}
 		}
 	}
-	
-	if (m_queuedPatches.size() > 0 && oldQueueSize == 0)
-		ComputeQueue::get().addClient(this);
-	
-	m_overlay_numPatches = (int)m_patchMap.size();
-	m_overlay_queueSize = (int)m_queuedPatches.size();
 }
 
 
+void Planet::makeChildren(PlanetPatch* patch) const
+{
+	const PatchHash& hash = patch->m_hash;
+
+	PlanetPatch* const children = m_patchPool.allocate();
+	new (children + 0) PlanetPatch(hash.getChild(ChildPosition::DIM0LO_DIM1LO), 0, patch);
+	new (children + 1) PlanetPatch(hash.getChild(ChildPosition::DIM0HI_DIM1LO), 1, patch);
+	new (children + 2) PlanetPatch(hash.getChild(ChildPosition::DIM0LO_DIM1HI), 2, patch);
+	new (children + 3) PlanetPatch(hash.getChild(ChildPosition::DIM0HI_DIM1HI), 3, patch);
+	patch->m_children = children;
+	for (int i = 0; i < 4; ++i)
+		setEstimatedAltitudes(children + i, m_terrainGenerator); // So visibility tests see the terrain's extent
+}
+
+void Planet::reclaimPatches(double time)
+{
+	// A reused walk did not visit its patches, but still splits the same ones
+	for (auto& it : m_subtreeTraversals)
+		if (it.second.m_traversalNumber == m_traversalNumber)
+			for (auto patch : it.second.m_splitPatchesInWalk)
+				patch->m_splitTime = time;
+
+	for (auto root : m_rootPatches)
+		reclaimSubtree(root, time - GLOBALS.m_patchReclaimSeconds);
+}
+
+bool Planet::reclaimSubtree(PlanetPatch* patch, double unusedSince)
+{
+	if (!patch->m_children)
+		return true;
+
+	bool reclaimable = patch->m_splitTime < unusedSince;
+	for (int i = 0; i < 4; ++i)
+	{
+		const PlanetPatch* const child = patch->m_children + i;
+		if (!reclaimSubtree(patch->m_children + i, unusedSince) || child->m_populated || child->m_generating)
+			reclaimable = false;
+	}
+	if (!reclaimable)
+		return false;
+
+	// m_queuedPatches was cleared for this frame's walk, and no walk holds these
+	for (int i = 0; i < 4; ++i)
+	{
+		m_patchMap.erase(patch->m_children[i].m_hash.m_value);
+		patch->m_children[i].~PlanetPatch();
+	}
+	m_patchPool.free(patch->m_children);
+	patch->m_children = nullptr;
+	patch->markChanged();
+
+	++m_overlay_patchBlocksReclaimed;
+	return true;
+}
+
+void Planet::balanceDrawList(const PatchTraversalView& view, std::vector<PlanetPatch*>& drawList)
+{
+	m_drawnPatches.clear();
+	m_drawnAncestors.clear();
+	for (auto patch : drawList)
+	{
+		m_drawnPatches.emplace(patch->m_hash.m_value, patch);
+		for (PlanetPatch* ancestor = patch->m_parent; ancestor; ancestor = ancestor->m_parent)
+			if (!m_drawnAncestors.emplace(ancestor->m_hash.m_value, ancestor).second)
+				break;
+	}
+
+	// A drawn patch is too coarse if, across an edge, a patch a level finer
+	// than it has drawn descendants. Splitting it can make its coarser
+	// neighbours too coarse in turn, so repeat until nothing changes.
+	auto isTooCoarse = [this](const PlanetPatch* patch) {
+		for (int direction = 0; direction < 4; ++direction)
+		{
+			const PatchHash neighbour = patch->m_hash.getNeighbour(MoveDirection(direction));
+			if (m_drawnAncestors.find(neighbour.m_value) == m_drawnAncestors.end())
+				continue;
+
+			for (int i = 0; i < 2; ++i)
+			{
+				const PatchHash child = patch->m_hash.getChild(EDGE_CHILD_POSITIONS[direction][i]);
+				if (m_drawnAncestors.find(child.getNeighbour(MoveDirection(direction)).m_value) != m_drawnAncestors.end())
+					return true;
+			}
+		}
+		return false;
+	};
+
+	m_overlay_balanceSplits = 0;
+
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t drawListIndex = 0; drawListIndex < drawList.size(); ++drawListIndex)
+		{
+			PlanetPatch* const patch = drawList[drawListIndex];
+			if (patch->m_hash.getLevel() >= GLOBALS.m_maxPlanetPatchLevel || !isTooCoarse(patch))
+				continue;
+
+			patch->m_splitTime = view.m_time;
+			if (!patch->m_children)
+			{
+				makeChildren(patch);
+				for (int i = 0; i < 4; ++i)
+					m_patchMap.emplace(patch->m_children[i].m_hash.m_value, patch->m_children + i);
+			}
+
+			// Only the visible children need be ready; until they are, keep drawing this
+			const int visibleMask = testChildrenVisible(view, patch->m_children).m_visibleMask;
+			if (visibleMask == 0)
+				continue;
+
+			if ((patch->m_numChildrenPopulated & visibleMask) != visibleMask)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					PlanetPatch* const child = patch->m_children + i;
+					if ((visibleMask & (1 << i)) && !child->m_populated)
+						m_queuedPatches.push(child, view.getGenerationPriority(child, false)); // Its parent is drawn meanwhile
+				}
+				continue;
+			}
+
+			m_drawnPatches.erase(patch->m_hash.m_value);
+			m_drawnAncestors.emplace(patch->m_hash.m_value, patch);
+
+			bool replaced = false;
+			for (int i = 0; i < 4; ++i)
+			{
+				if (!(visibleMask & (1 << i)))
+					continue;
+
+				PlanetPatch* const child = patch->m_children + i;
+				m_drawnPatches.emplace(child->m_hash.m_value, child);
+				if (replaced)
+					drawList.push_back(child);
+				else
+					drawList[drawListIndex] = child;
+				replaced = true;
+			}
+
+			++m_overlay_balanceSplits;
+			changed = true;
+		}
+	}
+
+	// Stitch each edge to a patch drawn a level coarser; an edge shared with
+	// one drawn finer is stitched from the other side
+	for (auto patch : drawList)
+	{
+		patch->m_coarserEdges = 0;
+		if (patch->m_hash.getLevel() == 0)
+			continue;
+
+		for (int direction = 0; direction < 4; ++direction)
+		{
+			const PatchHash neighbour = patch->m_hash.getNeighbour(MoveDirection(direction));
+			if (m_drawnPatches.find(neighbour.m_value) != m_drawnPatches.end())
+				continue;
+
+			ChildPosition childPosition;
+			if (m_drawnPatches.find(neighbour.getParent(childPosition).m_value) != m_drawnPatches.end())
+				patch->m_coarserEdges |= 1 << direction;
+		}
+	}
+}
+
+// One multi-draw per run of patches in the same page, as each page is its own
+// buffer. Needs the vertex array bound.
+static void drawByPage(const GLsizei* counts, GLvoid* const* indices, const GLint* baseVertexes, const unsigned* pages, unsigned numPatches)
+{
+	for (unsigned first = 0; first < numPatches; )
+	{
+		unsigned end = first + 1;
+		while (end < numPatches && pages[end] == pages[first])
+			++end;
+
+		glBindVertexBuffer(0, PLANET_DATA_BUFFER->getVertexBuffer(pages[first]), 0, PLANET_PATCH_CONSTANTS->m_vertexSizeBytes);
+		if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, PLANET_DATA_BUFFER->getPatchInfoBuffer(pages[first])); // PatchInfos in lib_patch_vertex.glsl
+
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, indices + first, (GLsizei)(end - first), baseVertexes + first);
+		first = end;
+	}
+}
+
 void Planet::drawImmediate(const Scene* scene, const Camera* camera, const std::vector<PlanetPatch*>& drawList)
 {
 	m_overlay_terrainPatchesDrawn = 0;
@@ -507,31 +964,59 @@ void Planet::drawImmediate(const Scene* scene, const Camera* camera, const std::
 	assert(lightSources.size() == 1);
 
 	// Iterate over visible patches and split into terrain and water
-	const GLsizei numIndexes = (GLsizei)(PLANET_PATCH_CONSTANTS->m_allIndexes.size());
+	const GLsizei numIndexes = (GLsizei)(PLANET_PATCH_CONSTANTS->m_indexesPerVariant);
 	const double currentTime = glfwGetTime();
 
 	GLsizei* counts = new GLsizei[drawList.size()];
-	GLvoid** indices = new GLvoid*[drawList.size()];
+	GLvoid** terrainIndices = new GLvoid*[drawList.size()];
+	GLvoid** waterIndices = new GLvoid*[drawList.size()];
 	GLint* terrainBaseVertexes = new GLint[drawList.size()];
 	GLint* waterBaseVertexes = new GLint[drawList.size()];
+	unsigned* terrainPages = new unsigned[drawList.size()];
+	unsigned* waterPages = new unsigned[drawList.size()];
 
 	unsigned numTerrainFound = 0, numWaterFound = 0;
 
-	for (int drawListIndex = 0; drawListIndex < drawList.size(); ++drawListIndex)
+	// Slot IDs order patches by page
+	std::vector<const PlanetPatch*> patchesByPage(drawList.begin(), drawList.end());
+	std::sort(patchesByPage.begin(), patchesByPage.end(), [](const PlanetPatch* a, const PlanetPatch* b) {
+		return a->m_bufferOffset < b->m_bufferOffset;
+	});
+
+	for (int drawListIndex = 0; drawListIndex < patchesByPage.size(); ++drawListIndex)
 	{
-		const PlanetPatch* const patch = drawList[drawListIndex];
+		const PlanetPatch* const patch = patchesByPage[drawListIndex];
+
+		// The index variant that stitches this patch's edges to coarser neighbours
+		GLvoid* const indices = (GLvoid*)(patch->m_coarserEdges * numIndexes * sizeof(GLuint));
+		const unsigned page = PLANET_DATA_BUFFER->getPage(patch->m_bufferOffset);
+		const GLint baseVertex = PLANET_DATA_BUFFER->getSlotInPage(patch->m_bufferOffset) * PLANET_PATCH_CONSTANTS->m_totalVertices;
 
 		if (!m_water || patch->m_numSubmerged < PLANET_PATCH_CONSTANTS->m_visibleVertices) // There is at least some land
-			terrainBaseVertexes[numTerrainFound++] = patch->m_bufferOffset * PLANET_PATCH_CONSTANTS->m_totalVertices;
+		{
+			terrainIndices[numTerrainFound] = indices;
+			terrainPages[numTerrainFound] = page;
+			terrainBaseVertexes[numTerrainFound++] = baseVertex;
+		}
 
 		if (m_water && patch->m_numSubmerged > 0) // There is at least some water
-			waterBaseVertexes[numWaterFound++] = patch->m_bufferOffset * PLANET_PATCH_CONSTANTS->m_totalVertices;
+		{
+			waterIndices[numWaterFound] = indices;
+			waterPages[numWaterFound] = page;
+			waterBaseVertexes[numWaterFound++] = baseVertex;
+		}
 
 		counts[drawListIndex] = numIndexes;
-		indices[drawListIndex] = (GLvoid*)0;
-		PLANET_DATA_BUFFER->m_lastDrawnTimes[patch->m_bufferOffset] = currentTime;
 	}
 
+	PLANET_DATA_BUFFER->m_bufferLock.acquire();
+	for (auto patch : drawList)
+		PLANET_DATA_BUFFER->touch(
+			patch->m_bufferOffset, currentTime,
+			glm::length(m_v3f_cameraPos_MS - patch->m_boundingVectors.m_center) / patch->m_boundingVectors.m_radius
+		);
+	PLANET_DATA_BUFFER->m_bufferLock.release();
+
 	// Update uniforms
 	m_uniforms.m4_terrainMV = glm::scale(m_m4f_zeroPosUnscaledMV, glm::vec3(m_radius));
 	m_uniforms.m4_terrainMVP = camera->getProjectionMatrix() * m_uniforms.m4_terrainMV;
@@ -560,7 +1045,7 @@ void Planet::drawImmediate(const Scene* scene, const Camera* camera, const std::
 
 		glBindVertexArray(m_terrainDrawVertexArray.m_id);
 		glUseProgram(terrainDrawProgram->m_program->m_id);
-		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, indices, (GLsizei)numTerrainFound, terrainBaseVertexes);
+		drawByPage(counts, terrainIndices, terrainBaseVertexes, terrainPages, numTerrainFound);
 	}
 
 	if (numWaterFound > 0) // Set up water program and draw water
@@ -571,14 +1056,17 @@ void Planet::drawImmediate(const Scene* scene, const Camera* camera, const std::
 		glUseProgram(m_water->m_program->m_id);
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, indices, (GLsizei)numWaterFound, waterBaseVertexes);
+		drawByPage(counts, waterIndices, waterBaseVertexes, waterPages, numWaterFound);
 		glDisable(GL_BLEND);
 	}
 
 	delete[] counts;
-	delete[] indices;
+	delete[] terrainIndices;
+	delete[] waterIndices;
 	delete[] terrainBaseVertexes;
 	delete[] waterBaseVertexes;
+	delete[] terrainPages;
+	delete[] waterPages;
 
 	if (m_atmosphereConstants)
 	{
@@ -600,8 +1088,24 @@ void Planet::drawImmediate(const Scene* scene, const Camera* camera, const std::
 
 unsigned Planet::runAllComputeItems()
 {
+	// Everything queued, holes or not; uploads still stop when the buffer is full
+	m_queuedPatches.setBudget(std::numeric_limits<unsigned>::max());
+	m_queuedPatches.setHolesOnly(false);
+
 	bool allRun;
-	return runSomeComputeItems((int)m_queuedPatches.size(), allRun);
+	if (m_terrainGenerator->m_backend != TerrainBackend::CPU)
+		return runSomeComputeItems((int)m_queuedPatches.size(), allRun);
+
+	// Wait for the workers, so that everything queued is uploaded on return
+	unsigned numRun = 0;
+	do
+	{
+		numRun += runSomeComputeItemsCPU((int)m_queuedPatches.size(), allRun);
+		std::this_thread::yield();
+	}
+	while (!allRun);
+
+	return numRun;
 }
 
 static inline float sortableUintToFloat(unsigned sortableUint)
@@ -614,16 +1118,18 @@ unsigned Planet::runSomeComputeItems(int maxNumBatches, bool& allRun)
 {
 	if (maxNumBatches == 0)
 	{
-		allRun = m_queuedPatches.empty();
+		allRun = m_queuedPatches.available() == 0 && m_patchJobsInFlight.empty();
 		return 0;
 	}
 
+	if (m_terrainGenerator->m_backend == TerrainBackend::CPU)
+		return runSomeComputeItemsCPU(maxNumBatches, allRun);
+
 	//printf("Total %d patches\n", m_queuedPatches.size());
 
 	glBindVertexArray(m_terrainGenerator->m_vertexArray.m_id);
 	glUseProgram(m_terrainGenerator->m_program->m_id);
 
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, PLANET_DATA_BUFFER->m_vertexBuffer.m_id);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, PLANET_DATA_BUFFER->m_statsBuffer.m_id);
 
 	std::vector<PlanetPatch*> calculatedPatches;
@@ -636,32 +1142,58 @@ unsigned Planet::runSomeComputeItems(int maxNumBatches, bool& allRun)
 
 	unsigned statsOffset = 0;
 
-	assert(PLANET_DATA_BUFFER->m_bufferSizePatches <= 2097152); // So the offset fits in 21 bits
+	assert(PLANET_DATA_BUFFER->m_pageSizePatches <= 2097152); // So the slot in its page fits in 21 bits
 	assert(PLANET_DATA_BUFFER->m_statsBufferSizePatches <= 256); // So the offset fits in 8 bits
 
 	// Iterate over batches
 	int batchNumber = 0;
-	for ( ; !m_queuedPatches.empty() && batchNumber < maxNumBatches; ++batchNumber)
+	for ( ; m_queuedPatches.available() > 0 && PLANET_DATA_BUFFER->numFreePatches() > 0 && batchNumber < maxNumBatches; ++batchNumber)
 	{
+		// Each batch writes into one page
+		const int page = PLANET_DATA_BUFFER->findPageWithRoom();
+		if (page < 0)
+			break;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, PLANET_DATA_BUFFER->getVertexBuffer(page));
+		if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, PLANET_DATA_BUFFER->getPatchInfoBuffer(page)); // PatchInfos in lib_patch_vertex.glsl
+
 		// Run one batch
 		std::vector<glm::vec4> patchDetails;
 		
-		for (unsigned patchNumber = 0; !m_queuedPatches.empty() && patchNumber < PLANET_PATCH_CONSTANTS->m_patchesPerBatch; ++patchNumber)
+		for (unsigned patchNumber = 0; m_queuedPatches.available() > 0 && PLANET_DATA_BUFFER->hasRoom(page) && patchNumber < PLANET_PATCH_CONSTANTS->m_patchesPerBatch; ++patchNumber)
 		{
-			PlanetPatch* const patch = m_queuedPatches.front();
-			m_queuedPatches.pop_front();
+			PlanetPatch* const patch = m_queuedPatches.pop();
+
+			PLANET_DATA_BUFFER->m_bufferLock.acquire(); // The cleanup thread reads the slots' bookkeeping
+			const GLint offset = PLANET_DATA_BUFFER->getOffset(patch, this, page);
+			if (offset >= 0)
+			{
+				patch->m_populated = true;
+				patch->m_bufferOffset = offset;
+				if (patch->m_parent)
+					patch->m_parent->m_numChildrenPopulated |= (1 << patch->m_childNumber);
+				patch->markChanged();
+			}
+			PLANET_DATA_BUFFER->m_bufferLock.release();
 
-			patch->m_populated = true;
-			patch->m_bufferOffset = PLANET_DATA_BUFFER->getOffset(patch, this);
+			if (offset < 0) // Not expected after hasRoom(); queued again while wanted
+				break;
 
-			if (patch->m_parent)
-				patch->m_parent->m_numChildrenPopulated |= (1 << patch->m_childNumber);
+			if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+			{
+				float minAltitude, maxAltitude;
+				m_terrainGenerator->getQuantisationRange(patch->m_hash, minAltitude, maxAltitude);
+				PLANET_DATA_BUFFER->setPatchInfo(
+					patch->m_bufferOffset, patch->m_hash, minAltitude, maxAltitude, m_terrainGenerator->getAltitudeScale()
+				);
+			}
 
 			const float stepSize = patch->m_hash.getSize() / PLANET_PATCH_CONSTANTS->m_visiblePolygons;
 			const unsigned orientationAndOffsetInt = 
 				((unsigned)(patch->m_hash.getOrientation()) << 29) | 
 				((statsOffset++) << 21) | 
-				patch->m_bufferOffset
+				PLANET_DATA_BUFFER->getSlotInPage(patch->m_bufferOffset)
 			;
 
 			patchDetails.emplace_back(
@@ -674,12 +1206,15 @@ unsigned Planet::runSomeComputeItems(int maxNumBatches, bool& allRun)
 		}
 		
 		// Now we have all the details to run this batch; set uniforms and run.
-		glUniform4fv(m_terrainGenerator->m_locId_patchDetails, (GLsizei)patchDetails.size(), &patchDetails[0].x);
-		glDispatchCompute((GLuint)patchDetails.size(), 1, 1);
+		if (!patchDetails.empty()) // Unless no slot was allocated
+		{
+			glUniform4fv(m_terrainGenerator->m_locId_patchDetails, (GLsizei)patchDetails.size(), &patchDetails[0].x);
+			glDispatchCompute((GLuint)patchDetails.size(), 1, 1);
+		}
 		
 		const unsigned numPatchesInNextBatch = 
 			(batchNumber >= maxNumBatches - 1) ? 0 :
-			std::min((unsigned)m_queuedPatches.size(), PLANET_PATCH_CONSTANTS->m_patchesPerBatch)
+			std::min(m_queuedPatches.available(), PLANET_PATCH_CONSTANTS->m_patchesPerBatch)
 		;
 		const unsigned spaceLeftInStatsBuffer = PLANET_DATA_BUFFER->m_statsBufferSizePatches - statsOffset;
 
@@ -697,6 +1232,8 @@ unsigned Planet::runSomeComputeItems(int maxNumBatches, bool& allRun)
 					sortableUintToFloat(PLANET_DATA_BUFFER->m_statsDataClientBuffer[i].y)
 				);
 				calculatedPatches[i]->m_numSubmerged = PLANET_DATA_BUFFER->m_statsDataClientBuffer[i].z;
+				calculatedPatches[i]->propagateGeometricError();
+				calculatedPatches[i]->markChanged();
 			}
 
 			if (numPatchesInNextBatch > 0)
@@ -708,22 +1245,147 @@ unsigned Planet::runSomeComputeItems(int maxNumBatches, bool& allRun)
 		}
 	}
 
-	PLANET_DATA_BUFFER->m_bufferLock.release();
-	
-	allRun = m_queuedPatches.empty();
+	allRun = m_queuedPatches.available() == 0; // The rest wait for next frame's budget, or for room
 	return (unsigned)batchNumber;
 }
 
+unsigned Planet::runSomeComputeItemsCPU(int maxNumPatches, bool& allRun)
+{
+	// Only keep a few jobs per worker in flight, so that patches which stop
+	// being needed don't hold up those queued in later frames.
+	const unsigned maxPatchJobsInFlight = 4 * PATCH_WORKER_POOL->numWorkers();
+
+	int patchNumber = 0;
+	while (m_queuedPatches.available() > 0 && patchNumber < maxNumPatches && m_patchJobsInFlight.size() < maxPatchJobsInFlight)
+	{
+		PlanetPatch* const patch = m_queuedPatches.pop();
+
+		PatchJob* job;
+		if (m_freePatchJobs.empty())
+		{
+			job = new PatchJob();
+		}
+		else
+		{
+			job = m_freePatchJobs.back();
+			m_freePatchJobs.pop_back();
+		}
+
+		job->m_patch = patch;
+		job->m_generator = m_terrainGenerator;
+		job->m_tileCache = m_tileCache;
+		job->m_completionQueue = &m_completedPatchJobs;
+		job->m_cancelled.store(false, std::memory_order_relaxed);
+
+		patch->m_generating = true;
+		m_patchJobsInFlight.push_back(job);
+		++patchNumber;
+
+		PATCH_WORKER_POOL->submit(job);
+	}
+
+	const unsigned numUploaded = uploadCompletedPatchJobs();
+
+	// Until every job is uploaded too, or finished ones would wait for something new to be queued
+	allRun = m_queuedPatches.available() == 0 && m_patchJobsInFlight.empty() && m_completedPatchJobs.empty();
+	return numUploaded;
+}
+
+unsigned Planet::uploadCompletedPatchJobs()
+{
+	PatchJob* job = m_completedPatchJobs.popAll();
+	if (!job)
+		return 0;
+
+	unsigned numUploaded = 0;
+	while (job)
+	{
+		job->m_patch->m_generating = false;
+		if (!job->m_skipped)
+		{
+			const bool uploaded = uploadPatch(job->m_patch, job->m_stats, &job->m_vertices[0]);
+			if (uploaded)
+				++numUploaded; // Else the buffer is full, and it is queued again while wanted
+
+			if (job->m_fromTileCache)
+				m_overlay_tileCacheHits += uploaded;
+			else if (m_tileCache)
+				m_tileCache->store(job->m_patch->m_hash, job->m_stats, &job->m_vertices[0]);
+		}
+
+		PatchJob* const next = job->m_next;
+		m_freePatchJobs.push_back(job);
+		m_patchJobsInFlight.erase(std::find(m_patchJobsInFlight.begin(), m_patchJobsInFlight.end(), job));
+		job = next;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	m_overlay_patchJobsInFlight = (int)m_patchJobsInFlight.size();
+	return numUploaded;
+}
+
+// Takes the buffer lock only to allocate the slot. Leaves its page's vertex
+// buffer bound to GL_COPY_WRITE_BUFFER.
+bool Planet::uploadPatch(PlanetPatch* patch, const PatchStats& stats, const void* vertices)
+{
+	const int page = PLANET_DATA_BUFFER->findPageWithRoom(); // May make a page resident, so outside the lock
+	if (page < 0)
+		return false;
+
+	PLANET_DATA_BUFFER->m_bufferLock.acquire(); // The cleanup thread reads the slots' bookkeeping
+	const GLint offset = PLANET_DATA_BUFFER->getOffset(patch, this, (unsigned)page);
+	PLANET_DATA_BUFFER->m_bufferLock.release();
+	if (offset < 0)
+		return false;
+
+	// Evictions only happen on this thread, so the slot stays ours unlocked
+	patch->m_populated = true;
+	patch->m_bufferOffset = offset;
+	patch->setAltitudes(stats.m_minAltitude, stats.m_maxAltitude);
+	patch->m_numSubmerged = stats.m_numSubmerged;
+
+	// CPU patches are quantised over their exact altitude range
+	if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+	{
+		PLANET_DATA_BUFFER->setPatchInfo(
+			patch->m_bufferOffset, patch->m_hash, stats.m_minAltitude, stats.m_maxAltitude, m_terrainGenerator->getAltitudeScale()
+		);
+	}
+
+	if (patch->m_parent)
+		patch->m_parent->m_numChildrenPopulated |= (1 << patch->m_childNumber);
+	patch->propagateGeometricError();
+	patch->markChanged();
+
+	// GL_COPY_WRITE_BUFFER leaves the compute path's GL_ARRAY_BUFFER binding alone
+	glBindBuffer(GL_COPY_WRITE_BUFFER, PLANET_DATA_BUFFER->getVertexBuffer(PLANET_DATA_BUFFER->getPage(offset)));
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER, 
+		(GLintptr)PLANET_DATA_BUFFER->getSlotInPage(offset) * PLANET_PATCH_CONSTANTS->m_totalSizeBytes, 
+		PLANET_PATCH_CONSTANTS->m_totalSizeBytes, 
+		vertices
+	);
+	return true;
+}
+
 Planet* Planet::buildFromXMLNode(XMLNode& node)
 {
 	XMLChildFinder finder(node);
 
 	const float radius = finder.required<float>("Radius", buildFloatFromXMLNode);
+	TerrainGenerator* const terrainGenerator = finder.required<TerrainGenerator*>("PatchGenerator", TerrainGenerator::buildFromXMLNode);
+	PatchTileCache* const tileCache = finder.optional("TileCache", PatchTileCache::buildFromXMLNode);
+
+	// Only CPU-generated patches are in memory to store
+	if (tileCache && terrainGenerator->m_backend != TerrainBackend::CPU)
+		raiseXMLException(node, "TileCache needs a PatchGenerator with the CPU Backend");
 
 	return new Planet(
 		finder.required<std::string>("Name", buildStringFromXMLNode), 
 		radius,
-		finder.required<TerrainGenerator*>("PatchGenerator", TerrainGenerator::buildFromXMLNode), 
+		terrainGenerator, 
+		tileCache, 
 		addRadiusToConstants(
 			finder.optional("Atmosphere", AtmosphereConstants::buildFromXMLNode), 
 			radius
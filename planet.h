@@ -3,6 +3,7 @@
 #include <vector>
 #include <hash_map>
 #include <algorithm>
+#include <limits>
 
 #include "shapes.h"
 #include "planet_patch.h"
@@ -13,8 +14,66 @@
 #include "position.h"
 #include "xml.h"
 #include "compute_queue.h"
+#include "patch_worker_pool.h"
+#include "patch_generation_queue.h"
+#include "patch_pool.h"
+#include "patch_tile_cache.h"
 
 class Camera;
+struct PatchTraversalView;
+
+// What a walk over part of the patch quadtree found. Kept between frames,
+// so that the vectors keep their capacity and a subtree's walk can be reused
+// while nothing it depended on has changed enough to alter it.
+struct PatchTraversal
+{
+	std::vector<std::pair<PlanetPatch*, bool>> m_queue; // Patch, and whether an ancestor is drawn in its place
+	std::vector<std::pair<PlanetPatch*, bool>> m_splitPatches; // Reached the split level; left for other tasks
+	std::vector<PlanetPatch*> m_drawList;
+	std::vector<std::pair<PlanetPatch*, PatchPriority>> m_queuedPatches;
+	std::vector<PlanetPatch*> m_newPatches; // Children made during the walk, still to be added to m_patchMap
+	std::vector<PlanetPatch*> m_splitPatchesInWalk; // Walked down to their children; see Planet::reclaimPatches
+	int m_patchesTraversed;
+	int m_lowestPatchLevel;
+	int m_highestPatchLevel;
+
+	// What the walk saw, and how far from that any of its decisions was
+	glm::vec3 m_cameraPos_MS;
+	glm::vec4 m_frustumPlanes[6];
+	float m_level1Distance;
+	bool m_screenSpaceErrorLod;
+	float m_errorSplitScale;
+	int m_maxPatchLevel;
+	bool m_rootParentDrawn;
+	float m_moveSlack;       // Camera movement that could change a decision
+	float m_frustumSlack;    // Change of a frustum plane's value at a patch centre that could
+	float m_maxCenterLength; // Of the patches tested against the frustum
+	unsigned m_traversalNumber; // Planet::m_traversalNumber when last used
+
+	PatchTraversal() :
+		m_patchesTraversed(0), m_lowestPatchLevel(10000), m_highestPatchLevel(-1),
+		m_moveSlack(0.0f), m_frustumSlack(0.0f), m_maxCenterLength(0.0f), m_traversalNumber(0)
+	{}
+
+	inline void reset()
+	{
+		m_queue.clear();
+		m_splitPatches.clear();
+		m_drawList.clear();
+		m_queuedPatches.clear();
+		m_newPatches.clear();
+		m_splitPatchesInWalk.clear();
+		m_patchesTraversed = 0;
+		m_lowestPatchLevel = 10000;
+		m_highestPatchLevel = -1;
+		m_moveSlack = std::numeric_limits<float>::max();
+		m_frustumSlack = std::numeric_limits<float>::max();
+		m_maxCenterLength = 0.0f;
+	}
+};
+
+// Walks of the subtrees below the split level, by root patch hash
+typedef std::hash_map<uint64_t, PatchTraversal, PlanetPatchHashFunc> PatchTraversalMap;
 
 class Planet : public Shape, public ComputeClient
 {
@@ -26,19 +85,44 @@ class Planet : public Shape, public ComputeClient
 	AtmosphereConstants* const m_atmosphereConstants;
 	TwBar* const m_overlay_bar;
 
-	// All the patches for the terrain
+	// All the patches for the terrain. Below the roots they come in fours from m_patchPool.
 	const std::vector<PlanetPatch*> m_rootPatches;
 	PlanetPatchMap m_patchMap;
+	mutable PatchPool m_patchPool; // Thread safe, for makeChildren
+	double m_lastReclaimTime;
+
+	// Quadtree walk of populateDrawLists: serial above the split level, then
+	// one task per subtree, each reused while still valid
+	PatchTraversal m_topTraversal;
+	PatchTraversalMap m_subtreeTraversals;
+	std::vector<PatchTraversal*> m_splitTraversals; // In m_topTraversal.m_splitPatches order
+	std::vector<unsigned> m_staleSplits;            // Indexes of those to walk again
+	unsigned m_traversalNumber;
+
+	// This frame's drawn patches, and every patch with drawn descendants; see balanceDrawList
+	PlanetPatchMap m_drawnPatches;
+	PlanetPatchMap m_drawnAncestors;
 
 	Water* const m_water;
 
+	// Nothing drawn lies within this radius, so patches it hides from the
+	// camera are culled: the terrain generator's lower bound, raised to sea
+	// level if there is water. 0 if neither is known.
+	float m_occluderRadius;
+
 	// Patches waiting for calculation
-	std::deque<PlanetPatch*> m_queuedPatches;
+	PatchGenerationQueue m_queuedPatches;
+
+	// CPU backend: patches being generated by PATCH_WORKER_POOL
+	PatchCompletionQueue m_completedPatchJobs;
+	std::vector<PatchJob*> m_freePatchJobs;
+	std::vector<PatchJob*> m_patchJobsInFlight; // Cancelled once their patch is no longer queued
 
 	// Time-specific variables
 	glm::dmat4 m_m4d_absTerrainM; // Scaled
 	glm::mat4 m_m4f_zeroPosUnscaledMV;
 	glm::vec3 m_v3f_planetPos_VS;
+	glm::vec3 m_v3f_cameraPos_MS; // As of the last populateDrawLists
 
 	// Buffers etc
 	VertexArray m_terrainDrawVertexArray;
@@ -57,12 +141,21 @@ class Planet : public Shape, public ComputeClient
 	SkyDrawProgram* const m_skyInAtmProgram; // Null if no atmosphere
 	SkyDrawProgram* const m_skyOutAtmProgram; // Null if no atmosphere
 	TerrainGenerator* const m_terrainGenerator;
+	PatchTileCache* const m_tileCache; // Null if not configured
 
 	// AntTweakBar parameters for terrain
 	int m_overlay_patchesTraversed;
 	int m_overlay_patchesDiscarded;
+	int m_overlay_subtreesReused;
+	int m_overlay_balanceSplits;
 	int m_overlay_numPatches;
 	int m_overlay_queueSize;
+	int m_overlay_patchJobsInFlight;
+	int m_overlay_patchJobsCancelled;
+	int m_overlay_patchBlocksInUse;
+	int m_overlay_patchBlocksReclaimed;
+	float m_overlay_patchPoolMB;
+	int m_overlay_tileCacheHits;
 	int m_overlay_terrainPatchesDrawn;
 	int m_overlay_waterPatchesDrawn;
 	int m_overlay_lowestPatchLevel;
@@ -71,11 +164,14 @@ class Planet : public Shape, public ComputeClient
 	float m_overlay_groundAltitude;
 	
 	void drawImmediate(const Scene* scene, const Camera* camera, const std::vector<PlanetPatch*>& drawList);
+	unsigned runSomeComputeItemsCPU(int maxNumPatches, bool& allRun);
+	unsigned uploadCompletedPatchJobs();
+	bool uploadPatch(PlanetPatch* patch, const PatchStats& stats, const void* vertices); // False if the buffer is full
 	
 	Planet(
 		const std::string& name, 
 		float radius, TerrainGenerator* terrainGenerator, 
-		AtmosphereConstants* atmosphereConstants,
+		PatchTileCache* tileCache, AtmosphereConstants* atmosphereConstants,
 		Water* water, Position* position
 	);
 	~Planet();
@@ -85,15 +181,37 @@ class Planet : public Shape, public ComputeClient
 
 	FloatPair getMinMaxDrawDist() const override;
 
-	void draw(const Scene* scene, const Camera* camera) override;
-
-	inline void notifyPatchDelete(PlanetPatch* patch)
+	// Relative cost of generating an evicted patch again, for the buffer's eviction policy
+	inline float getRegenerationCost() const
 	{
-		m_patchMap.erase(patch->m_hash.m_value);
+		const float cost = m_terrainGenerator->m_backend == TerrainBackend::CPU ? 4.0f : 1.0f;
+		return m_tileCache ? 0.5f * cost : cost; // Most would be read back from the cache
 	}
 
+	void draw(const Scene* scene, const Camera* camera) override;
+
 	void populateDrawLists(const Scene* scene, const Camera* camera, std::vector<PlanetPatch*>& drawList);
 
+	// Breadth-first from traversal.m_queue. Patches of splitLevel or finer are
+	// moved to m_splitPatches unvisited. Safe to run on several threads at
+	// once for disjoint subtrees.
+	void traversePatches(const PatchTraversalView& view, int splitLevel, PatchTraversal& traversal) const;
+
+	// Sets patch->m_children to four new patches, which the caller must add to m_patchMap
+	void makeChildren(PlanetPatch* patch) const;
+
+	// Frees the children of patches that no walk has split for
+	// GLOBALS.m_patchReclaimSeconds, bottom up, once nothing refers to them:
+	// not populated, being generated, queued or with children of their own.
+	// Between walks only.
+	void reclaimPatches(double time);
+	bool reclaimSubtree(PlanetPatch* patch, double unusedSince); // True if patch is left childless
+
+	// Splits drawn patches until no two that share an edge are drawn more than
+	// a level apart, queueing children that are needed first, then sets each
+	// drawn patch's m_coarserEdges.
+	void balanceDrawList(const PatchTraversalView& view, std::vector<PlanetPatch*>& drawList);
+
 	// ComputeClient implementations
 	unsigned runAllComputeItems() override;
 	unsigned runSomeComputeItems(int count, bool& allRun) override;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <atomic>
 
@@ -7,21 +8,41 @@
 #include "planet.h"
 #include "utils.h"
 
+// One list per combination of edges that border a patch a level coarser,
+// numbered by bit (1 << MoveDirection) of each such edge. Along those edges
+// each odd vertex is moved onto the even one before it, so the edge follows
+// the coarser patch's exactly; the triangles this collapses are kept, so
+// every list is the same length. visiblePolygons is even.
 static std::vector<GLuint> makeAllIndexes(GLuint visiblePolygons, GLuint verticesPerSide)
 {
 	std::vector<GLuint> indexes;
 
-	for (unsigned yIndex = 0; yIndex < visiblePolygons; ++yIndex)
+	for (unsigned coarserEdges = 0; coarserEdges < 16; ++coarserEdges)
 	{
-		for (unsigned xIndex = 0; xIndex < visiblePolygons; ++xIndex)
+		auto getIndex = [&](unsigned xIndex, unsigned yIndex) -> GLuint {
+			const bool dim0Lo = xIndex == 0 && (coarserEdges & (1 << (int)MoveDirection::DIM0_NEGATIVE));
+			const bool dim0Hi = xIndex == visiblePolygons && (coarserEdges & (1 << (int)MoveDirection::DIM0_POSITIVE));
+			const bool dim1Lo = yIndex == 0 && (coarserEdges & (1 << (int)MoveDirection::DIM1_NEGATIVE));
+			const bool dim1Hi = yIndex == visiblePolygons && (coarserEdges & (1 << (int)MoveDirection::DIM1_POSITIVE));
+
+			if (dim0Lo || dim0Hi)
+				yIndex &= ~1u;
+			if (dim1Lo || dim1Hi)
+				xIndex &= ~1u;
+			return yIndex*verticesPerSide + xIndex;
+		};
+
+		for (unsigned yIndex = 0; yIndex < visiblePolygons; ++yIndex)
 		{
-			const GLuint startIndex = yIndex*verticesPerSide + xIndex;
-			indexes.push_back(startIndex);
-			indexes.push_back(startIndex + 1);
-			indexes.push_back(startIndex + verticesPerSide);
-			indexes.push_back(startIndex + verticesPerSide);
-			indexes.push_back(startIndex + 1);
-			indexes.push_back(startIndex + verticesPerSide + 1);
+			for (unsigned xIndex = 0; xIndex < visiblePolygons; ++xIndex)
+			{
+				indexes.push_back(getIndex(xIndex, yIndex));
+				indexes.push_back(getIndex(xIndex + 1, yIndex));
+				indexes.push_back(getIndex(xIndex, yIndex + 1));
+				indexes.push_back(getIndex(xIndex, yIndex + 1));
+				indexes.push_back(getIndex(xIndex + 1, yIndex));
+				indexes.push_back(getIndex(xIndex + 1, yIndex + 1));
+			}
 		}
 	}
 	
@@ -46,13 +67,16 @@ void* getStatsZeroData(unsigned bufferSizePatches)
 	return (void*)statsZeroData;
 }
 
-PlanetPatchConstants::PlanetPatchConstants(unsigned visiblePolygons, unsigned patchesPerBatch) :
+PlanetPatchConstants::PlanetPatchConstants(unsigned visiblePolygons, unsigned patchesPerBatch, bool compactVertices) :
 	m_visiblePolygons(visiblePolygons),
 	m_verticesPerSide(m_visiblePolygons + 1),
 	m_visibleVertices(m_verticesPerSide * m_verticesPerSide),
 	m_totalVertices(m_verticesPerSide * m_verticesPerSide),
-	m_totalSizeBytes(m_totalVertices * sizeof(PatchVertexData)),
+	m_compactVertices(compactVertices),
+	m_vertexSizeBytes(compactVertices ? sizeof(CompactPatchVertexData) : sizeof(PatchVertexData)),
+	m_totalSizeBytes(m_totalVertices * m_vertexSizeBytes),
 	m_patchesPerBatch(patchesPerBatch),
+	m_indexesPerVariant(6 * m_visiblePolygons * m_visiblePolygons),
 	m_allIndexes(makeAllIndexes(m_visiblePolygons, m_verticesPerSide))
 {
 }
@@ -62,6 +86,11 @@ void TW_CALL antGetBufferSizeMB(void* value, void* clientData)
 	*(float*)value = PLANET_DATA_BUFFER->m_bufferSizeBytes / 1048576.0f; 
 }
 
+void TW_CALL antGetResidentSizeMB(void* value, void* clientData) 
+{ 
+	*(float*)value = (float)PLANET_DATA_BUFFER->numResidentPages() * PLANET_DATA_BUFFER->m_pageSizeBytes / 1048576.0f; 
+}
+
 void TW_CALL antGetGPUPatches(void* value, void* clientData) 
 { 
 	*(unsigned*)value = PLANET_DATA_BUFFER->numAllocatedPatches(); 
@@ -72,23 +101,47 @@ void TW_CALL antGetPercentFull(void* value, void* clientData)
 	*(float*)value = 100.0f * PLANET_DATA_BUFFER->numAllocatedPatches() / PLANET_DATA_BUFFER->m_bufferSizePatches; 
 }
 
-PlanetDataBuffer::PlanetDataBuffer(GLuint bufferSizeBytes, unsigned statsBufferSizePatches) :
-	m_bufferSizeBytes(bufferSizeBytes),
-	m_bufferSizePatches(bufferSizeBytes / PLANET_PATCH_CONSTANTS->m_totalSizeBytes),
+// The most slots, as a power of two, that fit in pageSizeBytes; at least one
+static unsigned getPageShift(GLuint pageSizeBytes)
+{
+	unsigned shift = 0;
+	while (shift < 21 && ((size_t)2 << shift) * PLANET_PATCH_CONSTANTS->m_totalSizeBytes <= pageSizeBytes) // terrain_cs.glsl's offsets are 21 bits
+		++shift;
+	return shift;
+}
+
+PlanetDataBuffer::PlanetDataBuffer(size_t maxSizeBytes, GLuint pageSizeBytes, unsigned statsBufferSizePatches) :
+	m_pageShift(getPageShift(pageSizeBytes)),
+	m_pageSizePatches(1u << m_pageShift),
+	m_pageSizeBytes(m_pageSizePatches * PLANET_PATCH_CONSTANTS->m_totalSizeBytes),
+	m_maxPages(std::max<unsigned>((unsigned)(maxSizeBytes / m_pageSizeBytes), 1)),
+	m_bufferSizeBytes((size_t)m_maxPages * m_pageSizeBytes),
+	m_bufferSizePatches(m_maxPages * m_pageSizePatches),
 	m_patchPointers(new PlanetPatch*[m_bufferSizePatches]),
-	m_ownerPointers(new Planet*[m_bufferSizePatches]),
+	m_patchLevels(new unsigned char[m_bufferSizePatches]),
+	m_regenerationCosts(new float[m_bufferSizePatches]),
 	m_lastDrawnTimes(new double[m_bufferSizePatches]),
+	m_lastDrawnDistances(new float[m_bufferSizePatches]),
+	m_lruPrev(new GLint[m_bufferSizePatches]),
+	m_lruNext(new GLint[m_bufferSizePatches]),
+	m_lruHead(-1),
+	m_lruTail(-1),
+	m_numEvicted(0),
+	m_numEvictionsDeferred(0),
+	m_numBudgetEvictions(0),
+	m_evictionsPerSecond(0.0f),
 	m_statsBufferSizePatches(statsBufferSizePatches),
 	m_statsBufferSizeBytes(m_statsBufferSizePatches * sizeof(glm::uvec4)),
 	m_statsDataClientBuffer(new glm::uvec4[m_statsBufferSizePatches]),
-	m_statsZeroData(getStatsZeroData(m_statsBufferSizePatches))
+	m_statsZeroData(getStatsZeroData(m_statsBufferSizePatches)),
+	m_numResidentPages(0)
 {
 	m_bufferLock.acquire();
 
-	// Create vertex storage
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer.m_id);
-	glBufferData(GL_ARRAY_BUFFER, m_bufferSizeBytes, 0, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Create vertex storage; pages are made resident as needed
+	for (unsigned page = 0; page < m_maxPages; ++page)
+		m_pages.push_back(new Page(m_pageSizePatches));
+	m_numAllocatedPatches = 0;
 
 	// Create stats storage
 	glBindBuffer(GL_ARRAY_BUFFER, m_statsBuffer.m_id);
@@ -104,29 +157,32 @@ PlanetDataBuffer::PlanetDataBuffer(GLuint bufferSizeBytes, unsigned statsBufferS
 		GL_STATIC_DRAW
 	);
 
-	// Create offset stack (starts at the highest)
-	std::vector<GLint> v;
-	for (int i = 0; i < (int)m_bufferSizePatches; ++i)
-		v.push_back(i);
-	for (std::vector<GLint>::const_reverse_iterator it = v.rbegin(); it != v.rend(); ++it)
-		m_offsetStack.push(*it);
-
 	// Create cleanup arrays
 	for (int i = 0; i < (int)m_bufferSizePatches; ++i)
 	{
 		m_patchPointers[i] = nullptr;
-		m_ownerPointers[i] = nullptr;
+		m_patchLevels[i] = 0;
+		m_regenerationCosts[i] = 0.0f;
 		m_lastDrawnTimes[i] = std::numeric_limits<double>::max();
+		m_lastDrawnDistances[i] = 0.0f;
 	}
 
 	// Make overlay bar (for constants too)
 	TwAddVarRO(GLOBALS.m_overlay_bar, "Visible Polygons", TW_TYPE_UINT32, &PLANET_PATCH_CONSTANTS->m_visiblePolygons, " group=PatchConstants ");
 	TwAddVarRO(GLOBALS.m_overlay_bar, "Total Verts", TW_TYPE_UINT32, &PLANET_PATCH_CONSTANTS->m_totalVertices, " group=PatchConstants ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Vertex Bytes", TW_TYPE_UINT32, &PLANET_PATCH_CONSTANTS->m_vertexSizeBytes, " group=PatchConstants ");
 	TwAddVarRO(GLOBALS.m_overlay_bar, "Byte Size", TW_TYPE_UINT32, &PLANET_PATCH_CONSTANTS->m_totalSizeBytes, " group=PatchConstants ");
-	TwAddVarCB(GLOBALS.m_overlay_bar, "Total MB Size", TW_TYPE_FLOAT, 0, antGetBufferSizeMB, 0, " group=PlanetBuffer ");
+	TwAddVarCB(GLOBALS.m_overlay_bar, "Max MB Size", TW_TYPE_FLOAT, 0, antGetBufferSizeMB, 0, " group=PlanetBuffer ");
+	TwAddVarCB(GLOBALS.m_overlay_bar, "Resident MB", TW_TYPE_FLOAT, 0, antGetResidentSizeMB, 0, " group=PlanetBuffer ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Resident Pages", TW_TYPE_UINT32, &m_numResidentPages, " group=PlanetBuffer ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Patches Per Page", TW_TYPE_UINT32, &m_pageSizePatches, " group=PlanetBuffer ");
 	TwAddVarRO(GLOBALS.m_overlay_bar, "Patch Capacity", TW_TYPE_UINT32, &m_bufferSizePatches, " group=PlanetBuffer ");
 	TwAddVarCB(GLOBALS.m_overlay_bar, "Curr Num Patches", TW_TYPE_UINT32, 0, antGetGPUPatches, 0, " group=PlanetBuffer ");
 	TwAddVarCB(GLOBALS.m_overlay_bar, "% Full", TW_TYPE_FLOAT, 0, antGetPercentFull, 0, " group=PlanetBuffer ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Evictions/Sec", TW_TYPE_FLOAT, &m_evictionsPerSecond, " group=PlanetBuffer ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Total Evicted", TW_TYPE_UINT32, &m_numEvicted, " group=PlanetBuffer ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Evictions Deferred", TW_TYPE_UINT32, &m_numEvictionsDeferred, " group=PlanetBuffer ");
+	TwAddVarRO(GLOBALS.m_overlay_bar, "Budget Evictions", TW_TYPE_UINT32, &m_numBudgetEvictions, " group=PlanetBuffer ");
 
 	// Make cleanup thread
 	m_cleanupThread = new std::thread(cleanupPatches);
@@ -136,46 +192,275 @@ PlanetDataBuffer::PlanetDataBuffer(GLuint bufferSizeBytes, unsigned statsBufferS
 
 PlanetDataBuffer::~PlanetDataBuffer()
 {
+	for (auto page : m_pages)
+	{
+		delete page->m_vertexBuffer;
+		delete page->m_patchInfoBuffer;
+		delete page;
+	}
 	delete[] m_patchPointers;
-	delete[] m_ownerPointers;
+	delete[] m_patchLevels;
+	delete[] m_regenerationCosts;
 	delete[] m_lastDrawnTimes;
+	delete[] m_lastDrawnDistances;
+	delete[] m_lruPrev;
+	delete[] m_lruNext;
 	delete[] m_statsDataClientBuffer;
 }
 
-void cleanupPatchesSingleFrame()
+int PlanetDataBuffer::findPageWithRoom()
 {
-	PlanetPatch** const patches = PLANET_DATA_BUFFER->m_patchPointers;
-	Planet** const owners = PLANET_DATA_BUFFER->m_ownerPointers;
-	double* const times = PLANET_DATA_BUFFER->m_lastDrawnTimes;
+	int firstAbsent = -1;
+	for (unsigned page = 0; page < m_maxPages; ++page)
+	{
+		if (!m_pages[page]->m_vertexBuffer)
+		{
+			if (firstAbsent < 0)
+				firstAbsent = (int)page;
+		}
+		else if (hasRoom(page))
+		{
+			return (int)page;
+		}
+	}
+
+	if (firstAbsent >= 0)
+		makePageResident((unsigned)firstAbsent);
+	return firstAbsent;
+}
 
-	const double oldTime = glfwGetTime() - 5.0; // Num seconds - should make this dynamic
+GLint PlanetDataBuffer::getOffset(PlanetPatch* patch, Planet* owner, unsigned page)
+{
+	const int slot = m_pages[page]->m_slots.allocate();
+	if (slot < 0)
+		return -1;
 
-	PLANET_DATA_BUFFER->m_bufferLock.acquire();
+	const GLint offset = (GLint)((page << m_pageShift) | (unsigned)slot);
+	m_numAllocatedPatches.fetch_add(1, std::memory_order_relaxed);
 
-	for (int i = 0; i < (int)PLANET_DATA_BUFFER->m_bufferSizePatches; ++i)
+	m_patchPointers[offset] = patch;
+	m_patchLevels[offset] = (unsigned char)patch->m_hash.getLevel();
+	m_regenerationCosts[offset] = owner->getRegenerationCost();
+
+	// Counts as just drawn, so it is not evicted before it can be
+	m_lastDrawnTimes[offset] = glfwGetTime();
+	m_lastDrawnDistances[offset] = 0.0f;
+	lruAppend(offset);
+	return offset;
+}
+
+void PlanetDataBuffer::makePageResident(unsigned page)
+{
+	Page* const p = m_pages[page];
+
+	// GL_COPY_READ_BUFFER leaves the callers' bindings alone
+	p->m_vertexBuffer = new VertexBuffer();
+	glBindBuffer(GL_COPY_READ_BUFFER, p->m_vertexBuffer->m_id);
+	glBufferData(GL_COPY_READ_BUFFER, m_pageSizeBytes, 0, GL_DYNAMIC_DRAW);
+
+	// The compute and draw shaders both read it
+	if (PLANET_PATCH_CONSTANTS->m_compactVertices)
+	{
+		p->m_patchInfoBuffer = new VertexBuffer();
+		glBindBuffer(GL_COPY_READ_BUFFER, p->m_patchInfoBuffer->m_id);
+		glBufferData(GL_COPY_READ_BUFFER, m_pageSizePatches * sizeof(PatchInfo), 0, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	++m_numResidentPages;
+}
+
+void PlanetDataBuffer::releaseEmptyPages()
+{
+	bool keptOne = false;
+	for (auto page : m_pages)
 	{
-		PlanetPatch* const patch = patches[i];
+		if (!page->m_vertexBuffer || page->m_slots.numFree() != m_pageSizePatches)
+			continue;
 
-		if (patch && (times[i] < oldTime) && !patch->m_children && !patches[i]->m_numChildrenPopulated)
+		if (!keptOne)
 		{
-			owners[i]->notifyPatchDelete(patch);
-			patch->m_populated = false;
+			keptOne = true;
+			continue;
+		}
+
+		// The driver keeps the storage until draws already made from it are done
+		delete page->m_vertexBuffer;
+		delete page->m_patchInfoBuffer;
+		page->m_vertexBuffer = nullptr;
+		page->m_patchInfoBuffer = nullptr;
+		--m_numResidentPages;
+	}
+}
+
+void PlanetDataBuffer::setPatchInfo(GLint offset, const PatchHash& hash, float minRadius, float maxRadius, float altitudeScale)
+{
+	const float stepSize = hash.getSize() / PLANET_PATCH_CONSTANTS->m_visiblePolygons;
+	const unsigned orientation = (unsigned)hash.getOrientation() << 29;
+
+	PatchInfo info;
+	info.details = glm::vec4(reinterpret_cast<const float&>(orientation), stepSize, hash.getDim0(), hash.getDim1());
+	info.range = glm::vec4(minRadius, (maxRadius - minRadius) / 65535.0f, altitudeScale, 0.0f);
+
+	// GL_COPY_READ_BUFFER leaves the callers' bindings alone
+	glBindBuffer(GL_COPY_READ_BUFFER, getPatchInfoBuffer(getPage(offset)));
+	glBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)getSlotInPage(offset) * sizeof(PatchInfo), sizeof(PatchInfo), &info);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+// A patch standing behind its children can't go before them
+static inline bool isEvictable(const PlanetPatch* patch)
+{
+	return !patch->m_children && !patch->m_numChildrenPopulated;
+}
+
+void PlanetDataBuffer::applyPendingEvictions()
+{
+	m_bufferLock.acquire();
+	if (m_pendingEvictions.empty())
+	{
+		m_bufferLock.release();
+		return;
+	}
+
+	const double currentTime = glfwGetTime();
+
+	unsigned numDeferred = 0;
+	for (auto& eviction : m_pendingEvictions)
+	{
+		// Freed, reused or drawn since it was picked
+		if (m_patchPointers[eviction.m_offset] != eviction.m_patch || m_lastDrawnTimes[eviction.m_offset] != eviction.m_lastDrawnTime)
+			continue;
+
+		PlanetPatch* const patch = eviction.m_patch;
+		if (isEvictable(patch))
+		{
+			patch->m_populated = false; // The node itself stays, until Planet::reclaimPatches
 			if (patch->m_parent)
 				patch->m_parent->m_numChildrenPopulated &= ~(1 << patch->m_childNumber);
-			PLANET_DATA_BUFFER->freeOffset(patch->m_bufferOffset);
-			patches[i] = nullptr; // To avoid repeated deletes
+			patch->markChanged();
+			freeOffset(eviction.m_offset);
+
+			++m_numEvicted;
+			if (eviction.m_overBudget)
+				++m_numBudgetEvictions;
+		}
+		else if (!eviction.m_overBudget)
+		{
+			// Stands behind its children; look again after another period
+			touch(eviction.m_offset, currentTime, m_lastDrawnDistances[eviction.m_offset]);
+			++numDeferred;
 		}
 	}
+	m_numEvictionsDeferred = numDeferred;
+	m_pendingEvictions.clear();
+
+	m_bufferLock.release();
+
+	releaseEmptyPages();
+}
+
+// How much the slot's patch is worth keeping: what it would cost to make
+// again, less the longer since it was drawn, the further it was drawn from,
+// and the finer it is, as fine patches are only wanted close up
+static float getKeepValue(GLint offset, double currentTime)
+{
+	const float age = (float)(currentTime - PLANET_DATA_BUFFER->m_lastDrawnTimes[offset]);
+	const float distance = PLANET_DATA_BUFFER->m_lastDrawnDistances[offset];
+	const float level = (float)PLANET_DATA_BUFFER->m_patchLevels[offset];
+
+	return PLANET_DATA_BUFFER->m_regenerationCosts[offset] / ((1.0f + age) * (1.0f + distance) * (1.0f + level));
+}
 
+// Slots weighed by pickToLowWatermark, per slot it picks. The least recently
+// drawn of those not yet old enough to evict, rather than all of them.
+static const unsigned CANDIDATES_PER_PICK = 4;
+
+// Cleanup thread only; kept between calls to reuse its memory
+static std::vector<std::pair<float, GLint>> s_evictionCandidates;
+
+// Needs the buffer lock. Picks the slots least worth keeping, of those drawn
+// since oldTime but not for a moment, to bring the buffer down to the low
+// watermark once those already picked are evicted. Some may turn out to
+// have children and be kept.
+static void pickToLowWatermark(GLint firstOffset, double currentTime)
+{
+	std::vector<PlanetDataBuffer::PendingEviction>& pending = PLANET_DATA_BUFFER->m_pendingEvictions;
+
+	const unsigned numAllocated = PLANET_DATA_BUFFER->numAllocatedPatches() - (unsigned)pending.size();
+	const unsigned lowWatermark = (unsigned)(GLOBALS.m_bufferLowWatermark * PLANET_DATA_BUFFER->m_bufferSizePatches);
+	if (numAllocated <= lowWatermark)
+		return;
+
+	// Those drawn since are likely still on screen
+	const double recentTime = currentTime - 0.5;
+
+	const size_t maxCandidates = (size_t)CANDIDATES_PER_PICK * (numAllocated - lowWatermark);
+
+	std::vector<std::pair<float, GLint>>& candidates = s_evictionCandidates;
+	candidates.clear();
+	GLint offset = firstOffset;
+	for ( ; offset >= 0 && PLANET_DATA_BUFFER->m_lastDrawnTimes[offset] < recentTime && candidates.size() < maxCandidates; offset = PLANET_DATA_BUFFER->m_lruNext[offset])
+		candidates.emplace_back(getKeepValue(offset, currentTime), offset);
+
+	const size_t numToPick = std::min<size_t>(numAllocated - lowWatermark, candidates.size());
+	if (numToPick < candidates.size())
+		std::nth_element(candidates.begin(), candidates.begin() + numToPick, candidates.end());
+
+	for (size_t i = 0; i < numToPick; ++i)
+	{
+		const GLint offset = candidates[i].second;
+		const PlanetDataBuffer::PendingEviction eviction = {
+			offset, PLANET_DATA_BUFFER->m_patchPointers[offset], PLANET_DATA_BUFFER->m_lastDrawnTimes[offset], true
+		};
+		pending.push_back(eviction);
+	}
+}
+
+// Replaces the pending evictions. Returns the number evicted so far.
+unsigned cleanupPatchesSingleFrame()
+{
+	double* const times = PLANET_DATA_BUFFER->m_lastDrawnTimes;
+
+	const double currentTime = glfwGetTime();
+	const double oldTime = currentTime - 5.0; // Num seconds - should make this dynamic
+
+	PLANET_DATA_BUFFER->m_bufferLock.acquire();
+
+	// Any the render thread has not got to are picked again if still due
+	std::vector<PlanetDataBuffer::PendingEviction>& pending = PLANET_DATA_BUFFER->m_pendingEvictions;
+	pending.clear();
+
+	// Oldest first, up to the first slot drawn since oldTime
+	GLint offset = PLANET_DATA_BUFFER->m_lruHead;
+	for ( ; offset >= 0 && times[offset] < oldTime; offset = PLANET_DATA_BUFFER->m_lruNext[offset])
+	{
+		const PlanetDataBuffer::PendingEviction eviction = { offset, PLANET_DATA_BUFFER->m_patchPointers[offset], times[offset], false };
+		pending.push_back(eviction);
+	}
+
+	// Still too full with what has been drawn lately
+	if (PLANET_DATA_BUFFER->isNearlyFull())
+		pickToLowWatermark(offset, currentTime);
+
+	const unsigned numEvicted = PLANET_DATA_BUFFER->m_numEvicted;
 	PLANET_DATA_BUFFER->m_bufferLock.release();
+	return numEvicted;
 }
 
 void cleanupPatches()
 {
+	double lastTime = glfwGetTime();
+	unsigned lastNumEvicted = 0;
 	while (!GLOBALS.m_shuttingDown)
 	{
 		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-		cleanupPatchesSingleFrame(); 
+		const unsigned numEvicted = cleanupPatchesSingleFrame(); // Those picked last time, as the render thread evicts them
+
+		const double currentTime = glfwGetTime();
+		PLANET_DATA_BUFFER->m_evictionsPerSecond = (float)((numEvicted - lastNumEvicted) / (currentTime - lastTime));
+		lastNumEvicted = numEvicted;
+		lastTime = currentTime;
 	}
 }
 
@@ -184,6 +469,8 @@ PlanetDataBuffer* PLANET_DATA_BUFFER;
 
 void initPlanetDataBufferAndConstants()
 {
-	PLANET_PATCH_CONSTANTS = new PlanetPatchConstants(32, 1);
-	PLANET_DATA_BUFFER = new PlanetDataBuffer(268435456, 256); // 256 MB
+	PLANET_PATCH_CONSTANTS = new PlanetPatchConstants(32, 1, GLOBALS.m_compactPatchVertices);
+	PLANET_DATA_BUFFER = new PlanetDataBuffer(
+		(size_t)GLOBALS.m_patchBufferMB * 1048576, (GLuint)GLOBALS.m_patchPageMB * 1048576, 256
+	);
 }
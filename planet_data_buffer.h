@@ -1,10 +1,11 @@
 #pragma once
 
-#include <stack>
 #include <vector>
 #include <thread>
 
 #include "glstuff.h"
+#include "patchhash.h"
+#include "patch_slot_allocator.h"
 #include "utils.h"
 
 struct PlanetPatch;
@@ -16,29 +17,58 @@ struct PatchVertexData
 	glm::vec4 colour;
 };
 
+// Alternative to PatchVertexData, a quarter of its size, used when
+// GLOBALS.m_compactPatchVertices is set. The position is rebuilt from the
+// vertex's place in the patch grid and its slot's PatchInfo, and the colour
+// from the altitude, material and slope (see lib_patch_vertex.glsl).
+struct CompactPatchVertexData
+{
+	uint16_t height;   // Radius across the slot's PatchInfo range, 0 to 65535
+	uint16_t normal;   // Octahedral-mapped unit normal, 8 bits per coordinate
+	uint32_t material; // Band of the terrain colour ramp the altitude is in
+};
+
+// Compact vertices only: what the shaders need to know about the patch in
+// each buffer slot. As PatchInfo in lib_patch_vertex.glsl.
+struct PatchInfo
+{
+	glm::vec4 details; // Orientation (as terrain_cs.glsl), step size, dim0 and dim1 of the first vertex
+	glm::vec4 range;   // Radius at height 0, radius per height step, radius per unit of colour ramp altitude
+};
+
 struct PlanetPatchConstants
 {
 	const unsigned m_visiblePolygons;
 	const unsigned m_verticesPerSide;
 	const unsigned m_visibleVertices;
 	const unsigned m_totalVertices;
+	const bool m_compactVertices;
+	const unsigned m_vertexSizeBytes;
 	const unsigned m_totalSizeBytes;
 	const unsigned m_patchesPerBatch;
-	const std::vector<GLuint> m_allIndexes;
+	const unsigned m_indexesPerVariant;
+	const std::vector<GLuint> m_allIndexes; // 16 variants; see PlanetPatch::m_coarserEdges
 
 	private:
 
-	PlanetPatchConstants(unsigned visiblePolygons, unsigned patchesPerBatch);
+	PlanetPatchConstants(unsigned visiblePolygons, unsigned patchesPerBatch, bool compactVertices);
 	friend void initPlanetDataBufferAndConstants();
 };
 extern const PlanetPatchConstants* PLANET_PATCH_CONSTANTS;
 
+// Patch vertex storage, in fixed-size pages, each its own buffer, made
+// resident as those before it fill and released once empty. Slot IDs (the
+// offsets below) are the page number above m_pageShift bits and the slot in
+// the page below, so every per-slot array is indexed by ID directly.
 struct PlanetDataBuffer
 {
-	const GLuint m_bufferSizeBytes;
-	const GLuint m_bufferSizePatches;
+	const unsigned m_pageShift;
+	const unsigned m_pageSizePatches; // 1 << m_pageShift
+	const GLuint m_pageSizeBytes;
+	const unsigned m_maxPages;
+	const size_t m_bufferSizeBytes;   // At most, over every page
+	const GLuint m_bufferSizePatches; // Likewise
 
-	const VertexBuffer m_vertexBuffer;
 	const VertexBuffer m_statsBuffer;
 	const VertexBuffer m_indexBuffer;
 
@@ -47,12 +77,41 @@ struct PlanetDataBuffer
 	glm::uvec4* const m_statsDataClientBuffer;
 	void* const m_statsZeroData;
 
+	// Guards the slots' bookkeeping below, but not which are free
 	SpinLock m_bufferLock;
 
 	// Each of these is m_bufferSizePatches long
 	PlanetPatch** const m_patchPointers;
-	Planet** const m_ownerPointers;
+	unsigned char* const m_patchLevels; // The patch's and its planet's, when allocated,
+	float* const m_regenerationCosts;   // for the cleanup thread to weigh slots by
 	double* const m_lastDrawnTimes;
+	float* const m_lastDrawnDistances; // From the camera, over the patch's bounding radius
+
+	// Occupied slots as a list, least recently drawn first, so that eviction
+	// only looks at the slots old enough to evict. By slot; -1 ends the list.
+	GLint* const m_lruPrev;
+	GLint* const m_lruNext;
+	GLint m_lruHead;
+	GLint m_lruTail;
+
+	// Slots the cleanup thread has picked to evict, for the render thread to
+	// evict at its next safe point, between quadtree walks. The cleanup
+	// thread only reads the bookkeeping above, never the patches, so the walks
+	// never race it and need no lock. Replaced at each look.
+	struct PendingEviction
+	{
+		GLint m_offset;
+		PlanetPatch* m_patch;    // Slot's patch when picked; compared, not read, unless still there
+		double m_lastDrawnTime;  // Slot's when picked; if drawn since, it is kept
+		bool m_overBudget;       // Picked by cost, to get under the low watermark, rather than by age
+	};
+	std::vector<PendingEviction> m_pendingEvictions;
+
+	// Eviction statistics
+	unsigned m_numEvicted;          // In total
+	unsigned m_numEvictionsDeferred; // Old slots last looked at but kept, as their patches had children
+	unsigned m_numBudgetEvictions;   // Of m_numEvicted, those made to get under the low watermark
+	float m_evictionsPerSecond;      // Over the last look
 
 	inline void clearStatsBuffer()
 	{
@@ -64,33 +123,120 @@ struct PlanetDataBuffer
 		glGetBufferSubData(GL_ARRAY_BUFFER, 0, m_statsBufferSizeBytes, m_statsDataClientBuffer);
 	}
 
-	inline GLint getOffset(PlanetPatch* patch, Planet* owner)
+	inline unsigned getPage(GLint offset) const { return (unsigned)offset >> m_pageShift; }
+	inline unsigned getSlotInPage(GLint offset) const { return (unsigned)offset & (m_pageSizePatches - 1); }
+
+	// Of a resident page
+	inline GLuint getVertexBuffer(unsigned page) const { return m_pages[page]->m_vertexBuffer->m_id; }
+	inline GLuint getPatchInfoBuffer(unsigned page) const { return m_pages[page]->m_patchInfoBuffer->m_id; } // Compact vertices only
+	inline bool hasRoom(unsigned page) const { return m_pages[page]->m_slots.numFree() > 0; }
+
+	// Render thread only, as are the two below. The first resident page with
+	// a free slot, making one resident if none has; -1 if all are resident
+	// and full.
+	int findPageWithRoom();
+
+	// Needs m_bufferLock, as do touch() and freeOffset(). A slot in a resident
+	// page, or -1 if it is full.
+	GLint getOffset(PlanetPatch* patch, Planet* owner, unsigned page);
+
+	// Moves the slot to the most recently drawn end of the list
+	inline void touch(GLint offset, double time, float distanceOverSize)
 	{
-		const GLint offset = m_offsetStack.top();
-		m_offsetStack.pop();
-		m_patchPointers[offset] = patch;
-		m_ownerPointers[offset] = owner;
-		return offset;
+		m_lastDrawnTimes[offset] = time;
+		m_lastDrawnDistances[offset] = distanceOverSize;
+		if (offset != m_lruTail)
+		{
+			lruUnlink(offset);
+			lruAppend(offset);
+		}
 	}
 
+	// Render thread only, at a safe point: with no quadtree walk in flight
+	void applyPendingEvictions();
+
+	// Compact vertices only: records where the patch in a slot lies and the
+	// range its heights are quantised over
+	void setPatchInfo(GLint offset, const PatchHash& hash, float minRadius, float maxRadius, float altitudeScale);
+
 	inline void freeOffset(GLint offset)
 	{
+		lruUnlink(offset);
 		m_patchPointers[offset] = 0;
-		m_offsetStack.push(offset);
+		m_pages[getPage(offset)]->m_slots.free((int)getSlotInPage(offset));
+		m_numAllocatedPatches.fetch_sub(1, std::memory_order_relaxed);
 	}
 
+	// These two need no lock, but may be out of date by return. Free slots
+	// include those of pages yet to be made resident.
 	inline unsigned numAllocatedPatches() const
 	{
-		return m_bufferSizePatches - (unsigned)m_offsetStack.size();
+		return m_numAllocatedPatches.load(std::memory_order_relaxed);
+	}
+
+	inline unsigned numFreePatches() const
+	{
+		return m_bufferSizePatches - numAllocatedPatches();
+	}
+
+	inline unsigned numResidentPages() const { return m_numResidentPages; }
+
+	// Past GLOBALS.m_bufferHighWatermark: the cleanup thread evicts down to
+	// the low watermark, and the generation queue only fills holes
+	inline bool isNearlyFull() const
+	{
+		return numAllocatedPatches() > GLOBALS.m_bufferHighWatermark * m_bufferSizePatches;
 	}
 
 	private:
 
-	PlanetDataBuffer(GLuint bufferSizeBytes, unsigned statsBufferSizePatches);
+	PlanetDataBuffer(size_t maxSizeBytes, GLuint pageSizeBytes, unsigned statsBufferSizePatches);
 	~PlanetDataBuffer();
 
 	std::thread* m_cleanupThread;
-	std::stack<GLint> m_offsetStack;
+
+	struct Page
+	{
+		PatchSlotAllocator m_slots;
+		VertexBuffer* m_vertexBuffer;    // Null while not resident
+		VertexBuffer* m_patchInfoBuffer; // Compact vertices only; PatchInfo per slot
+
+		Page(unsigned numSlots) : m_slots(numSlots), m_vertexBuffer(nullptr), m_patchInfoBuffer(nullptr) {}
+	};
+	std::vector<Page*> m_pages; // m_maxPages of them, resident or not
+	unsigned m_numResidentPages;
+	std::atomic<unsigned> m_numAllocatedPatches;
+
+	void makePageResident(unsigned page);
+
+	// Render thread. Keeps the first empty page, so that the buffer hovering
+	// around a page boundary doesn't make and release one every look.
+	void releaseEmptyPages();
+
+	inline void lruAppend(GLint offset)
+	{
+		m_lruPrev[offset] = m_lruTail;
+		m_lruNext[offset] = -1;
+		if (m_lruTail >= 0)
+			m_lruNext[m_lruTail] = offset;
+		else
+			m_lruHead = offset;
+		m_lruTail = offset;
+	}
+
+	inline void lruUnlink(GLint offset)
+	{
+		const GLint prev = m_lruPrev[offset];
+		const GLint next = m_lruNext[offset];
+		if (prev >= 0)
+			m_lruNext[prev] = next;
+		else
+			m_lruHead = next;
+		if (next >= 0)
+			m_lruPrev[next] = prev;
+		else
+			m_lruTail = prev;
+	}
 
 	friend void initPlanetDataBufferAndConstants();
 };
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include "patchhash.h"
+#include "patch_hash_map.h"
 
 struct PlanetPatch
 {
@@ -15,44 +16,82 @@ struct PlanetPatch
 	int m_numChildrenPopulated; // bit mask
 	bool m_parentPopulated;
 	bool m_populated;
+	bool m_generating; // A PatchJob for this patch is with the worker pool
+	unsigned m_queueStamp; // See PatchGenerationQueue
+	bool m_subtreeChanged; // Since a cached walk of the subtree from here; see Planet::populateDrawLists
+	double m_splitTime; // When a walk last went down to this patch's children; see Planet::reclaimPatches
 	float m_minAltitude;
 	float m_maxAltitude;
 	float m_averageAltitude;
+	float m_geometricError; // Bound on how far this patch's surface is from the terrain's: its altitude spread, and its generated descendants'
 	unsigned m_numSubmerged;
+	int m_coarserEdges; // While drawn: bit (1 << MoveDirection) for each edge shared with a patch drawn a level coarser
 
 	PlanetPatch(PatchHash hash, int childNumber, PlanetPatch* parent) :
 		m_hash(hash), m_childNumber(childNumber),
 		m_boundingVectors(hash.getBoundingVectors()),
 		m_parent(parent), m_children(0), m_numChildrenPopulated(0),
-		m_populated(false), m_minAltitude(1.0), m_maxAltitude(1.0),
-		m_averageAltitude(1.0), m_numSubmerged(0)
+		m_populated(false), m_generating(false), m_queueStamp(0), m_subtreeChanged(true), m_splitTime(0.0),
+		m_minAltitude(1.0), m_maxAltitude(1.0),
+		m_averageAltitude(1.0), m_geometricError(0.0f), m_numSubmerged(0), m_coarserEdges(0)
 	{}
 
 	~PlanetPatch() {}
 
+	// After any change to what the quadtree walk reads of this patch: its
+	// population, altitudes, or its children's population
+	inline void markChanged()
+	{
+		for (PlanetPatch* patch = this; patch; patch = patch->m_parent)
+			patch->m_subtreeChanged = true;
+	}
+
 	inline void setAltitudes(float minAltitude, float maxAltitude)
 	{
 		m_minAltitude = minAltitude;
 		m_maxAltitude = maxAltitude;
 		m_averageAltitude = 0.5f * (m_minAltitude + m_maxAltitude);
+		m_geometricError = m_maxAltitude - m_minAltitude;
 		const float maxDistFromRadius = std::max(fabs(1.0f - m_minAltitude), fabs(1.0f - m_maxAltitude));
 		m_boundingVectors.m_radius = sqrtf(
 			2.0f * m_hash.getSize() * m_hash.getSize() +
 			maxDistFromRadius * maxDistFromRadius
 		);
 	}
+
+	// Raises this patch's error to cover a child's: the child's surface, and
+	// the terrain under it, differ from this one's by up to the spread of
+	// both their altitudes. True if it rose.
+	inline bool includeChildError(const PlanetPatch& child)
+	{
+		const float error = std::max(
+			child.m_geometricError,
+			std::max(m_maxAltitude, child.m_maxAltitude) - std::min(m_minAltitude, child.m_minAltitude)
+		);
+		if (error <= m_geometricError)
+			return false;
+		m_geometricError = error;
+		return true;
+	}
+
+	// Once generated, before markChanged(): takes in the generated children,
+	// then passes the result up for as long as it raises an ancestor's
+	inline void propagateGeometricError()
+	{
+		if (m_children)
+			for (int i = 0; i < 4; ++i)
+				if (m_numChildrenPopulated & (1 << i))
+					includeChildError(m_children[i]);
+
+		for (PlanetPatch* patch = this; patch->m_parent && patch->m_parent->includeChildError(*patch); patch = patch->m_parent);
+	}
 };
 
 struct PlanetPatchHashFunc : public std::hash_compare<uint64_t>
 {
 	inline size_t operator()(uint64_t key) const
 	{
-		key ^= key >> 33;
-		key *= 0xff51afd7ed558ccd;
-		key ^= key >> 33;
-		key *= 0xc4ceb9fe1a85ec53;
-		key ^= key >> 33;
-		return key & 0xFFFFFFFF;
+		return mixPatchHash(key) & 0xFFFFFFFF;
 	}
 
 	inline bool operator()(uint64_t key1, uint64_t key2) const
@@ -61,4 +100,4 @@ struct PlanetPatchHashFunc : public std::hash_compare<uint64_t>
 	}
 };
 
-typedef std::hash_map<uint64_t, PlanetPatch*, PlanetPatchHashFunc> PlanetPatchMap;
+typedef PatchHashMap<PlanetPatch*> PlanetPatchMap;
@@ -13,6 +13,8 @@
 #include "utils.h"
 #include "shader_program.h"
 #include "planet_data_buffer.h"
+#include "libnoise_graph.h"
+#include "noise_graph.h"
 
 static const char* DEFINE_VERTEX = "#define _VERTEX_";
 static const char* DEFINE_GEOMETRY = "#define _GEOMETRY_";
@@ -122,15 +124,38 @@ static GLuint linkShaderProgram(const std::vector<GLenum>& types, const std::str
 	return result;
 }
 
-std::string buildComputeShaderSource(const std::string& lib)
+static std::string buildLibnoiseGraphSource()
 {
-	const std::string numPointsStr = intToString(PLANET_PATCH_CONSTANTS->m_verticesPerSide + 2);
+	GLSLNoiseBuilder builder;
+	const GLSLNoiseBuilder::Value altitude = LibnoiseGraph::altitude(builder, builder.position());
+	return builder.function("getAltitude", altitude);
+}
+
+// Colour ramp and vertex format, for every stage that writes or reads patch vertices
+static std::string buildPatchVertexSource()
+{
+	std::stringstream oss;
+	oss <<
+		"#define COMPACT_VERTICES " << (PLANET_PATCH_CONSTANTS->m_compactVertices ? 1 : 0) << "\n" <<
+		"#define VERTICES_PER_SIDE " << PLANET_PATCH_CONSTANTS->m_verticesPerSide << "\n\n" <<
+		stringFromFile("lib_patch_vertex.glsl") << "\n\n"
+	;
+	return oss.str();
+}
+
+std::string buildComputeShaderSource(const std::string& lib, bool analyticNormals)
+{
+	// Without analytic normals the shader also evaluates a one-vertex apron
+	const unsigned apron = analyticNormals ? 0 : 2;
+	const std::string numPointsStr = intToString(PLANET_PATCH_CONSTANTS->m_verticesPerSide + apron);
 	const std::string numPatchesStr = intToString(PLANET_PATCH_CONSTANTS->m_patchesPerBatch);
 
 	std::stringstream oss;
 	oss << 
+		(analyticNormals ? "#define ANALYTIC_NORMALS\n" : "") <<
 		"#define NUM_POINTS " << numPointsStr << "\n" <<
 		"#define PATCHES_PER_COMPUTE_BATCH " << numPatchesStr + "\n\n" <<
+		buildPatchVertexSource() <<
 		lib << "\n\n" <<
 		stringFromFile("terrain_cs.glsl")
 	;
@@ -178,18 +203,21 @@ namespace ShaderStages
 			terrainNoAtm = new ShaderStage(
 				GL_VERTEX_SHADER,
 				std::string("#define ATMOSPHERE 0\n") +
+				buildPatchVertexSource() +
 				stringFromFile("terrain_vs.glsl")
 			);
 			terrainInAtm = new ShaderStage(
 				GL_VERTEX_SHADER, 
 				std::string("#define ATMOSPHERE 1\n") +
 				std::string("#define OUTSIDE_ATMOSPHERE 0\n") +
+				buildPatchVertexSource() +
 				stringFromFile("terrain_vs.glsl")
 			);
 			terrainOutAtm = new ShaderStage(
 				GL_VERTEX_SHADER, 
 				std::string("#define ATMOSPHERE 1\n") +
 				std::string("#define OUTSIDE_ATMOSPHERE 1\n") +
+				buildPatchVertexSource() +
 				stringFromFile("terrain_vs.glsl")
 			);
 			/*
@@ -212,6 +240,7 @@ namespace ShaderStages
 			*/
 			simpleWater = new ShaderStage(
 				GL_VERTEX_SHADER,
+				buildPatchVertexSource() +
 				stringFromFile("simplewater_vs.glsl")
 			);
 			skyInAtm = new ShaderStage(
@@ -318,12 +347,17 @@ namespace ShaderStages
 				GL_COMPUTE_SHADER, 
 				buildComputeShaderSource(
 					stringFromFile("lib_ridgedmf.glsl") + "\n" + 
-					stringFromFile("lib_gustavsson_perlin.glsl")
+					stringFromFile("lib_gustavsson_perlin.glsl"),
+					true
 				)
 			);
 			terrainGenLibnoise = new ShaderStage(
 				GL_COMPUTE_SHADER, 
-				buildComputeShaderSource(stringFromFile("lib_libnoise.glsl"))
+				buildComputeShaderSource(
+					stringFromFile("lib_libnoise.glsl") + "\n" + 
+					buildLibnoiseGraphSource(),
+					false
+				)
 			);
 		}
 	}
@@ -0,0 +1,185 @@
+#pragma once
+
+// Thin wrappers over SSE4.1/AVX2 registers for the CPU terrain kernels.
+//
+// The instruction set is picked by the flags of the including translation
+// unit: with /arch:AVX2 (__AVX2__) vectors are 8 lanes wide, otherwise 4 lanes
+// (SSE4.1). Each variant lives in its own namespace so that both can be linked
+// into one binary and chosen at runtime (see cpu_terrain.cpp).
+//
+// Only correctly-rounded IEEE operations are exposed - no reciprocal estimates
+// and no fused multiply-add - so a lane produces the same bits whatever the
+// vector width or CPU.
+
+#include <smmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define SIMD_NAMESPACE SimdAVX2
+#else
+#define SIMD_NAMESPACE SimdSSE4
+#endif
+
+namespace SIMD_NAMESPACE
+{
+
+#if defined(__AVX2__)
+
+const unsigned SIMD_WIDTH = 8;
+typedef __m256 NativeFloat;
+typedef __m256i NativeInt;
+
+#define SIMD_PS(op) _mm256_##op##_ps
+#define SIMD_EPI32(op) _mm256_##op##_epi32
+#define SIMD_SI(op) _mm256_##op##_si256
+
+#else
+
+const unsigned SIMD_WIDTH = 4;
+typedef __m128 NativeFloat;
+typedef __m128i NativeInt;
+
+#define SIMD_PS(op) _mm_##op##_ps
+#define SIMD_EPI32(op) _mm_##op##_epi32
+#define SIMD_SI(op) _mm_##op##_si128
+
+#endif
+
+struct VMask
+{
+	NativeFloat m;
+
+	VMask() {}
+	VMask(NativeFloat v) : m(v) {}
+};
+
+struct VFloat
+{
+	NativeFloat m;
+
+	VFloat() {}
+	VFloat(NativeFloat v) : m(v) {}
+	VFloat(float v) : m(SIMD_PS(set1)(v)) {}
+
+	static inline VFloat load(const float* p) { return SIMD_PS(loadu)(p); }
+	inline void store(float* p) const { SIMD_PS(storeu)(p, m); }
+};
+
+struct VInt
+{
+	NativeInt m;
+
+	VInt() {}
+	VInt(NativeInt v) : m(v) {}
+	VInt(int v) : m(SIMD_EPI32(set1)(v)) {}
+
+	static inline VInt load(const int* p) { return SIMD_SI(loadu)((const NativeInt*)p); }
+	inline void store(int* p) const { SIMD_SI(storeu)((NativeInt*)p, m); }
+};
+
+// Float arithmetic
+
+inline VFloat operator+(VFloat a, VFloat b) { return SIMD_PS(add)(a.m, b.m); }
+inline VFloat operator-(VFloat a, VFloat b) { return SIMD_PS(sub)(a.m, b.m); }
+inline VFloat operator*(VFloat a, VFloat b) { return SIMD_PS(mul)(a.m, b.m); }
+inline VFloat operator/(VFloat a, VFloat b) { return SIMD_PS(div)(a.m, b.m); }
+inline VFloat operator-(VFloat a) { return SIMD_PS(xor)(a.m, SIMD_PS(set1)(-0.0f)); }
+
+inline VFloat& operator+=(VFloat& a, VFloat b) { a = a + b; return a; }
+inline VFloat& operator-=(VFloat& a, VFloat b) { a = a - b; return a; }
+inline VFloat& operator*=(VFloat& a, VFloat b) { a = a * b; return a; }
+
+inline VFloat vmin(VFloat a, VFloat b) { return SIMD_PS(min)(a.m, b.m); }
+inline VFloat vmax(VFloat a, VFloat b) { return SIMD_PS(max)(a.m, b.m); }
+inline VFloat vabs(VFloat a) { return SIMD_PS(andnot)(SIMD_PS(set1)(-0.0f), a.m); }
+inline VFloat vfloor(VFloat a) { return SIMD_PS(floor)(a.m); }
+inline VFloat vsqrt(VFloat a) { return SIMD_PS(sqrt)(a.m); }
+inline VFloat vclamp(VFloat a, VFloat lo, VFloat hi) { return vmin(vmax(a, lo), hi); }
+
+// GLSL mix(): a*(1-t) + b*t
+inline VFloat vmix(VFloat a, VFloat b, VFloat t) { return a * (VFloat(1.0f) - t) + b * t; }
+
+// Comparisons and masks
+
+#if defined(__AVX2__)
+inline VMask operator< (VFloat a, VFloat b) { return _mm256_cmp_ps(a.m, b.m, _CMP_LT_OQ); }
+inline VMask operator<=(VFloat a, VFloat b) { return _mm256_cmp_ps(a.m, b.m, _CMP_LE_OQ); }
+inline VMask operator> (VFloat a, VFloat b) { return _mm256_cmp_ps(a.m, b.m, _CMP_GT_OQ); }
+inline VMask operator>=(VFloat a, VFloat b) { return _mm256_cmp_ps(a.m, b.m, _CMP_GE_OQ); }
+#else
+inline VMask operator< (VFloat a, VFloat b) { return _mm_cmplt_ps(a.m, b.m); }
+inline VMask operator<=(VFloat a, VFloat b) { return _mm_cmple_ps(a.m, b.m); }
+inline VMask operator> (VFloat a, VFloat b) { return _mm_cmpgt_ps(a.m, b.m); }
+inline VMask operator>=(VFloat a, VFloat b) { return _mm_cmpge_ps(a.m, b.m); }
+#endif
+
+inline VMask operator&(VMask a, VMask b) { return SIMD_PS(and)(a.m, b.m); }
+inline VMask operator|(VMask a, VMask b) { return SIMD_PS(or)(a.m, b.m); }
+inline VMask andNot(VMask a, VMask b) { return SIMD_PS(andnot)(b.m, a.m); } // a & ~b
+inline int moveMask(VMask a) { return SIMD_PS(movemask)(a.m); }
+inline bool anyLane(VMask a) { return moveMask(a) != 0; }
+
+// Lane-wise (mask ? a : b)
+inline VFloat select(VMask mask, VFloat a, VFloat b) { return SIMD_PS(blendv)(b.m, a.m, mask.m); }
+
+// 1.0f where mask is set, 0.0f elsewhere
+inline VFloat maskToFloat(VMask mask) { return SIMD_PS(and)(mask.m, SIMD_PS(set1)(1.0f)); }
+
+// Integer arithmetic (wraps on overflow, like GLSL)
+
+inline VInt operator+(VInt a, VInt b) { return SIMD_EPI32(add)(a.m, b.m); }
+inline VInt operator-(VInt a, VInt b) { return SIMD_EPI32(sub)(a.m, b.m); }
+inline VInt operator*(VInt a, VInt b) { return SIMD_EPI32(mullo)(a.m, b.m); }
+inline VInt operator&(VInt a, VInt b) { return SIMD_SI(and)(a.m, b.m); }
+inline VInt operator|(VInt a, VInt b) { return SIMD_SI(or)(a.m, b.m); }
+inline VInt operator^(VInt a, VInt b) { return SIMD_SI(xor)(a.m, b.m); }
+inline VInt shiftRightArithmetic(VInt a, int n) { return SIMD_EPI32(srai)(a.m, n); }
+inline VInt shiftRightLogical(VInt a, int n) { return SIMD_EPI32(srli)(a.m, n); }
+inline VInt shiftLeft(VInt a, int n) { return SIMD_EPI32(slli)(a.m, n); }
+inline VInt vmin(VInt a, VInt b) { return SIMD_EPI32(min)(a.m, b.m); }
+inline VInt vmax(VInt a, VInt b) { return SIMD_EPI32(max)(a.m, b.m); }
+inline VInt vclamp(VInt a, VInt lo, VInt hi) { return vmin(vmax(a, lo), hi); }
+
+#if defined(__AVX2__)
+inline VFloat asFloat(VInt a) { return _mm256_castsi256_ps(a.m); }
+inline VInt asInt(VFloat a) { return _mm256_castps_si256(a.m); }
+#else
+inline VFloat asFloat(VInt a) { return _mm_castsi128_ps(a.m); }
+inline VInt asInt(VFloat a) { return _mm_castps_si128(a.m); }
+#endif
+
+inline VMask operator==(VInt a, VInt b) { return asFloat(SIMD_EPI32(cmpeq)(a.m, b.m)).m; }
+inline VMask operator> (VInt a, VInt b) { return asFloat(SIMD_EPI32(cmpgt)(a.m, b.m)).m; }
+
+// Lane-wise (mask ? a : b)
+inline VInt select(VMask mask, VInt a, VInt b) { return asInt(select(mask, asFloat(a), asFloat(b))); }
+
+// Conversions: truncation towards zero (GLSL int()) and int to float
+#if defined(__AVX2__)
+inline VInt truncateToInt(VFloat a) { return _mm256_cvttps_epi32(a.m); }
+inline VFloat toFloat(VInt a) { return _mm256_cvtepi32_ps(a.m); }
+#else
+inline VInt truncateToInt(VFloat a) { return _mm_cvttps_epi32(a.m); }
+inline VFloat toFloat(VInt a) { return _mm_cvtepi32_ps(a.m); }
+#endif
+
+// Table lookup: result[i] = table[index[i]]
+#if defined(__AVX2__)
+inline VInt gather(const int* table, VInt index) { return _mm256_i32gather_epi32(table, index.m, 4); }
+#else
+inline VInt gather(const int* table, VInt index)
+{
+	return _mm_setr_epi32(
+		table[_mm_extract_epi32(index.m, 0)], table[_mm_extract_epi32(index.m, 1)],
+		table[_mm_extract_epi32(index.m, 2)], table[_mm_extract_epi32(index.m, 3)]
+	);
+}
+#endif
+
+#undef SIMD_PS
+#undef SIMD_EPI32
+#undef SIMD_SI
+
+} // namespace SIMD_NAMESPACE
@@ -1,6 +1,10 @@
 
 
+#if COMPACT_VERTICES
+layout(location = 0) in uvec2 u2_vertData;
+#else
 layout(location = 0) in vec3 v3_vertPos_MS;
+#endif
 
 layout (std140) uniform PlanetUniforms
 {
@@ -40,7 +44,11 @@ out float flogz; // Depth hack
 
 void setTerrainOutputs()
 {
+#if COMPACT_VERTICES
+	vec3 surfacePosition = getCompactVertexDirection(gl_VertexID);
+#else
 	vec3 surfacePosition = normalize(v3_vertPos_MS);
+#endif
 
 	// Displace here
 		
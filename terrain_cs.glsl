@@ -1,5 +1,22 @@
+// With ANALYTIC_NORMALS the generator returns normals along with altitudes
+// and NUM_POINTS is the patch's vertices per side. Otherwise normals are
+// found by differences, which needs a one-vertex apron round the patch.
+#ifdef ANALYTIC_NORMALS
+#define APRON 0
+#else
+#define APRON 1
+#endif
+
+#define NUM_OUT_POINTS (NUM_POINTS - 2*APRON)
+
 layout (local_size_x=NUM_POINTS, local_size_y=NUM_POINTS, local_size_z=1) in;
 
+#if COMPACT_VERTICES
+layout (std430, binding=0) buffer CompactTerrainOutputs
+{
+	writeonly uvec2 compactTerrainOutputs[]; // See encodeCompactVertex()
+};
+#else
 struct TerrainVertexData
 {
 	vec4 positionAndNormal;
@@ -10,6 +27,7 @@ layout (std140, binding=0) buffer TerrainOutputs
 {
 	writeonly TerrainVertexData terrainOutputs[];
 };
+#endif
 
 struct StatsStruct
 {
@@ -24,21 +42,26 @@ layout (std140, binding=1) buffer StatsOutputs
 	writeonly StatsStruct statsOutputs[];
 };
 
+#ifndef ANALYTIC_NORMALS
 shared vec4 sharedPositions[NUM_POINTS*NUM_POINTS];
+#endif
 
 // orientationMatrixId (3 bits) and offset (29 bits), stepSize (float), dim0Start (float), dim1Start (float)
+// The start is that of the apron, one step outside the patch.
 uniform vec4 uniform_patchDetails[PATCHES_PER_COMPUTE_BATCH]; 
 uniform int  uniform_seed;
 uniform mat3 uniform_orientationMatrixes[6];
+uniform float uniform_octaveCutoff; // Octave cutoff wavelength in vertex spacings; 0 to keep every octave
 
 vec3 getVertexPositionSphereSpace()
 {	
 	vec4 details = uniform_patchDetails[gl_WorkGroupID.x];
+	const uvec2 gridPos = gl_LocalInvocationID.xy + uvec2(1 - APRON);
 
 	vec3 cubePos = uniform_orientationMatrixes[floatBitsToUint(details[0]) >> 29] * vec3(
 		1.0, 
-		details[2] + details[1]*gl_LocalInvocationID.x, 
-		details[3] + details[1]*gl_LocalInvocationID.y
+		details[2] + details[1]*gridPos.x, 
+		details[3] + details[1]*gridPos.y
 	);
 
 	// "Better" mapping: see http://mathproofs.blogspot.co.uk/2005/07/mapping-cube-to-sphere.html
@@ -51,6 +74,7 @@ vec3 getVertexPositionSphereSpace()
 	return normalize(cubePos);
 }
 
+#ifndef ANALYTIC_NORMALS
 bool isExtremity()
 {
 	return any(bvec4(
@@ -58,6 +82,7 @@ bool isExtremity()
 		gl_LocalInvocationID.y == 0, gl_LocalInvocationID.y == NUM_POINTS - 1
 	));
 }
+#endif
 
 float compressNormal(vec3 normal) // Compress to GL_BGRA format
 {
@@ -74,10 +99,17 @@ uint floatToSortableUint(float value)
 
 void main()
 {	
+	vec3 vertexPositionSphereSpace = getVertexPositionSphereSpace();
+	const float minWavelength = uniform_octaveCutoff * uniform_patchDetails[gl_WorkGroupID.x][1];
+
+#ifdef ANALYTIC_NORMALS
+	vec3 normal;
+	vec4 colourAndAltitude = getColourAndAltitude(vertexPositionSphereSpace, uniform_seed, minWavelength, normal);
+	const vec3 outputPosition = vertexPositionSphereSpace * colourAndAltitude.w;
+#else
 	const int sharedIndex = int(gl_LocalInvocationIndex);
 	
-	vec3 vertexPositionSphereSpace = getVertexPositionSphereSpace();
-	vec4 colourAndAltitude = getColourAndAltitude(vertexPositionSphereSpace, uniform_seed);
+	vec4 colourAndAltitude = getColourAndAltitude(vertexPositionSphereSpace, uniform_seed, minWavelength);
 	const vec3 outputPosition = vertexPositionSphereSpace * colourAndAltitude.w;
 	
 	// Set shared memory
@@ -92,31 +124,35 @@ void main()
 	vec3 yUp = sharedPositions[min(sharedIndex+NUM_POINTS, NUM_POINTS*NUM_POINTS-1)].xyz;
 	const vec3 normal = normalize(cross(xUp - xDn, yUp - yDn));
 
-	// Set values
-	if (!isExtremity())
-	{
-		// Patch offset is lowest 21 bits (0-20)
-		const uint patchOffset = floatBitsToUint(uniform_patchDetails[gl_WorkGroupID.x][0]) & 0x1fffff;
-		const uint numOutPoints = NUM_POINTS - 2;
-		const uint terrainVertexIndex = 
-			patchOffset*numOutPoints*numOutPoints +
-			(gl_LocalInvocationID.y-1)*numOutPoints + 
-			gl_LocalInvocationID.x - 1
-		;
-
-		// Set vertex
-		terrainOutputs[terrainVertexIndex].positionAndNormal = vec4(outputPosition, compressNormal(normal));
-		terrainOutputs[terrainVertexIndex].colour = vec4(colourAndAltitude.xyz, 1.0);
-		
-		// Set stats; offset is next 8 bits (21-28)
-		/*
-		const uint statsOffset = (floatBitsToUint(uniform_patchDetails[gl_WorkGroupID.x][0]) >> 21) & 0xff;
-		
-		uint altitudeAsUint = floatToSortableUint(colourAndAltitude.w); 
-		atomicMin(statsOutputs[statsOffset].minAlt, altitudeAsUint);
-		atomicMax(statsOutputs[statsOffset].maxAlt, altitudeAsUint);
-		if (colourAndAltitude.w < 1.0)
-			atomicAdd(statsOutputs[statsOffset].numSubmerged, 1);
-			*/
-	}
+	if (isExtremity())
+		return;
+#endif
+
+	// Set values; patch offset is lowest 21 bits (0-20)
+	const uint patchOffset = floatBitsToUint(uniform_patchDetails[gl_WorkGroupID.x][0]) & 0x1fffff;
+	const uint numOutPoints = NUM_OUT_POINTS;
+	const uint terrainVertexIndex = 
+		patchOffset*numOutPoints*numOutPoints +
+		(gl_LocalInvocationID.y-APRON)*numOutPoints + 
+		gl_LocalInvocationID.x - APRON
+	;
+
+	// Set vertex
+#if COMPACT_VERTICES
+	compactTerrainOutputs[terrainVertexIndex] = encodeCompactVertex(patchOffset, colourAndAltitude.w, normal);
+#else
+	terrainOutputs[terrainVertexIndex].positionAndNormal = vec4(outputPosition, compressNormal(normal));
+	terrainOutputs[terrainVertexIndex].colour = vec4(colourAndAltitude.xyz, 1.0);
+#endif
+	
+	// Set stats; offset is next 8 bits (21-28)
+	/*
+	const uint statsOffset = (floatBitsToUint(uniform_patchDetails[gl_WorkGroupID.x][0]) >> 21) & 0xff;
+	
+	uint altitudeAsUint = floatToSortableUint(colourAndAltitude.w); 
+	atomicMin(statsOutputs[statsOffset].minAlt, altitudeAsUint);
+	atomicMax(statsOutputs[statsOffset].maxAlt, altitudeAsUint);
+	if (colourAndAltitude.w < 1.0)
+		atomicAdd(statsOutputs[statsOffset].numSubmerged, 1);
+		*/
 }
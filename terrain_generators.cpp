@@ -2,9 +2,24 @@
 #include "utils.h"
 #include "noise.h"
 #include "glstuff.h"
+#include "planet_data_buffer.h"
 
 // Initalise constants
 
+// Estimated largest gradient of snoise() in lib_gustavsson_perlin.glsl: the
+// largest found by sampling (7.4), plus a margin. Not a proven bound; the
+// analytic one, summing each corner's worst case, is near 30 and would make
+// the altitude bounds too loose to cull with.
+const float SNOISE_MAX_GRADIENT = 8.0f;
+
+// Grid of samples used by RidgedMFGenerator::getAltitudeBounds
+const unsigned ALTITUDE_BOUNDS_POINTS_PER_SIDE = 5;
+
+// Patches at multiples of this level evaluate their inherited octaves afresh
+// rather than resuming from the parent, so rebuilding a dropped octave state
+// never goes back more than this many levels
+const int OCTAVE_STATE_RESTART_LEVELS = 8;
+
 const glm::mat3 ORIENTATION_MATRICES[6] = {
 	glm::mat3(-1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 1.0, 0.0),
 	glm::mat3(1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, -1.0, 0.0),
@@ -273,14 +288,21 @@ const float g_randomVectors[256*4] = {
     0.0337884f, -0.979891f, -0.196654f, 0.0f
 };
 
-TerrainGenerator::TerrainGenerator(ShaderStage* stageCompute, int seed)
+TerrainGenerator::TerrainGenerator(ShaderStage* stageCompute, int seed, float octaveCutoff, TerrainBackend backend) :
+	m_program(backend == TerrainBackend::GPU ? new ShaderProgram({ stageCompute }) : nullptr),
+	m_locId_patchDetails(-1),
+	m_seed(seed),
+	m_backend(backend),
+	m_octaveCutoff(octaveCutoff)
 {
-	m_program = new ShaderProgram({ stageCompute });
+	if (!m_program)
+		return; // The CPU backend needs no GL state
 
 	glBindVertexArray(m_vertexArray.m_id);
 	glUseProgram(m_program->m_id);
 
 	glUniform1i(m_program->getUniformLocationId("uniform_seed"), seed);
+	glUniform1f(m_program->getUniformLocationId("uniform_octaveCutoff"), octaveCutoff);
 	m_locId_patchDetails = m_program->getUniformLocationId("uniform_patchDetails");
 
 	const GLint locId_orientationMatrixes = m_program->getUniformLocationId("uniform_orientationMatrixes");
@@ -301,6 +323,58 @@ TerrainGenerator::~TerrainGenerator()
 	delete m_program;
 }
 
+float TerrainGenerator::getMinWavelength(const PatchHash& hash) const
+{
+	// Same as terrain_cs.glsl: cube-space vertex spacing
+	return m_octaveCutoff * hash.getSize() / PLANET_PATCH_CONSTANTS->m_visiblePolygons;
+}
+
+uint64_t TerrainGenerator::getFingerprint() const
+{
+	// The backend is left out, as only CPU-generated patches are ever stored;
+	// Planet::buildFromXMLNode rejects a TileCache on any other
+	uint64_t fingerprint = fnv1a(&m_seed, sizeof(m_seed));
+	fingerprint = fnv1a(&m_octaveCutoff, sizeof(m_octaveCutoff), fingerprint);
+	return fnv1a(&PLANET_PATCH_CONSTANTS->m_visiblePolygons, sizeof(unsigned), fingerprint);
+}
+
+bool TerrainGenerator::getAltitudeBounds(const PatchHash& hash, float& minAltitude, float& maxAltitude) const
+{
+	return false;
+}
+
+float TerrainGenerator::getAltitudeScale() const
+{
+	return 1.0f;
+}
+
+void TerrainGenerator::getQuantisationRange(const PatchHash& hash, float& minAltitude, float& maxAltitude) const
+{
+	if (getAltitudeBounds(hash, minAltitude, maxAltitude))
+		return;
+
+	// Anything beyond the ramp is one colour, so its height matters least
+	minAltitude = 1.0f + getAltitudeScale() * TERRAIN_COLOUR_HEIGHTS[0][3];
+	maxAltitude = 1.0f + getAltitudeScale() * TERRAIN_COLOUR_HEIGHTS[9][3];
+}
+
+void TerrainGenerator::generatePatchCPU(const PatchHash& hash, TerrainSamples& samples, void* vertices, PatchStats& stats) const
+{
+	throw std::exception("Generator has no CPU backend");
+}
+
+static TerrainBackend buildBackendFromXMLNode(XMLNode& node)
+{
+	const std::string value = buildStringFromXMLNode(node);
+	if (value == "GPU")
+		return TerrainBackend::GPU;
+	else if (value == "CPU")
+		return TerrainBackend::CPU;
+
+	raiseXMLException(node, std::string("Invalid backend: ") + value);
+	return TerrainBackend::GPU; // Keep compiler happy
+}
+
 TerrainGenerator* TerrainGenerator::buildFromXMLNode(XMLNode& node)
 {
 	const std::string type = getXMLTypeAttribute(node);
@@ -314,12 +388,51 @@ TerrainGenerator* TerrainGenerator::buildFromXMLNode(XMLNode& node)
 	return nullptr; // Keep compiler happy
 }
 
+std::shared_ptr<const RidgedMFOctaveState> OctaveStateCache::find(uint64_t hash)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const auto it = m_states.find(hash);
+	return (it == m_states.end()) ? nullptr : it->second;
+}
+
+void OctaveStateCache::insert(uint64_t hash, const std::shared_ptr<const RidgedMFOctaveState>& state)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_states.emplace(hash, state).second)
+		return; // Regenerated after a cleanup; the stored state is identical
+
+	m_insertionOrder.push_back(hash);
+	m_sizeBytes += state->getSizeBytes();
+	while (m_sizeBytes > m_capacityBytes && m_insertionOrder.size() > 1)
+	{
+		const auto oldest = m_states.find(m_insertionOrder.front());
+		m_sizeBytes -= oldest->second->getSizeBytes();
+		m_states.erase(oldest);
+		m_insertionOrder.pop_front();
+	}
+}
+
 RidgedMFGenerator::RidgedMFGenerator(
 	int seed, float lacunarity, float gain, float offset,
-	int octaves, float scale, float bias
+	int octaves, float scale, float bias, float inheritedWavelength,
+	float octaveCutoff, TerrainBackend backend
 ) :
-	TerrainGenerator(ShaderStages::Compute::terrainGenRidgedMF, seed)
+	TerrainGenerator(ShaderStages::Compute::terrainGenRidgedMF, seed, octaveCutoff, backend),
+	m_inheritedWavelength(inheritedWavelength),
+	m_octaveStateCache(20 * 1024 * 1024) // About 600 patches' state at 33x33 vertices
 {
+	m_params.m_lacunarity = lacunarity;
+	m_params.m_gain = gain;
+	m_params.m_offset = offset;
+	m_params.m_octaves = octaves;
+	m_params.m_scale = scale;
+	m_params.m_bias = bias;
+
+	if (!m_program)
+		return;
+
 	m_permTextureId = initPermTexture();
 	m_simplexTextureId = initSimplexTexture();
 	m_gradTextureId = initGradTexture();
@@ -339,6 +452,226 @@ void RidgedMFGenerator::addToOverlay(void* bar)
 {
 }
 
+RidgedMFGenerator::~RidgedMFGenerator()
+{
+	for (auto samples : m_freeBoundsSamples)
+		delete samples;
+}
+
+uint64_t RidgedMFGenerator::getFingerprint() const
+{
+	uint64_t fingerprint = fnv1a("RidgedMF", 8, TerrainGenerator::getFingerprint());
+	fingerprint = fnv1a(&m_params.m_lacunarity, sizeof(float), fingerprint);
+	fingerprint = fnv1a(&m_params.m_gain, sizeof(float), fingerprint);
+	fingerprint = fnv1a(&m_params.m_offset, sizeof(float), fingerprint);
+	fingerprint = fnv1a(&m_params.m_octaves, sizeof(int), fingerprint);
+	fingerprint = fnv1a(&m_params.m_scale, sizeof(float), fingerprint);
+	fingerprint = fnv1a(&m_params.m_bias, sizeof(float), fingerprint);
+	fingerprint = fnv1a(&OCTAVE_STATE_RESTART_LEVELS, sizeof(int), fingerprint);
+	return fnv1a(&m_inheritedWavelength, sizeof(float), fingerprint);
+}
+
+bool RidgedMFGenerator::getAltitudeBounds(const PatchHash& hash, float& minAltitude, float& maxAltitude) const
+{
+	// Sample spacing in noise space, which is 10x sphere space; cube-space
+	// distances are an upper bound on the sphere. Every point of the patch is
+	// within half a cell diagonal of a sample.
+	const float spacing = 10.0f * hash.getSize() / (ALTITUDE_BOUNDS_POINTS_PER_SIDE - 1);
+	const float halfDiagonal = 0.5f * SQRT_2 * spacing;
+
+	// Octaves at least two sample spacings long are sampled, and are taken
+	// to change between samples by no more than SNOISE_MAX_GRADIENT allows:
+	// the derivative of noise*prev is estimated using both octaves' frequencies.
+	RidgedMFParams sampledParams = m_params;
+	sampledParams.m_octaves = 0;
+	sampledParams.m_scale = 1.0f;
+	sampledParams.m_bias = 0.0f;
+
+	float freq = 1.0f;
+	float prevFreq = 0.0f;
+	float amp = 0.5f;
+	float maxSlope = 0.0f;
+	while (sampledParams.m_octaves < m_params.m_octaves && freq * spacing <= 0.5f)
+	{
+		maxSlope += fabs(amp) * SNOISE_MAX_GRADIENT * (freq + prevFreq);
+		prevFreq = freq;
+		freq *= m_params.m_lacunarity;
+		amp *= m_params.m_gain;
+		++sampledParams.m_octaves;
+	}
+
+	// Finer octaves add noise*amp*prev, with ridge() and prev both in [0, 1]
+	float sumMin = 0.0f;
+	float sumMax = 0.0f;
+	for (int i = sampledParams.m_octaves; i < m_params.m_octaves; ++i)
+	{
+		sumMin += std::min(amp, 0.0f);
+		sumMax += std::max(amp, 0.0f);
+		amp *= m_params.m_gain;
+	}
+
+	if (sampledParams.m_octaves > 0)
+	{
+		TerrainSamples* boundsSamples;
+		m_boundsSamplesLock.acquire();
+		if (m_freeBoundsSamples.empty())
+		{
+			boundsSamples = new TerrainSamples();
+		}
+		else
+		{
+			boundsSamples = m_freeBoundsSamples.back();
+			m_freeBoundsSamples.pop_back();
+		}
+		m_boundsSamplesLock.release();
+
+		TerrainSamples& samples = *boundsSamples;
+		buildSparsePatchSamples(hash, ALTITUDE_BOUNDS_POINTS_PER_SIDE, samples);
+		CPU_TERRAIN_KERNELS->m_ridgedMF(m_seed, sampledParams, 0.0f, nullptr, nullptr, samples);
+
+		// With a scale of 1 and no bias, the kernel's altitude is 1 + sum
+		float sampledMin = samples.m_altitude[0];
+		float sampledMax = samples.m_altitude[0];
+		for (unsigned i = 1; i < samples.m_count; ++i)
+		{
+			sampledMin = std::min(sampledMin, samples.m_altitude[i]);
+			sampledMax = std::max(sampledMax, samples.m_altitude[i]);
+		}
+
+		sumMin += sampledMin - 1.0f - maxSlope * halfDiagonal;
+		sumMax += sampledMax - 1.0f + maxSlope * halfDiagonal;
+
+		m_boundsSamplesLock.acquire();
+		m_freeBoundsSamples.push_back(boundsSamples);
+		m_boundsSamplesLock.release();
+	}
+
+	const float altitude0 = 1.0f + m_params.m_scale * (sumMin + m_params.m_bias);
+	const float altitude1 = 1.0f + m_params.m_scale * (sumMax + m_params.m_bias);
+	minAltitude = std::min(altitude0, altitude1);
+	maxAltitude = std::max(altitude0, altitude1);
+
+	// With a gain above 1 the fine octaves' range can dwarf the planet, and
+	// such bounds would only stop patches being culled
+	return maxAltitude - minAltitude < 1.0f;
+}
+
+bool RidgedMFGenerator::resumesFromParent(int level) const
+{
+	return level % OCTAVE_STATE_RESTART_LEVELS != 0;
+}
+
+int RidgedMFGenerator::numInheritedOctaves(int level) const
+{
+	// An octave's wavelength is about 1/freq in noise space, which is 10x
+	// sphere space; cube-space vertex spacing is an upper bound on the sphere.
+	// Octaves the parent faded out (see m_octaveCutoff) are not worth keeping.
+	const float parentSpacing = 10.0f * (2.0f / (1 << (level - 1))) / PLANET_PATCH_CONSTANTS->m_visiblePolygons;
+	const float minWavelength = std::max(m_inheritedWavelength, 2.0f * m_octaveCutoff) * parentSpacing;
+
+	int numOctaves = 0;
+	float freq = 1.0f;
+	while (numOctaves < m_params.m_octaves && 1.0f / freq >= minWavelength)
+	{
+		++numOctaves;
+		freq *= m_params.m_lacunarity;
+	}
+	return numOctaves;
+}
+
+std::shared_ptr<const RidgedMFOctaveState> RidgedMFGenerator::getOctaveState(const PatchHash& hash) const
+{
+	std::shared_ptr<const RidgedMFOctaveState> state = m_octaveStateCache.find(hash.m_value);
+	if (state)
+		return state;
+
+	// As generatePatchCPU() would have snapshotted it
+	const int level = hash.getLevel();
+
+	RidgedMFOctaveState resumeFrom;
+	if (resumesFromParent(level))
+	{
+		ChildPosition childPosition;
+		const PatchHash parentHash = hash.getParent(childPosition);
+		const std::shared_ptr<const RidgedMFOctaveState> parentState = getOctaveState(parentHash);
+		if (parentState)
+			upsampleOctaveState(*parentState, childPosition, resumeFrom);
+	}
+
+	const int numOctaves = std::max(numInheritedOctaves(level + 1), resumeFrom.m_numOctaves);
+	if (numOctaves == 0)
+		return nullptr;
+
+	TerrainSamples samples;
+	buildPatchSamples(hash, false, samples);
+
+	std::shared_ptr<RidgedMFOctaveState> snapshot = std::make_shared<RidgedMFOctaveState>();
+	snapshot->m_numOctaves = numOctaves;
+	snapshot->resize(samples.m_paddedCount);
+
+	// Later octaves never change the snapshot, so skip them
+	RidgedMFParams params = m_params;
+	params.m_octaves = numOctaves;
+
+	CPU_TERRAIN_KERNELS->m_ridgedMF(
+		m_seed, params, getMinWavelength(hash),
+		resumeFrom.m_numOctaves > 0 ? &resumeFrom : nullptr, snapshot.get(),
+		samples
+	);
+
+	m_octaveStateCache.insert(hash.m_value, snapshot);
+	return snapshot;
+}
+
+void RidgedMFGenerator::generatePatchCPU(const PatchHash& hash, TerrainSamples& samples, void* vertices, PatchStats& stats) const
+{
+	buildPatchSamples(hash, false, samples);
+	const float minWavelength = getMinWavelength(hash);
+
+	if (m_inheritedWavelength <= 0.0f)
+	{
+		CPU_TERRAIN_KERNELS->m_ridgedMF(m_seed, m_params, minWavelength, nullptr, nullptr, samples);
+		writePatchVerticesWithNormals(samples, getAltitudeScale(), vertices, stats);
+		return;
+	}
+
+	const int level = hash.getLevel();
+
+	// Continue from the parent's low octaves
+	RidgedMFOctaveState resumeFrom;
+	if (resumesFromParent(level))
+	{
+		ChildPosition childPosition;
+		const PatchHash parentHash = hash.getParent(childPosition);
+		const std::shared_ptr<const RidgedMFOctaveState> parentState = getOctaveState(parentHash);
+		if (parentState)
+			upsampleOctaveState(*parentState, childPosition, resumeFrom);
+	}
+
+	// Keep the state our own children will resume from
+	std::shared_ptr<RidgedMFOctaveState> snapshot;
+	if (level < GLOBALS.m_maxPlanetPatchLevel)
+	{
+		const int numOctaves = std::max(numInheritedOctaves(level + 1), resumeFrom.m_numOctaves);
+		if (numOctaves > 0)
+		{
+			snapshot = std::make_shared<RidgedMFOctaveState>();
+			snapshot->m_numOctaves = numOctaves;
+			snapshot->resize(samples.m_paddedCount);
+		}
+	}
+
+	CPU_TERRAIN_KERNELS->m_ridgedMF(
+		m_seed, m_params, minWavelength,
+		resumeFrom.m_numOctaves > 0 ? &resumeFrom : nullptr, snapshot.get(), 
+		samples
+	);
+	writePatchVerticesWithNormals(samples, getAltitudeScale(), vertices, stats);
+
+	if (snapshot)
+		m_octaveStateCache.insert(hash.m_value, snapshot);
+}
+
 RidgedMFGenerator* RidgedMFGenerator::buildFromXMLNode(XMLNode& node)
 {
 	XMLChildFinder finder(node);
@@ -350,13 +683,19 @@ RidgedMFGenerator* RidgedMFGenerator::buildFromXMLNode(XMLNode& node)
 		finder.required("Offset", buildFloatFromXMLNode), 
 		finder.required("Octaves", buildIntFromXMLNode), 
 		finder.required("Scale", buildFloatFromXMLNode), 
-		finder.required("Bias", buildFloatFromXMLNode)
+		finder.required("Bias", buildFloatFromXMLNode),
+		finder.optional("InheritedWavelength", buildFloatFromXMLNode),
+		finder.optional("OctaveCutoff", buildFloatFromXMLNode),
+		finder.optional("Backend", buildBackendFromXMLNode)
 	);
 }
 
-LibnoiseGenerator::LibnoiseGenerator(int seed) :
-	TerrainGenerator(ShaderStages::Compute::terrainGenLibnoise, seed)
+LibnoiseGenerator::LibnoiseGenerator(int seed, float octaveCutoff, TerrainBackend backend) :
+	TerrainGenerator(ShaderStages::Compute::terrainGenLibnoise, seed, octaveCutoff, backend)
 {
+	if (!m_program)
+		return;
+
 	m_permTextureId = initPermTexture();
 	m_simplexTextureId = initSimplexTexture();
 	m_gradTextureId = initGradTexture();
@@ -369,11 +708,30 @@ void LibnoiseGenerator::addToOverlay(void* bar)
 {
 }
 
+uint64_t LibnoiseGenerator::getFingerprint() const
+{
+	return fnv1a("Libnoise", 8, TerrainGenerator::getFingerprint());
+}
+
+float LibnoiseGenerator::getAltitudeScale() const
+{
+	return 0.0005f; // As getColourAndAltitude() in lib_libnoise.glsl
+}
+
+void LibnoiseGenerator::generatePatchCPU(const PatchHash& hash, TerrainSamples& samples, void* vertices, PatchStats& stats) const
+{
+	buildPatchSamples(hash, true, samples);
+	CPU_TERRAIN_KERNELS->m_libnoise(m_seed, getMinWavelength(hash), samples);
+	writePatchVertices(samples, getAltitudeScale(), vertices, stats);
+}
+
 LibnoiseGenerator* LibnoiseGenerator::buildFromXMLNode(XMLNode& node)
 {
 	XMLChildFinder finder(node);
 
 	return new LibnoiseGenerator(
-		finder.required("Seed", buildIntFromXMLNode)
+		finder.required("Seed", buildIntFromXMLNode),
+		finder.optional("OctaveCutoff", buildFloatFromXMLNode),
+		finder.optional("Backend", buildBackendFromXMLNode)
 	);
 }
@@ -1,25 +1,90 @@
 #pragma once
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "glstuff.h"
 #include "shader_program.h"
 #include "xml.h"
+#include "cpu_terrain.h"
+#include "utils.h"
+
+// Where patches are generated: compute shader, or SIMD kernels on the CPU
+enum class TerrainBackend { GPU, CPU };
 
 class TerrainGenerator
 {
 	public:
 
 	VertexArray m_vertexArray;
-	ShaderProgram* m_program;
+	ShaderProgram* m_program; // Null for the CPU backend
 	
 	GLint m_locId_patchDetails;
 
-	TerrainGenerator(ShaderStage* stageCompute, int seed);
+	const int m_seed;
+	const TerrainBackend m_backend;
+
+	// Octaves with a wavelength under this many vertex spacings are skipped,
+	// fading out over the octave above. 0 evaluates every octave. The fade
+	// follows the patch's own spacing, so a patch weights an octave differently
+	// from its parent, even at the vertices they share. Above 0, an edge
+	// stitched to a coarser neighbour can crack, and splits change the terrain.
+	const float m_octaveCutoff;
+
+	TerrainGenerator(ShaderStage* stageCompute, int seed, float octaveCutoff, TerrainBackend backend);
 	virtual ~TerrainGenerator();
 	virtual void addToOverlay(void* bar) = 0;
 
+	// Cutoff wavelength for a patch, in sphere space
+	float getMinWavelength(const PatchHash& hash) const;
+
+	// Identifies the terrain this generator makes, for PatchTileCache;
+	// overrides add their type and parameters.
+	virtual uint64_t getFingerprint() const;
+
+	// Estimated bounds on a patch's altitude (radial scale), cheap enough to
+	// cull patches before they are generated. False if not supported.
+	// Generated altitudes may stray past them where an estimate falls short:
+	// such a patch may be culled slightly early, and a GPU-generated compact
+	// patch clamps its heights to them.
+	virtual bool getAltitudeBounds(const PatchHash& hash, float& minAltitude, float& maxAltitude) const;
+
+	// Radius above 1.0 per unit of altitude on the colour ramp
+	// (TERRAIN_COLOUR_HEIGHTS); compact vertices find their colour with it.
+	virtual float getAltitudeScale() const;
+
+	// Range a compact patch's heights are quantised over when generated on
+	// the GPU: the altitude bounds, or failing those the colour ramp's extent.
+	void getQuantisationRange(const PatchHash& hash, float& minAltitude, float& maxAltitude) const;
+
+	// Generates a patch on the calling thread; samples is scratch space.
+	// vertices are laid out as PLANET_PATCH_CONSTANTS says.
+	virtual void generatePatchCPU(const PatchHash& hash, TerrainSamples& samples, void* vertices, PatchStats& stats) const;
+
 	static TerrainGenerator* buildFromXMLNode(XMLNode& node);
 };
 
+// Bounded store of patches' ridgedmf() octave state, kept so that children can
+// resume from it without regenerating it. Shared by the patch worker threads;
+// the oldest entries go first once the states' total size passes the capacity.
+class OctaveStateCache
+{
+	const size_t m_capacityBytes;
+	size_t m_sizeBytes;
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, std::shared_ptr<const RidgedMFOctaveState>> m_states;
+	std::deque<uint64_t> m_insertionOrder;
+
+	public:
+
+	OctaveStateCache(size_t capacityBytes) : m_capacityBytes(capacityBytes), m_sizeBytes(0) {}
+
+	std::shared_ptr<const RidgedMFOctaveState> find(uint64_t hash);
+	void insert(uint64_t hash, const std::shared_ptr<const RidgedMFOctaveState>& state);
+};
+
 class RidgedMFGenerator : public TerrainGenerator
 {
 	public:
@@ -28,12 +93,41 @@ class RidgedMFGenerator : public TerrainGenerator
 	GLuint m_simplexTextureId;
 	GLuint m_gradTextureId;
 
+	RidgedMFParams m_params;
+
+	// CPU backend only: octaves whose wavelength spans at least this many of
+	// the parent's vertex spacings are upsampled from the parent patch rather
+	// than evaluated again. 0 evaluates every octave.
+	const float m_inheritedWavelength;
+	mutable OctaveStateCache m_octaveStateCache;
+
+	// Scratch samples for getAltitudeBounds, which runs on several threads at once
+	mutable SpinLock m_boundsSamplesLock;
+	mutable std::vector<TerrainSamples*> m_freeBoundsSamples;
+
 	RidgedMFGenerator(
 		int seed, float lacunarity, float gain, float offset,
-		int octaves, float scale, float bias
+		int octaves, float scale, float bias, float inheritedWavelength,
+		float octaveCutoff, TerrainBackend backend
 	);
+	~RidgedMFGenerator();
+
+	int numInheritedOctaves(int level) const;
+
+	// False every OCTAVE_STATE_RESTART_LEVELS levels, where patches evaluate
+	// every octave, so that a chain of resumed states is never long
+	bool resumesFromParent(int level) const;
+
+	// The octave state hash's children resume from, or null if they evaluate
+	// every octave. Regenerated, with any missing ancestors' back to the last
+	// restart level, once dropped from m_octaveStateCache, so a patch never
+	// depends on what was cached.
+	std::shared_ptr<const RidgedMFOctaveState> getOctaveState(const PatchHash& hash) const;
 
 	void addToOverlay(void* bar);
+	uint64_t getFingerprint() const override;
+	bool getAltitudeBounds(const PatchHash& hash, float& minAltitude, float& maxAltitude) const override;
+	void generatePatchCPU(const PatchHash& hash, TerrainSamples& samples, void* vertices, PatchStats& stats) const override;
 
 	static RidgedMFGenerator* buildFromXMLNode(XMLNode& node);
 };
@@ -47,8 +141,11 @@ class LibnoiseGenerator : public TerrainGenerator
 	GLuint m_simplexTextureId;
 	GLuint m_gradTextureId;
 	
-	LibnoiseGenerator(int seed);
+	LibnoiseGenerator(int seed, float octaveCutoff, TerrainBackend backend);
 	void addToOverlay(void* bar);
+	uint64_t getFingerprint() const override;
+	float getAltitudeScale() const override;
+	void generatePatchCPU(const PatchHash& hash, TerrainSamples& samples, void* vertices, PatchStats& stats) const override;
 
 	static LibnoiseGenerator* buildFromXMLNode(XMLNode& node);
 };
@@ -1,7 +1,15 @@
 
+#if COMPACT_VERTICES
+layout(location = 0) in uvec2 u2_vertData; // Decoded into the below by main()
+
+vec3 v3_vertPos_MS;
+vec4 v4_vertNorm_MS;
+vec4 v4_vertCol;
+#else
 layout(location = 0) in vec3 v3_vertPos_MS;
 layout(location = 1) in vec4 v4_vertNorm_MS;
 layout(location = 2) in vec4 v4_vertCol;
+#endif
 
 layout (std140) uniform PlanetUniforms
 {
@@ -142,6 +150,13 @@ void setTerrainOutputs()
 
 void main()
 {
+#if COMPACT_VERTICES
+	vec3 normal, colour;
+	decodeCompactVertex(u2_vertData, gl_VertexID, v3_vertPos_MS, normal, colour);
+	v4_vertNorm_MS = vec4(0.5*normal + 0.5, 0.0);
+	v4_vertCol = vec4(colour, 1.0);
+#endif
+
 #if ATMOSPHERE
 	setAtmosphereOutputs();
 #endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "globals.h"
@@ -58,6 +59,15 @@ inline glm::vec3 posToLatLongAlt(const glm::vec3& pos)
 	return result;
 }
 
+// 64-bit FNV-1a; pass the previous result as hash to continue it
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+	const unsigned char* const bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
 void buildSphereApproximation(int patchSize, std::vector<glm::vec4>& points, std::vector<GLuint>& indexes);
 
 inline void systemExit(int code)